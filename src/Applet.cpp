@@ -35,20 +35,37 @@ Applet::Applet(Samba& samba,
                uint32_t start,
                uint32_t stack,
                uint32_t reset) :
-    _samba(samba), _addr(addr), _size(size), _start(start), _stack(stack), _reset(reset)
+    _samba(samba), _addr(addr), _size(size), _start(start), _stack(stack), _reset(reset),
+    _code(code), _stackTop(0), _uploaded(false)
 {
-    _samba.write(addr, code, size);
+}
+
+void
+Applet::load()
+{
+    if (_uploaded)
+        return;
+
+    _samba.write(_addr, _code, _size);
+    _uploaded = true;
+
+    if (_stackTop)
+        _samba.writeWord(_stack, _stackTop);
 }
 
 void
 Applet::setStack(uint32_t stack)
 {
-    _samba.writeWord(_stack, stack);
+    _stackTop = stack;
+    if (_uploaded)
+        _samba.writeWord(_stack, stack);
 }
 
 void
 Applet::run()
 {
+    load();
+
     // Add one to the start address for Thumb mode
     _samba.go(_start + 1);
 }
@@ -56,6 +73,8 @@ Applet::run()
 void
 Applet::runv()
 {
+    load();
+
     // Add one to the start address for Thumb mode
     _samba.writeWord(_reset, _start + 1);
 
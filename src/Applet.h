@@ -50,6 +50,10 @@ public:
 
     virtual void setStack(uint32_t stack);
 
+    // Upload the applet if it has not been yet.  Applets are uploaded on
+    // first use so that a session only sends the ones it needs.
+    virtual void load();
+
     virtual void run(); // To be used for Thumb-1 based devices (ARM7TDMI, ARM9)
     virtual void runv(); // To be used for Thumb-2 based devices (Cortex-Mx)
 
@@ -60,6 +64,9 @@ protected:
     uint32_t _start; //
     uint32_t _stack; // Applet stack address in device SRAM
     uint32_t _reset;
+    uint8_t* _code;
+    uint32_t _stackTop;
+    bool _uploaded;
 };
 
 #endif // _APPLET_H
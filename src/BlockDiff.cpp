@@ -0,0 +1,195 @@
+///////////////////////////////////////////////////////////////////////////////
+// BOSSA
+//
+// Copyright (c) 2011-2018, ShumaTech
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the <organization> nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+#include "BlockDiff.h"
+
+// Blocks with the same rolling sum checked at each offset, since erased
+// flash makes for a great many identical blocks
+const uint32_t BlockDiff::MaxCandidates = 16;
+
+BlockDiff::BlockDiff(const std::vector<uint32_t>& sums, uint32_t blockSize)
+    : _blockSize(blockSize)
+{
+    for (uint32_t block = 0; block < sums.size() / 2; block++)
+    {
+        _weak.push_back(sums[block * 2]);
+        _strong.push_back(sums[block * 2 + 1]);
+        _blocks.insert(std::make_pair(sums[block * 2], block));
+    }
+}
+
+uint32_t
+BlockDiff::weakSum(const uint8_t* data, uint32_t size)
+{
+    uint32_t a = 0;
+    uint32_t b = 0;
+
+    for (uint32_t i = 0; i < size; i++)
+    {
+        a += data[i];
+        b += a;
+    }
+
+    return (a & 0xffff) | (b << 16);
+}
+
+uint32_t
+BlockDiff::strongSum(const uint8_t* data, uint32_t size)
+{
+    uint32_t hash = 0x811c9dc5;
+
+    for (uint32_t i = 0; i < size; i++)
+    {
+        hash ^= data[i];
+        hash *= 0x01000193;
+    }
+
+    return hash;
+}
+
+bool
+BlockDiff::plan(const uint8_t* data, uint32_t size, uint32_t window, std::vector<FlashCopy>& copies)
+{
+    std::vector<FlashCopy> reverse;
+
+    // Code inserted near the start pushes the rest of the image up so its
+    // old copy is only intact when writing backwards, and removed code the
+    // other way round.  Take whichever direction reuses more.
+    if (scan(data, size, window, true, reverse) > scan(data, size, window, false, copies))
+    {
+        copies.swap(reverse);
+        return true;
+    }
+
+    return false;
+}
+
+bool
+BlockDiff::usable(uint32_t block, uint32_t window, uint32_t windowNum, bool descending,
+                  uint32_t weak, uint32_t strong)
+{
+    uint32_t src = block * _blockSize;
+
+    if (block >= _weak.size() || _weak[block] != weak || _strong[block] != strong)
+        return false;
+
+    // Windows already written have lost their old contents
+    if (descending)
+        return src + _blockSize <= (windowNum + 1) * window;
+    else
+        return src >= windowNum * window;
+}
+
+uint32_t
+BlockDiff::scan(const uint8_t* data, uint32_t size, uint32_t window, bool descending,
+                std::vector<FlashCopy>& copies)
+{
+    uint32_t copied = 0;
+    uint32_t offset = 0;
+    uint32_t a = 0;
+    uint32_t b = 0;
+    bool fresh = true;
+
+    copies.clear();
+
+    while (offset + _blockSize <= size)
+    {
+        if (fresh)
+        {
+            uint32_t sum = weakSum(data + offset, _blockSize);
+            a = sum & 0xffff;
+            b = sum >> 16;
+            fresh = false;
+        }
+
+        // The copies are done a word at a time and within a single window
+        uint32_t windowNum = offset / window;
+        uint32_t weak = (a & 0xffff) | (b << 16);
+        if (offset % 4 == 0 && (offset + _blockSize - 1) / window == windowNum && _blocks.count(weak))
+        {
+            uint32_t strong = strongSum(data + offset, _blockSize);
+            uint32_t block = _weak.size();
+            bool extend = false;
+
+            // Prefer continuing the previous copy, then the same place in
+            // flash, then any other block with the same sums
+            if (!copies.empty() && copies.back().offset + copies.back().size == offset &&
+                copies.back().offset / window == windowNum &&
+                (copies.back().src + copies.back().size) % _blockSize == 0 &&
+                usable((copies.back().src + copies.back().size) / _blockSize, window, windowNum, descending, weak, strong))
+            {
+                block = (copies.back().src + copies.back().size) / _blockSize;
+                extend = true;
+            }
+            else if (offset % _blockSize == 0 &&
+                     usable(offset / _blockSize, window, windowNum, descending, weak, strong))
+            {
+                block = offset / _blockSize;
+            }
+            else
+            {
+                std::pair<std::unordered_multimap<uint32_t, uint32_t>::iterator,
+                          std::unordered_multimap<uint32_t, uint32_t>::iterator> range = _blocks.equal_range(weak);
+                uint32_t candidates = 0;
+
+                for (std::unordered_multimap<uint32_t, uint32_t>::iterator it = range.first;
+                     it != range.second && candidates < MaxCandidates; it++, candidates++)
+                {
+                    if (usable(it->second, window, windowNum, descending, weak, strong))
+                    {
+                        block = it->second;
+                        break;
+                    }
+                }
+            }
+
+            if (block < _weak.size())
+            {
+                if (extend)
+                    copies.back().size += _blockSize;
+                else
+                    copies.push_back(FlashCopy(offset, block * _blockSize, _blockSize));
+
+                copied += _blockSize;
+                offset += _blockSize;
+                fresh = true;
+                continue;
+            }
+        }
+
+        // Roll the sums on by one byte
+        if (offset + _blockSize < size)
+        {
+            a += data[offset + _blockSize] - data[offset];
+            b += a - _blockSize * data[offset];
+        }
+        offset++;
+    }
+
+    return copied;
+}
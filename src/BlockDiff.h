@@ -0,0 +1,71 @@
+///////////////////////////////////////////////////////////////////////////////
+// BOSSA
+//
+// Copyright (c) 2011-2018, ShumaTech
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the <organization> nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+#ifndef _BLOCKDIFF_H
+#define _BLOCKDIFF_H
+
+#include <stdint.h>
+#include <vector>
+#include <unordered_map>
+
+#include "Flash.h"
+
+// Finds the parts of a new image that are already somewhere in flash, in
+// the manner of rsync.  The flash is described by the sums of its fixed
+// blocks as computed on the device and the new image is searched at every
+// word offset with a rolling checksum.
+class BlockDiff
+{
+public:
+    BlockDiff(const std::vector<uint32_t>& sums, uint32_t blockSize);
+    virtual ~BlockDiff() {}
+
+    static uint32_t weakSum(const uint8_t* data, uint32_t size);
+    static uint32_t strongSum(const uint8_t* data, uint32_t size);
+
+    // Plan the copies for an image written over the summed flash in
+    // windows of the given size.  A copy is only used if its source is
+    // still intact when its window is loaded.  Returns true if the windows
+    // must be written from the last to the first.
+    bool plan(const uint8_t* data, uint32_t size, uint32_t window, std::vector<FlashCopy>& copies);
+
+private:
+    uint32_t scan(const uint8_t* data, uint32_t size, uint32_t window, bool descending,
+                  std::vector<FlashCopy>& copies);
+    bool usable(uint32_t block, uint32_t window, uint32_t windowNum, bool descending,
+                uint32_t weak, uint32_t strong);
+
+    static const uint32_t MaxCandidates;
+
+    uint32_t _blockSize;
+    std::vector<uint32_t> _weak;
+    std::vector<uint32_t> _strong;
+    std::unordered_multimap<uint32_t, uint32_t> _blocks;
+};
+
+#endif // _BLOCKDIFF_H
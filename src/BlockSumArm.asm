@@ -0,0 +1,78 @@
+    .global start
+    .global stack
+    .global reset
+    .global start_addr
+    .global block_size
+    .global blocks
+    .global dst_addr
+
+    .syntax unified
+    .text
+    .thumb
+    .align 2
+
+@ For each block store the rsync style rolling sum (a | b << 16) followed
+@ by the FNV-1a hash of the block
+start:
+    push    {r4, r5, r6, r7}
+    ldr     r0, start_addr
+    ldr     r1, dst_addr
+
+block:
+    ldr     r2, prime
+    ldr     r3, block_size
+    movs    r4, #0
+    movs    r5, #0
+    ldr     r6, basis
+
+byte:
+    ldrb    r7, [r0]
+    adds    r0, #1
+    adds    r4, r7
+    adds    r5, r4
+    eors    r6, r7
+    muls    r6, r2, r6
+    subs    r3, #1
+    bne     byte
+
+    lsls    r4, r4, #16
+    lsrs    r4, r4, #16
+    lsls    r5, r5, #16
+    orrs    r4, r5
+    stmia   r1!, {r4, r6}
+
+    adr     r7, blocks
+    ldr     r2, [r7]
+    subs    r2, #1
+    str     r2, [r7]
+    bne     block
+
+    pop     {r4, r5, r6, r7}
+
+    @ Fix for SAM-BA stack bug
+    ldr     r0, reset
+    cmp     r0, #0
+    bne     return
+    ldr     r0, stack
+    mov     sp, r0
+
+return:
+    bx      lr
+
+    .align  2
+prime:
+    .word   0x01000193
+basis:
+    .word   0x811c9dc5
+stack:
+    .word   0
+reset:
+    .word   0
+start_addr:
+    .word   0
+block_size:
+    .word   0
+blocks:
+    .word   0
+dst_addr:
+    .word   0
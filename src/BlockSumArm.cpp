@@ -0,0 +1,30 @@
+// WARNING!!! DO NOT EDIT - FILE GENERATED BY APPLETGEN
+#include "BlockSumArm.h"
+#include "BlockSumApplet.h"
+
+BlockSumArm BlockSumApplet::applet = {
+// block_size
+0x00000058,
+// blocks
+0x0000005c,
+// dst_addr
+0x00000060,
+// reset
+0x00000050,
+// stack
+0x0000004c,
+// start
+0x00000000,
+// start_addr
+0x00000054,
+// code
+{
+0xf0, 0xb4, 0x14, 0x48, 0x16, 0x49, 0x0f, 0x4a, 0x13, 0x4b, 0x00, 0x24, 0x00, 0x25, 0x0e, 0x4e,
+0x07, 0x78, 0x01, 0x30, 0xe4, 0x19, 0x2d, 0x19, 0x7e, 0x40, 0x56, 0x43, 0x01, 0x3b, 0xf7, 0xd1,
+0x24, 0x04, 0x24, 0x0c, 0x2d, 0x04, 0x2c, 0x43, 0x50, 0xc1, 0x0c, 0xa7, 0x3a, 0x68, 0x01, 0x3a,
+0x3a, 0x60, 0xe8, 0xd1, 0xf0, 0xbc, 0x06, 0x48, 0x00, 0x28, 0x01, 0xd1, 0x03, 0x48, 0x85, 0x46,
+0x70, 0x47, 0xc0, 0x46, 0x93, 0x01, 0x00, 0x01, 0xc5, 0x9d, 0x1c, 0x81, 0x00, 0x00, 0x00, 0x00,
+0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+0x00, 0x00, 0x00, 0x00,
+}
+};
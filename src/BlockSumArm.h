@@ -0,0 +1,19 @@
+// WARNING!!! DO NOT EDIT - FILE GENERATED BY APPLETGEN
+#ifndef _BLOCKSUMARM_H
+#define _BLOCKSUMARM_H
+
+#include <stdint.h>
+
+typedef struct
+{
+    uint32_t block_size;
+    uint32_t blocks;
+    uint32_t dst_addr;
+    uint32_t reset;
+    uint32_t stack;
+    uint32_t start;
+    uint32_t start_addr;
+    uint8_t code[100];
+} BlockSumArm;
+
+#endif // _BLOCKSUMARM_H
@@ -35,6 +35,7 @@
 #include "PortFactory.h"
 #include "Samba.h"
 #include "Flash.h"
+#include "ImageSource.h"
 #include "BossaBitmaps.h"
 #include "BossaWindow.h"
 
@@ -48,6 +49,7 @@ public:
     Samba samba;
     BossaBitmaps bitmaps;
     Device device;
+    ImageCache images;
 
 private:
     bool OnInit();
@@ -77,6 +77,12 @@ MainFrame::MainFrame( wxWindow* parent, wxWindowID id, const wxString& title, co
 	
 	_buttonBoxSizer->Add( _writeButton, 0, wxALIGN_CENTER_VERTICAL|wxALL, 5 );
 	
+	_verifyCheckBox = new wxCheckBox( this, wxID_ANY, wxT("Verify after write"), wxDefaultPosition, wxDefaultSize, 0 );
+	_verifyCheckBox->SetValue(true); 
+	_verifyCheckBox->SetToolTip( wxT("Verify each part of the flash as it is written") );
+	
+	_buttonBoxSizer->Add( _verifyCheckBox, 0, wxALIGN_CENTER_VERTICAL|wxALL, 5 );
+	
 	
 	_buttonBoxSizer->Add( 0, 0, 1, wxEXPAND, 5 );
 	
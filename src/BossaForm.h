@@ -52,6 +52,7 @@ class MainFrame : public wxFrame
 		wxButton* _refreshButton;
 		wxFilePickerCtrl* _filePicker;
 		wxButton* _writeButton;
+		wxCheckBox* _verifyCheckBox;
 		wxButton* _verifyButton;
 		wxButton* _readButton;
 		wxButton* _infoButton;
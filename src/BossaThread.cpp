@@ -97,13 +97,14 @@ ThreadObserver::onProgress(int num, int div)
 WriteThread::WriteThread(wxEvtHandler* parent,
                          const wxString& filename,
                          bool eraseAll,
+                         bool verify,
                          bool bootFlash,
                          bool bod,
                          bool bor,
                          bool lock,
                          bool security,
                          uint32_t offset) :
-    BossaThread(parent), _filename(filename), _eraseAll(eraseAll),
+    BossaThread(parent), _filename(filename), _eraseAll(eraseAll), _verify(verify),
     _bootFlash(bootFlash), _bod(bod), _bor(bor), _lock(lock), _security(security), _offset(offset)
 
 {
@@ -120,6 +121,7 @@ WriteThread::Entry()
     {
         ThreadObserver observer(this, "Writing");
         Flasher flasher(samba, device, observer);
+        std::shared_ptr<ImageSource> image = wxGetApp().images.get(std::string(_filename.mb_str()));
         
         if (_eraseAll)
         {
@@ -131,7 +133,25 @@ WriteThread::Entry()
             flash->eraseAuto(true);
         }    
         
-        flasher.write(_filename.mb_str(), _offset);
+        if (_verify)
+        {
+            uint32_t pageErrors;
+            uint32_t totalErrors;
+
+            if (!flasher.writeVerify(*image, pageErrors, totalErrors, _offset))
+            {
+                Warning(wxString::Format(_(
+                    "Verify failed\n"
+                    "Page errors: %d\n"
+                    "Byte errors: %d\n"),
+                    pageErrors, totalErrors));
+                return 0;
+            }
+        }
+        else
+        {
+            flasher.write(*image, _offset);
+        }
 
         if (flash->canBootFlash())
             flash->setBootFlash(_bootFlash);
@@ -151,7 +171,7 @@ WriteThread::Entry()
         return 0;
     }
 
-    Success(_("Write completed successfully"));
+    Success(_verify ? _("Write and verify completed successfully") : _("Write completed successfully"));
     
     return 0;
 }
@@ -173,8 +193,9 @@ VerifyThread::Entry()
     {
         ThreadObserver observer(this, "Verifying");
         Flasher flasher(samba, device, observer);
+        std::shared_ptr<ImageSource> image = wxGetApp().images.get(std::string(_filename.mb_str()));
         
-        if (!flasher.verify(_filename.mb_str(), pageErrors, totalErrors, _offset))
+        if (!flasher.verify(*image, pageErrors, totalErrors, _offset))
         {
             Warning(wxString::Format(_(
                 "Verify failed\n"
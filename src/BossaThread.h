@@ -78,6 +78,7 @@ public:
     WriteThread(wxEvtHandler* parent,
                 const wxString& filename,
                 bool eraseAll,
+                bool verify,
                 bool bootFlash,
                 bool bod,
                 bool bor,
@@ -89,6 +90,7 @@ public:
 private:
     wxString _filename;
     bool _eraseAll;
+    bool _verify;
     bool _bootFlash;
     bool _bod;
     bool _bor;
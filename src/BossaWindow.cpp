@@ -143,6 +143,10 @@ BossaWindow::RefreshSerial()
     PortFactory& portFactory = wxGetApp().portFactory;
 
     _portComboBox->Clear();
+#if defined(__linux__)
+    // The list is ranked so RS-232 ports can go at the bottom
+    portFactory.setLegacy(true);
+#endif
     for (port = portFactory.begin();
          port != portFactory.end();
          port = portFactory.next())
@@ -361,6 +365,7 @@ BossaWindow::OnWrite(wxCommandEvent& event)
         this,
         _filePicker->GetPath(),
         true,  // _eraseCheckBox->GetValue(),
+        _verifyCheckBox->GetValue(),
         true,  // _bootCheckBox->GetValue(),
         false, // _bodCheckBox->GetValue(),
         false, // _borCheckBox->GetValue(),
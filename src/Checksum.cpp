@@ -0,0 +1,372 @@
+///////////////////////////////////////////////////////////////////////////////
+// BOSSA
+//
+// Copyright (c) 2011-2018, ShumaTech
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the <organization> nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+#include "Checksum.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CHECKSUM_CLMUL
+#include <immintrin.h>
+#endif
+
+#define CRC16_POLY      0x1021
+#define CRC32_POLY      0xedb88320
+
+// Table k gives the CRC of a byte followed by k zero bytes, so that one
+// lookup per byte covers a whole slice of the input at once
+class ChecksumTables
+{
+public:
+    ChecksumTables()
+    {
+        for (uint32_t byte = 0; byte < 256; byte++)
+        {
+            uint16_t crc16 = byte << 8;
+            uint32_t crc32 = byte;
+
+            for (int bit = 0; bit < 8; bit++)
+            {
+                crc16 = (crc16 & 0x8000) ? (crc16 << 1) ^ CRC16_POLY : crc16 << 1;
+                crc32 = (crc32 & 1) ? (crc32 >> 1) ^ CRC32_POLY : crc32 >> 1;
+            }
+            crc16Table[0][byte] = crc16;
+            crc32Table[0][byte] = crc32;
+        }
+
+        for (uint32_t slice = 1; slice < 16; slice++)
+        {
+            for (uint32_t byte = 0; byte < 256; byte++)
+            {
+                uint16_t crc16 = crc16Table[slice - 1][byte];
+
+                crc16Table[slice][byte] = (crc16 << 8) ^ crc16Table[0][crc16 >> 8];
+            }
+        }
+
+        for (uint32_t slice = 1; slice < 8; slice++)
+        {
+            for (uint32_t byte = 0; byte < 256; byte++)
+            {
+                uint32_t crc32 = crc32Table[slice - 1][byte];
+
+                crc32Table[slice][byte] = (crc32 >> 8) ^ crc32Table[0][crc32 & 0xff];
+            }
+        }
+    }
+
+    uint16_t crc16Table[16][256];
+    uint32_t crc32Table[8][256];
+};
+
+static const ChecksumTables tables;
+
+uint16_t
+Checksum::crc16Bytewise(const uint8_t* data, uint32_t size, uint16_t crc)
+{
+    const uint16_t* table = tables.crc16Table[0];
+
+    while (size--)
+        crc = (crc << 8) ^ table[(crc >> 8) ^ *data++];
+
+    return crc;
+}
+
+uint16_t
+Checksum::crc16Slice8(const uint8_t* data, uint32_t size, uint16_t crc)
+{
+    const uint16_t (*t)[256] = tables.crc16Table;
+
+    // The CRC so far only reaches into the first two bytes of a slice
+    for (; size >= 8; size -= 8, data += 8)
+    {
+        crc = t[7][data[0] ^ (crc >> 8)] ^ t[6][data[1] ^ (crc & 0xff)] ^
+              t[5][data[2]] ^ t[4][data[3]] ^ t[3][data[4]] ^ t[2][data[5]] ^
+              t[1][data[6]] ^ t[0][data[7]];
+    }
+
+    return crc16Bytewise(data, size, crc);
+}
+
+uint16_t
+Checksum::crc16Slice16(const uint8_t* data, uint32_t size, uint16_t crc)
+{
+    const uint16_t (*t)[256] = tables.crc16Table;
+
+    for (; size >= 16; size -= 16, data += 16)
+    {
+        crc = t[15][data[0] ^ (crc >> 8)] ^ t[14][data[1] ^ (crc & 0xff)] ^
+              t[13][data[2]] ^ t[12][data[3]] ^ t[11][data[4]] ^ t[10][data[5]] ^
+              t[9][data[6]] ^ t[8][data[7]] ^ t[7][data[8]] ^ t[6][data[9]] ^
+              t[5][data[10]] ^ t[4][data[11]] ^ t[3][data[12]] ^ t[2][data[13]] ^
+              t[1][data[14]] ^ t[0][data[15]];
+    }
+
+    return crc16Slice8(data, size, crc);
+}
+
+uint32_t
+Checksum::crc32Bytewise(const uint8_t* data, uint32_t size, uint32_t crc)
+{
+    const uint32_t* table = tables.crc32Table[0];
+
+    while (size--)
+        crc = (crc >> 8) ^ table[(crc ^ *data++) & 0xff];
+
+    return crc;
+}
+
+uint32_t
+Checksum::crc32Slice8(const uint8_t* data, uint32_t size, uint32_t crc)
+{
+    const uint32_t (*t)[256] = tables.crc32Table;
+
+    for (; size >= 8; size -= 8, data += 8)
+    {
+        uint32_t one = crc ^ (data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t) data[3] << 24));
+        uint32_t two = data[4] | (data[5] << 8) | (data[6] << 16) | ((uint32_t) data[7] << 24);
+
+        crc = t[7][one & 0xff] ^ t[6][(one >> 8) & 0xff] ^ t[5][(one >> 16) & 0xff] ^ t[4][one >> 24] ^
+              t[3][two & 0xff] ^ t[2][(two >> 8) & 0xff] ^ t[1][(two >> 16) & 0xff] ^ t[0][two >> 24];
+    }
+
+    return crc32Bytewise(data, size, crc);
+}
+
+#if defined(CHECKSUM_CLMUL)
+
+// Folds 64 bytes at a time with carry-less multiplies then reduces the
+// result to 32 bits, after Intel's "Fast CRC Computation for Generic
+// Polynomials Using PCLMULQDQ Instruction".  The constants are powers of x
+// modulo the reflected polynomial.  size must be at least 64 and a
+// multiple of 16.
+__attribute__((target("pclmul,sse4.1")))
+static uint32_t
+crc32Fold(const uint8_t* data, uint32_t size, uint32_t crc)
+{
+    const __m128i k1k2 = _mm_set_epi64x(0x01c6e41596LL, 0x0154442bd4LL);
+    const __m128i k3k4 = _mm_set_epi64x(0x00ccaa009eLL, 0x01751997d0LL);
+    const __m128i k5k0 = _mm_set_epi64x(0, 0x0163cd6124LL);
+    const __m128i poly = _mm_set_epi64x(0x01f7011641LL, 0x01db710641LL);
+    const __m128i mask = _mm_setr_epi32(~0, 0, ~0, 0);
+    __m128i x1, x2, x3, x4, x5, x6, x7, x8;
+
+    x1 = _mm_loadu_si128((const __m128i*) (data + 0x00));
+    x2 = _mm_loadu_si128((const __m128i*) (data + 0x10));
+    x3 = _mm_loadu_si128((const __m128i*) (data + 0x20));
+    x4 = _mm_loadu_si128((const __m128i*) (data + 0x30));
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(crc));
+    data += 64;
+    size -= 64;
+
+    for (; size >= 64; size -= 64, data += 64)
+    {
+        x5 = _mm_clmulepi64_si128(x1, k1k2, 0x00);
+        x6 = _mm_clmulepi64_si128(x2, k1k2, 0x00);
+        x7 = _mm_clmulepi64_si128(x3, k1k2, 0x00);
+        x8 = _mm_clmulepi64_si128(x4, k1k2, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, k1k2, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, k1k2, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, k1k2, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, k1k2, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128((const __m128i*) (data + 0x00)));
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128((const __m128i*) (data + 0x10)));
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128((const __m128i*) (data + 0x20)));
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128((const __m128i*) (data + 0x30)));
+    }
+
+    // Fold the four lanes into one, then any 16 byte blocks left over
+    x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+    x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+    x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+    for (; size >= 16; size -= 16, data += 16)
+    {
+        x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, _mm_loadu_si128((const __m128i*) data)), x5);
+    }
+
+    // 128 bits down to 64
+    x2 = _mm_clmulepi64_si128(x1, k3k4, 0x10);
+    x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, mask);
+    x1 = _mm_clmulepi64_si128(x1, k5k0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    // Barrett reduction to 32 bits
+    x2 = _mm_and_si128(x1, mask);
+    x2 = _mm_clmulepi64_si128(x2, poly, 0x10);
+    x2 = _mm_and_si128(x2, mask);
+    x2 = _mm_clmulepi64_si128(x2, poly, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    return _mm_extract_epi32(x1, 1);
+}
+
+#endif
+
+uint32_t
+Checksum::crc32Clmul(const uint8_t* data, uint32_t size, uint32_t crc)
+{
+#if defined(CHECKSUM_CLMUL)
+    if (size >= 64 && hasClmul())
+    {
+        uint32_t bulk = size & ~15;
+
+        crc = crc32Fold(data, bulk, crc);
+        data += bulk;
+        size -= bulk;
+    }
+#endif
+
+    return crc32Slice8(data, size, crc);
+}
+
+bool
+Checksum::hasClmul()
+{
+#if defined(CHECKSUM_CLMUL)
+    static const bool clmul = __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1");
+
+    return clmul;
+#else
+    return false;
+#endif
+}
+
+uint16_t
+Checksum::crc16(const uint8_t* data, uint32_t size, uint16_t crc)
+{
+    return crc16Slice16(data, size, crc);
+}
+
+uint32_t
+Checksum::crc32(const uint8_t* data, uint32_t size, uint32_t crc)
+{
+    static uint32_t (*const kernel)(const uint8_t*, uint32_t, uint32_t) = hasClmul() ? crc32Clmul : crc32Slice8;
+
+    return kernel(data, size, crc);
+}
+
+static const uint32_t sha256K[64] =
+{
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+#define ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+static void
+sha256Block(uint32_t* state, const uint8_t* block)
+{
+    uint32_t w[64];
+    uint32_t v[8];
+
+    for (int i = 0; i < 16; i++)
+        w[i] = (block[i * 4] << 24) | (block[i * 4 + 1] << 16) | (block[i * 4 + 2] << 8) | block[i * 4 + 3];
+    for (int i = 16; i < 64; i++)
+    {
+        uint32_t s0 = ROTR(w[i - 15], 7) ^ ROTR(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = ROTR(w[i - 2], 17) ^ ROTR(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    for (int i = 0; i < 8; i++)
+        v[i] = state[i];
+    for (int i = 0; i < 64; i++)
+    {
+        uint32_t s1 = ROTR(v[4], 6) ^ ROTR(v[4], 11) ^ ROTR(v[4], 25);
+        uint32_t ch = (v[4] & v[5]) ^ (~v[4] & v[6]);
+        uint32_t t1 = v[7] + s1 + ch + sha256K[i] + w[i];
+        uint32_t s0 = ROTR(v[0], 2) ^ ROTR(v[0], 13) ^ ROTR(v[0], 22);
+        uint32_t maj = (v[0] & v[1]) ^ (v[0] & v[2]) ^ (v[1] & v[2]);
+
+        v[7] = v[6];
+        v[6] = v[5];
+        v[5] = v[4];
+        v[4] = v[3] + t1;
+        v[3] = v[2];
+        v[2] = v[1];
+        v[1] = v[0];
+        v[0] = t1 + s0 + maj;
+    }
+    for (int i = 0; i < 8; i++)
+        state[i] += v[i];
+}
+
+void
+Checksum::sha256(const uint8_t* data, uint32_t size, uint8_t* digest)
+{
+    uint32_t state[8] =
+    {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+    };
+    uint8_t tail[128] = { 0 };
+    uint32_t rest = size % 64;
+    uint32_t tailSize = rest < 56 ? 64 : 128;
+    uint64_t bits = (uint64_t) size * 8;
+
+    for (uint32_t offset = 0; offset + 64 <= size; offset += 64)
+        sha256Block(state, data + offset);
+
+    // The message ends with a one bit, zeros and its length in bits
+    for (uint32_t i = 0; i < rest; i++)
+        tail[i] = data[size - rest + i];
+    tail[rest] = 0x80;
+    for (int i = 0; i < 8; i++)
+        tail[tailSize - 1 - i] = bits >> (i * 8);
+    for (uint32_t offset = 0; offset < tailSize; offset += 64)
+        sha256Block(state, tail + offset);
+
+    for (int i = 0; i < 32; i++)
+        digest[i] = state[i / 4] >> (24 - (i % 4) * 8);
+}
+
+const char*
+Checksum::crc16Kernel()
+{
+    return "slice-by-16";
+}
+
+const char*
+Checksum::crc32Kernel()
+{
+    return hasClmul() ? "pclmul" : "slice-by-8";
+}
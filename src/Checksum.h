@@ -0,0 +1,68 @@
+///////////////////////////////////////////////////////////////////////////////
+// BOSSA
+//
+// Copyright (c) 2011-2018, ShumaTech
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the <organization> nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+#ifndef _CHECKSUM_H
+#define _CHECKSUM_H
+
+#include <stdint.h>
+
+// The checksums that the host computes to compare with the device.  Each
+// one has a plain bytewise kernel that the faster ones are checked
+// against, and the fastest kernel that the CPU supports is picked the
+// first time it is used.
+class Checksum
+{
+public:
+    // CRC16-CCITT as used by XMODEM, the SAM-BA checksum command and the
+    // CRC16 applet: polynomial 0x1021, not reflected, starting from crc
+    static uint16_t crc16(const uint8_t* data, uint32_t size, uint16_t crc = 0);
+
+    // CRC32 as computed by the DSU of SAM D and E devices: polynomial
+    // 0x04c11db7, reflected, with crc holding the register value.  Start
+    // from 0xffffffff and invert the result for the usual IEEE 802.3 CRC.
+    static uint32_t crc32(const uint8_t* data, uint32_t size, uint32_t crc = 0xffffffff);
+
+    // SHA-256, for telling files apart where a chance CRC match would
+    // matter.  The digest is 32 bytes.
+    static void sha256(const uint8_t* data, uint32_t size, uint8_t* digest);
+
+    // The kernels themselves, for comparing them with each other
+    static uint16_t crc16Bytewise(const uint8_t* data, uint32_t size, uint16_t crc);
+    static uint16_t crc16Slice8(const uint8_t* data, uint32_t size, uint16_t crc);
+    static uint16_t crc16Slice16(const uint8_t* data, uint32_t size, uint16_t crc);
+    static uint32_t crc32Bytewise(const uint8_t* data, uint32_t size, uint32_t crc);
+    static uint32_t crc32Slice8(const uint8_t* data, uint32_t size, uint32_t crc);
+    static uint32_t crc32Clmul(const uint8_t* data, uint32_t size, uint32_t crc);
+
+    // Carry-less multiply is only used when the CPU has it
+    static bool hasClmul();
+    static const char* crc16Kernel();
+    static const char* crc32Kernel();
+};
+
+#endif // _CHECKSUM_H
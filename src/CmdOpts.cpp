@@ -52,19 +52,25 @@ CmdOpts::usage(FILE* out)
 
     for (optIdx = 0; optIdx < _numOpts; optIdx++)
     {
+        char letter[8] = "    ";
+
+        // Long only options have no letter
+        if (_opts[optIdx].letter)
+            snprintf(letter, sizeof(letter), "-%c, ", _opts[optIdx].letter);
+
         if (_opts[optIdx].arg.has == ArgOptional)
-            snprintf(name, sizeof(name), "  -%c, --%s[=%s]",
-                    _opts[optIdx].letter,
+            snprintf(name, sizeof(name), "  %s--%s[=%s]",
+                    letter,
                     _opts[optIdx].name,
                     _opts[optIdx].arg.name);
         else if (_opts[optIdx].arg.has == ArgRequired)
-            snprintf(name, sizeof(name), "  -%c, --%s=%s",
-                     _opts[optIdx].letter,
+            snprintf(name, sizeof(name), "  %s--%s=%s",
+                     letter,
                      _opts[optIdx].name,
                      _opts[optIdx].arg.name);
         else
-            snprintf(name, sizeof(name), "  -%c, --%s",
-                     _opts[optIdx].letter,
+            snprintf(name, sizeof(name), "  %s--%s",
+                     letter,
                      _opts[optIdx].name);
 
         fprintf(out, "%-23s ", name);
@@ -93,7 +99,6 @@ CmdOpts::parse()
     {
         *_opts[optIdx].present = false;
 
-        *optPtr++ = _opts[optIdx].letter;
         long_opts[optIdx].name = _opts[optIdx].name;
         switch (_opts[optIdx].arg.has)
         {
@@ -103,21 +108,41 @@ CmdOpts::parse()
             break;
         case ArgOptional:
             long_opts[optIdx].has_arg = optional_argument;
-            *optPtr++ = ':';
-            *optPtr++ = ':';
             break;
         case ArgRequired:
             long_opts[optIdx].has_arg = required_argument;
-            *optPtr++ = ':';
             break;
         }
         long_opts[optIdx].flag = NULL;
         long_opts[optIdx].val = 0;
+
+        // Long only options are left out of the short option string
+        if (!_opts[optIdx].letter)
+            continue;
+
+        *optPtr++ = _opts[optIdx].letter;
+        if (_opts[optIdx].arg.has == ArgOptional)
+        {
+            *optPtr++ = ':';
+            *optPtr++ = ':';
+        }
+        else if (_opts[optIdx].arg.has == ArgRequired)
+        {
+            *optPtr++ = ':';
+        }
     }
 
     memset(&long_opts[_numOpts], 0, sizeof(long_opts[_numOpts]));
     *optPtr = '\0';
     optIdx = 0;
+
+    // Start over in case something has been parsed before
+#if defined(__APPLE__) || defined(__OpenBSD__) || defined(__FreeBSD__)
+    optreset = 1;
+    optind = 1;
+#else
+    optind = 0;
+#endif
     while ((rc = getopt_long(_argc, _argv, optstring, long_opts, &optIdx)) != -1)
     {
         if (rc == '?')
@@ -135,6 +160,9 @@ CmdOpts::parse()
             case ArgInt:
                 *_opts[optIdx].arg.value.intPtr = strtol(optarg, NULL, 0);
                 break;
+            case ArgStringList:
+                _opts[optIdx].arg.value.listPtr->push_back(optarg);
+                break;
             default:
             case ArgString:
                 *_opts[optIdx].arg.value.strPtr = optarg;
@@ -30,6 +30,7 @@
 #define _OPTION_H
 
 #include <string>
+#include <vector>
 #include <stdio.h>
 
 typedef enum
@@ -42,7 +43,8 @@ typedef enum
 typedef enum
 {
     ArgInt,
-    ArgString
+    ArgString,
+    ArgStringList
 } ArgType;
 
 typedef struct
@@ -55,6 +57,7 @@ typedef struct
         void* voidPtr;
         int* intPtr;
         std::string* strPtr;
+        std::vector<std::string>* listPtr;
     } value;
 } OptArg;
 
@@ -47,6 +47,7 @@ PortFactory Command::_portFactory;
 Device Command::_device(_samba);
 Device::FlashPtr& Command::_flash = _device.getFlash();
 CommandObserver Command::_observer;
+ImageCache Command::_images;
 Flasher Command::_flasher(_samba, _device, _observer);
 bool Command::_connected = false;
 
@@ -1184,7 +1185,7 @@ CommandVerify::invoke(char* argv[], int argc)
         !flashable())
         return;
 
-    if (!_flasher.verify(argv[1], pageErrors, totalErrors, offset))
+    if (!_flasher.verify(*_images.get(argv[1]), pageErrors, totalErrors, offset))
     {
         printf("\nVerify failed\nPage errors: %d\nByte errors: %d\n",
             pageErrors, totalErrors);
@@ -1213,7 +1214,7 @@ CommandWrite::invoke(char* argv[], int argc)
         !flashable())
         return;
 
-    _flasher.write(argv[1], offset);
+    _flasher.write(*_images.get(argv[1]), offset);
     
     printf("\nWrite successful\n");
 }
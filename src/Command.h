@@ -36,6 +36,7 @@
 #include "PortFactory.h"
 #include "Device.h"
 #include "Flasher.h"
+#include "ImageSource.h"
 
 class CommandObserver : public FlasherObserver
 {
@@ -73,6 +74,7 @@ protected:
     static Device::FlashPtr& _flash;
     static Flasher _flasher;
     static CommandObserver _observer;
+    static ImageCache _images;
     static bool _connected;
 
     bool error(const char* fmt, ...);
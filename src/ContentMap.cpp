@@ -0,0 +1,198 @@
+///////////////////////////////////////////////////////////////////////////////
+// BOSSA
+//
+// Copyright (c) 2011-2018, ShumaTech
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the <organization> nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+#include "ContentMap.h"
+#include "BlockDiff.h"
+#include "Checksum.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#if defined(__WIN32__)
+#include <direct.h>
+#define mkdir(path, mode) _mkdir(path)
+#endif
+
+const uint32_t ContentMap::BlockSize = 256;
+
+// Tells maps written before the CRCs were kept apart from current ones
+#define CONTENT_MAP_VERSION 2
+
+ContentMap::ContentMap(const std::vector<uint32_t>& uniqueId)
+{
+    const char* home;
+    char text[16];
+
+    home = getenv("HOME");
+    if (!home)
+        home = getenv("USERPROFILE");
+    _path = home ? std::string(home) + "/.bossac-contents" : std::string(".bossac-contents");
+    mkdir(_path.c_str(), 0755);
+
+    _path += "/";
+    for (uint32_t word = 0; word < uniqueId.size(); word++)
+    {
+        snprintf(text, sizeof(text), "%08x", uniqueId[word]);
+        _path += text;
+    }
+
+    load();
+}
+
+void
+ContentMap::load()
+{
+    FILE* file;
+    unsigned int version;
+    unsigned int blockSize;
+    unsigned int block;
+    Sums sums;
+    unsigned int crc;
+
+    file = fopen(_path.c_str(), "r");
+    if (!file)
+        return;
+
+    // A map made with other blocks is no use
+    if (fscanf(file, "bossac-contents %u %x", &version, &blockSize) == 2 &&
+        version == CONTENT_MAP_VERSION && blockSize == BlockSize)
+    {
+        while (fscanf(file, "%x %x %x %x", &block, &sums.weak, &sums.strong, &crc) == 4)
+        {
+            sums.crc = crc;
+            _blocks[block] = sums;
+        }
+    }
+
+    fclose(file);
+}
+
+void
+ContentMap::save()
+{
+    std::string temp = _path + ".tmp";
+    FILE* file;
+
+    file = fopen(temp.c_str(), "w");
+    if (!file)
+        return;
+
+    fprintf(file, "bossac-contents %u %x\n", CONTENT_MAP_VERSION, BlockSize);
+    for (std::map<uint32_t, Sums>::iterator it = _blocks.begin(); it != _blocks.end(); it++)
+        fprintf(file, "%x %08x %08x %04x\n", it->first, it->second.weak, it->second.strong, it->second.crc);
+    if (fclose(file) != 0)
+        return;
+
+    remove(_path.c_str());
+    rename(temp.c_str(), _path.c_str());
+}
+
+ContentMap::Sums
+ContentMap::blockSums(const uint8_t* data)
+{
+    Sums sums;
+
+    sums.weak = BlockDiff::weakSum(data, BlockSize);
+    sums.strong = BlockDiff::strongSum(data, BlockSize);
+    sums.crc = Checksum::crc16(data, BlockSize);
+
+    return sums;
+}
+
+uint32_t
+ContentMap::sums(uint32_t offset, uint32_t blocks, std::vector<uint32_t>& sums, std::vector<bool>& known)
+{
+    std::map<uint32_t, Sums>::iterator it;
+    uint32_t count = 0;
+
+    sums.assign(blocks * 2, 0);
+    known.assign(blocks, false);
+    if (offset % BlockSize != 0)
+        return 0;
+
+    for (uint32_t block = 0; block < blocks; block++)
+    {
+        if ((it = _blocks.find(offset / BlockSize + block)) == _blocks.end())
+            continue;
+        sums[block * 2] = it->second.weak;
+        sums[block * 2 + 1] = it->second.strong;
+        known[block] = true;
+        count++;
+    }
+
+    return count;
+}
+
+uint16_t
+ContentMap::crc(uint32_t offset, uint32_t blocks)
+{
+    std::vector<uint8_t> zeros(BlockSize, 0);
+    std::map<uint32_t, Sums>::iterator it;
+    uint16_t crc = 0;
+
+    // The CRC starts from zero and has no final XOR, so the CRC of two
+    // blocks is the first one run through a block of zeros XOR the second
+    for (uint32_t block = 0; block < blocks; block++)
+    {
+        it = _blocks.find(offset / BlockSize + block);
+        assert(it != _blocks.end());
+        crc = Checksum::crc16(&zeros[0], BlockSize, crc) ^ it->second.crc;
+    }
+
+    return crc;
+}
+
+void
+ContentMap::record(uint32_t offset, const uint8_t* data, uint32_t size)
+{
+    // Only whole blocks are known, the ends of the others are not
+    forget(offset, size);
+    for (uint32_t block = (offset + BlockSize - 1) / BlockSize; (block + 1) * BlockSize <= offset + size; block++)
+        _blocks[block] = blockSums(data + block * BlockSize - offset);
+}
+
+void
+ContentMap::erase(uint32_t offset, uint32_t size)
+{
+    std::vector<uint8_t> erased(BlockSize, 0xff);
+    Sums sums = blockSums(&erased[0]);
+
+    forget(offset, size);
+    for (uint32_t block = (offset + BlockSize - 1) / BlockSize; (block + 1) * BlockSize <= offset + size; block++)
+        _blocks[block] = sums;
+}
+
+void
+ContentMap::forget(uint32_t offset, uint32_t size)
+{
+    _blocks.erase(_blocks.lower_bound(offset / BlockSize),
+                  _blocks.lower_bound((offset + size + BlockSize - 1) / BlockSize));
+}
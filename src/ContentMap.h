@@ -0,0 +1,78 @@
+///////////////////////////////////////////////////////////////////////////////
+// BOSSA
+//
+// Copyright (c) 2011-2018, ShumaTech
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the <organization> nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+#ifndef _CONTENTMAP_H
+#define _CONTENTMAP_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <map>
+
+// Remembers the sums of every block last written to a device, keyed by
+// its unique id, so that a later differential write can be planned
+// without reading the flash back.  Blocks that may have changed since
+// are forgotten rather than guessed.  Each block also keeps its CRC16 so
+// that a whole run of recorded blocks can be checked against the device
+// with a single checksum.
+class ContentMap
+{
+public:
+    ContentMap(const std::vector<uint32_t>& uniqueId);
+    virtual ~ContentMap() {}
+
+    static const uint32_t BlockSize;
+
+    // Recorded sums of the blocks from offset, in the layout returned by
+    // Flash::blockSums.  Returns the number of blocks that are known.
+    uint32_t sums(uint32_t offset, uint32_t blocks, std::vector<uint32_t>& sums, std::vector<bool>& known);
+    // CRC16 of a run of recorded blocks, as the device would compute it
+    uint16_t crc(uint32_t offset, uint32_t blocks);
+
+    void record(uint32_t offset, const uint8_t* data, uint32_t size);
+    void erase(uint32_t offset, uint32_t size);
+    void forget(uint32_t offset, uint32_t size);
+    void save();
+
+private:
+    struct Sums
+    {
+        uint32_t weak;
+        uint32_t strong;
+        uint16_t crc;
+    };
+
+    std::string _path;
+    std::map<uint32_t, Sums> _blocks;
+
+    static Sums blockSums(const uint8_t* data);
+
+    void load();
+};
+
+#endif // _CONTENTMAP_H
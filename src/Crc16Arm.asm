@@ -0,0 +1,70 @@
+    .global start
+    .global stack
+    .global reset
+    .global start_addr
+    .global size
+    .global crc
+
+    .syntax unified
+    .text
+    .thumb
+    .align 2
+
+start:
+    push    {r4, r5, r6}
+    ldr     r0, start_addr
+    ldr     r1, size
+    movs    r2, #0
+    ldr     r3, poly
+    b       check
+
+byte:
+    @ CRC-CCITT (XMODEM) as used by the SAM-BA Z command
+    ldrb    r4, [r0]
+    adds    r0, #1
+    lsls    r4, r4, #8
+    eors    r2, r4
+    movs    r5, #8
+
+bit:
+    lsls    r2, r2, #1
+    lsls    r6, r2, #15
+    bpl     next
+    eors    r2, r3
+
+next:
+    subs    r5, #1
+    bne     bit
+    subs    r1, #1
+
+check:
+    cmp     r1, #0
+    bne     byte
+
+    adr     r0, crc
+    str     r2, [r0]
+    pop     {r4, r5, r6}
+
+    @ Fix for SAM-BA stack bug
+    ldr     r0, reset
+    cmp     r0, #0
+    bne     return
+    ldr     r0, stack
+    mov     sp, r0
+
+return:
+    bx      lr
+
+    .align  2
+poly:
+    .word   0x11021
+stack:
+    .word   0
+reset:
+    .word   0
+start_addr:
+    .word   0
+size:
+    .word   0
+crc:
+    .word   0
@@ -0,0 +1,27 @@
+// WARNING!!! DO NOT EDIT - FILE GENERATED BY APPLETGEN
+#include "Crc16Arm.h"
+#include "Crc16Applet.h"
+
+Crc16Arm Crc16Applet::applet = {
+// crc
+0x00000050,
+// reset
+0x00000044,
+// size
+0x0000004c,
+// stack
+0x00000040,
+// start
+0x00000000,
+// start_addr
+0x00000048,
+// code
+{
+0x70, 0xb4, 0x11, 0x48, 0x11, 0x49, 0x00, 0x22, 0x0c, 0x4b, 0x0b, 0xe0, 0x04, 0x78, 0x01, 0x30,
+0x24, 0x02, 0x62, 0x40, 0x08, 0x25, 0x52, 0x00, 0xd6, 0x03, 0x00, 0xd5, 0x5a, 0x40, 0x01, 0x3d,
+0xf9, 0xd1, 0x01, 0x39, 0x00, 0x29, 0xf1, 0xd1, 0x09, 0xa0, 0x02, 0x60, 0x70, 0xbc, 0x05, 0x48,
+0x00, 0x28, 0x01, 0xd1, 0x02, 0x48, 0x85, 0x46, 0x70, 0x47, 0xc0, 0x46, 0x21, 0x10, 0x01, 0x00,
+0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+0x00, 0x00, 0x00, 0x00,
+}
+};
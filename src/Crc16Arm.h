@@ -0,0 +1,18 @@
+// WARNING!!! DO NOT EDIT - FILE GENERATED BY APPLETGEN
+#ifndef _CRC16ARM_H
+#define _CRC16ARM_H
+
+#include <stdint.h>
+
+typedef struct
+{
+    uint32_t crc;
+    uint32_t reset;
+    uint32_t size;
+    uint32_t stack;
+    uint32_t start;
+    uint32_t start_addr;
+    uint8_t code[84];
+} Crc16Arm;
+
+#endif // _CRC16ARM_H
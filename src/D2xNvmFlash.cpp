@@ -29,6 +29,7 @@
 #define NVM_CTRL_STATUS_MASK            0xFFEB
 
 #define NVM_REG_BASE    0x41004000
+#define NVM_REG(reg)    (NVM_REG_BASE + (reg))
 
 #define NVM_REG_CTRLA   0x00
 #define NVM_REG_CTRLB   0x04
@@ -46,6 +47,8 @@
 #define NVM_CMD_SSB     0x45
 #define NVM_CMD_PBC     0x44
 
+#define NVM_STATUS_CMD_ERROR    VmApplet::StatusUser
+
 #define ERASE_ROW_PAGES 4 // pages
 
 // NVM User Row
@@ -57,15 +60,17 @@
 #define NVM_UR_BOD33_RESET_MASK     0x7
 #define NVM_UR_NVM_LOCK_OFFSET      0x6
 
+// 128-bit serial number, the words are not contiguous
+static const uint32_t SerialNumberWords[] = { 0x80A00C, 0x80A040, 0x80A044, 0x80A048 };
+
 D2xNvmFlash::D2xNvmFlash(
     Samba& samba,
     const std::string& name,
     uint32_t pages,
     uint32_t size,
-    uint32_t user,
-    uint32_t stack)
+    const SramMap& sram)
     :
-    Flash(samba, name, 0, pages, size, 1, 16, user, stack), _eraseAuto(true)
+    Flash(samba, name, 0, pages, size, 1, 16, sram), _eraseAuto(true)
 {
 }
 
@@ -87,21 +92,37 @@ D2xNvmFlash::erase(uint32_t offset, uint32_t size)
         throw FlashEraseError();
 
     uint32_t eraseEnd = (offset + size + eraseSize - 1) / eraseSize;
+    VmProgram program;
 
-    // Erase each erase size set of pages
+    // Erase each erase size set of pages, as many rows per run as fit
     for (uint32_t eraseNum = offset / eraseSize; eraseNum < eraseEnd; eraseNum++)
     {
-        waitReady();
+        VmProgram row;
 
         // Clear error bits
-        uint16_t statusReg = readReg(NVM_REG_STATUS);
-        writeReg(NVM_REG_STATUS, statusReg | NVM_CTRL_STATUS_MASK);
+        row.poll(NVM_REG(NVM_REG_INTFLAG), 0x1, 0x1)
+           .read(NVM_REG(NVM_REG_STATUS))
+           .andAcc(0xffff)
+           .orAcc(NVM_CTRL_STATUS_MASK)
+           .writeAcc(NVM_REG(NVM_REG_STATUS));
 
         // Issue erase command
         uint32_t wordAddr = (eraseNum * eraseSize) / 2;
-        writeReg(NVM_REG_ADDR, wordAddr);
-        command(NVM_CMD_ER);
+        row.write(NVM_REG(NVM_REG_ADDR), wordAddr);
+        command(row, NVM_CMD_ER);
+
+        if (program.size() + row.size() > _vm.capacity())
+            execute(program);
+        program.append(row);
     }
+
+    execute(program);
+}
+
+uint32_t
+D2xNvmFlash::pagesPerErase()
+{
+    return ERASE_ROW_PAGES;
 }
 
 void
@@ -124,77 +145,54 @@ D2xNvmFlash::eraseAuto(bool enable)
     _eraseAuto = enable;
 }
 
-std::vector<bool>
-D2xNvmFlash::getLockRegions()
+void
+D2xNvmFlash::readSnapshot(FlashSnapshot& snapshot)
 {
     uint8_t lockBits = 0;
-    uint32_t addr = NVM_UR_ADDR + NVM_UR_NVM_LOCK_OFFSET;
-    std::vector<bool> regions(_lockRegions);
 
+    // Everything but the security bit lives in the user row so read it in one go
+    snapshot.userRow.resize(NVM_UR_SIZE);
+    _samba.read(NVM_UR_ADDR, &snapshot.userRow[0], NVM_UR_SIZE);
+
+    snapshot.regions.assign(_lockRegions, false);
     for (uint32_t region = 0; region < _lockRegions; region++)
     {
         if (region % 8 == 0)
-            lockBits = _samba.readByte(addr++);
-        regions[region] = (lockBits & (1 << (region % 8))) == 0;
+            lockBits = snapshot.userRow[NVM_UR_NVM_LOCK_OFFSET + region / 8];
+        snapshot.regions[region] = (lockBits & (1 << (region % 8))) == 0;
     }
 
-    return regions;
-}
+    snapshot.security = (readReg(NVM_REG_STATUS) & 0x100) != 0;
+    snapshot.bod = (snapshot.userRow[NVM_UR_BOD33_ENABLE_OFFSET] & NVM_UR_BOD33_ENABLE_MASK) != 0;
+    snapshot.bor = (snapshot.userRow[NVM_UR_BOD33_RESET_OFFSET] & NVM_UR_BOD33_RESET_MASK) != 0;
+    snapshot.bootFlash = true;
 
-bool
-D2xNvmFlash::getSecurity()
-{
-    return (readReg(NVM_REG_STATUS) & 0x100) != 0;
-}
-
-bool
-D2xNvmFlash::getBod()
-{
-    uint8_t byte = _samba.readByte(NVM_UR_ADDR + NVM_UR_BOD33_ENABLE_OFFSET);
-
-    return (byte & NVM_UR_BOD33_ENABLE_MASK) != 0;
-}
-
-bool
-D2xNvmFlash::getBor()
-{
-    uint8_t byte = _samba.readByte(NVM_UR_ADDR + NVM_UR_BOD33_RESET_OFFSET);
-
-    return (byte & NVM_UR_BOD33_RESET_MASK) != 0;
-}
-
-bool
-D2xNvmFlash::getBootFlash()
-{
-    return true;
-}
-
-void
-D2xNvmFlash::readUserRow(std::unique_ptr<uint8_t[]>& userRow)
-{
-    if (!userRow)
-    {
-        userRow.reset(new uint8_t[NVM_UR_SIZE]);
-        _samba.read(NVM_UR_ADDR, userRow.get(), NVM_UR_SIZE);
-    }
+    snapshot.uniqueId.clear();
+    for (uint32_t word = 0; word < sizeof(SerialNumberWords) / sizeof(SerialNumberWords[0]); word++)
+        snapshot.uniqueId.push_back(_samba.readWord(SerialNumberWords[word]));
 }
 
 void
 D2xNvmFlash::writeOptions()
 {
-    std::unique_ptr<uint8_t[]> userRow;
+    // Compare against the current state and force a fresh read afterwards
+    FlashSnapshot current = snapshot();
+    std::vector<uint8_t>& userRow = current.userRow;
+    bool modified = false;
 
-    if (canBor() && _bor.isDirty() && _bor.get() != getBor())
+    invalidateSnapshot();
+
+    if (canBor() && _bor.isDirty() && _bor.get() != current.bor)
     {
-        readUserRow(userRow);
+        modified = true;
         if (_bor.get())
             userRow[NVM_UR_BOD33_RESET_OFFSET] |= NVM_UR_BOD33_RESET_MASK;
         else
             userRow[NVM_UR_BOD33_RESET_OFFSET] &= ~NVM_UR_BOD33_RESET_MASK;
     }
-    if (canBod() && _bod.isDirty() && _bod.get() != getBod())
+    if (canBod() && _bod.isDirty() && _bod.get() != current.bod)
     {
-        readUserRow(userRow);
+        modified = true;
         if (_bod.get())
             userRow[NVM_UR_BOD33_ENABLE_OFFSET] |= NVM_UR_BOD33_ENABLE_MASK;
         else
@@ -203,10 +201,9 @@ D2xNvmFlash::writeOptions()
     if (_regions.isDirty())
     {
         // Check if any lock bits are different from the current set
-        std::vector<bool> current = getLockRegions();
-        if (!equal(_regions.get().begin(), _regions.get().end(), current.begin()))
+        if (!equal(_regions.get().begin(), _regions.get().end(), current.regions.begin()))
         {
-            readUserRow(userRow);
+            modified = true;
 
             uint8_t* lockBits = &userRow[NVM_UR_NVM_LOCK_OFFSET];
             for (uint32_t region = 0; region < _regions.get().size(); region++)
@@ -220,7 +217,7 @@ D2xNvmFlash::writeOptions()
     }
 
     // Erase and write the user row if modified
-    if (userRow)
+    if (modified)
     {
         // Disable cache and configure manual page write
         writeReg(NVM_REG_CTRLB, readReg(NVM_REG_CTRLB) | (0x1 << 18) | (0x1 << 7));
@@ -240,8 +237,7 @@ D2xNvmFlash::writeOptions()
 
             // Copy page to page buffer
             _wordCopy.setDstAddr(NVM_UR_ADDR + offset);
-            _wordCopy.setSrcAddr(_onBufferA ? _pageBufferA : _pageBufferB);
-            _onBufferA = !_onBufferA;
+            _wordCopy.setSrcAddr(nextBuffer());
             waitReady();
             _wordCopy.runv();
 
@@ -252,7 +248,7 @@ D2xNvmFlash::writeOptions()
     }
 
     // Always do security last
-    if (_security.isDirty() && _security.get() == true && _security.get() != getSecurity())
+    if (_security.isDirty() && _security.get() == true && _security.get() != current.security)
     {
         command(NVM_CMD_SSB);
     }
@@ -266,27 +262,26 @@ D2xNvmFlash::writePage(uint32_t page)
         throw FlashPageError();
     }
 
-    // Disable cache and configure manual page write
-    writeReg(NVM_REG_CTRLB, readReg(NVM_REG_CTRLB) | (0x1 << 18) | (0x1 << 7));
-
     // Auto-erase if writing at the start of the erase page
     if (_eraseAuto && page % ERASE_ROW_PAGES == 0)
         erase(page * _size, ERASE_ROW_PAGES * _size);
 
-    // Clear page buffer
-    command(NVM_CMD_PBC);
-
     // Compute the start address.
     uint32_t addr = _addr + (page * _size);
+    VmProgram program;
+
+    // Disable cache and configure manual page write
+    program.read(NVM_REG(NVM_REG_CTRLB))
+           .orAcc((0x1 << 18) | (0x1 << 7))
+           .writeAcc(NVM_REG(NVM_REG_CTRLB));
 
-    _wordCopy.setDstAddr(addr);
-    _wordCopy.setSrcAddr(_onBufferA ? _pageBufferA : _pageBufferB);
-    _onBufferA = !_onBufferA;
-    waitReady();
-    _wordCopy.runv();
+    // Clear page buffer, copy the page to it and write it in one run
+    command(program, NVM_CMD_PBC);
+    program.copy(addr, nextBuffer(), _size / sizeof(uint32_t))
+           .write(NVM_REG(NVM_REG_ADDR), addr / 2);
+    command(program, NVM_CMD_WP);
 
-    writeReg(NVM_REG_ADDR, addr / 2);
-    command(NVM_CMD_WP);
+    execute(program);
 }
 
 void
@@ -318,21 +313,49 @@ D2xNvmFlash::writeReg(uint8_t reg, uint32_t value)
     _samba.writeWord(NVM_REG_BASE + reg, value);
 }
 
+void
+D2xNvmFlash::command(VmProgram& program, uint8_t cmd)
+{
+    uint32_t done;
+
+    program.poll(NVM_REG(NVM_REG_INTFLAG), 0x1, 0x1)
+           .write(NVM_REG(NVM_REG_CTRLA), CMDEX_KEY | cmd)
+           .poll(NVM_REG(NVM_REG_INTFLAG), 0x1, 0x1);
+
+    // On error clear the error bit before stopping so the host does not
+    // need another round trip
+    done = program.branch(0x2, 0);
+    program.write(NVM_REG(NVM_REG_INTFLAG), 0x2)
+           .halt(NVM_STATUS_CMD_ERROR)
+           .target(done);
+}
+
 void
 D2xNvmFlash::command(uint8_t cmd)
 {
-    waitReady();
+    VmProgram program;
 
-    writeReg(NVM_REG_CTRLA, CMDEX_KEY | cmd);
+    command(program, cmd);
+    execute(program);
+}
 
-    waitReady();
+void
+D2xNvmFlash::execute(VmProgram& program)
+{
+    if (program.empty())
+        return;
+
+    uint32_t status = _vm.execute(program);
+    program.clear();
 
-    if (readReg(NVM_REG_INTFLAG) & 0x2)
+    if (status == NVM_STATUS_CMD_ERROR)
     {
-        // Clear the error bit
-        writeReg(NVM_REG_INTFLAG, 0x2);
         throw FlashCmdError();
     }
+    else if (status != VmApplet::StatusOk)
+    {
+        throw FlashTimeoutError();
+    }
 }
 
 void
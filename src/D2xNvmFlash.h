@@ -33,29 +33,20 @@ public:
         const std::string& name,
         uint32_t pages,
         uint32_t size,
-        uint32_t user,
-        uint32_t stack);
+        const SramMap& sram);
 
     virtual ~D2xNvmFlash();
 
+    uint32_t pagesPerErase();
+    uint32_t decodeRate() { return 3000; }
+
     void eraseAll(uint32_t offset);
     void eraseAuto(bool enable);
 
-    std::vector<bool> getLockRegions();
-
-    bool getSecurity();
-
-    bool getBod();
     bool canBod() { return true; }
-
-    bool getBor();
     bool canBor() { return true; }
-
-    bool getBootFlash();
     bool canBootFlash() { return false; }
 
-    std::vector<uint32_t> getUniqueId() { return std::vector<uint32_t>(); }
-
     void writeOptions();
 
     void writePage(uint32_t page);
@@ -71,8 +62,10 @@ protected:
 
     void waitReady();
     void command(uint8_t cmd);
+    void command(VmProgram& program, uint8_t cmd);
+    void execute(VmProgram& program);
     void erase(uint32_t offset, uint32_t size);
-    void readUserRow(std::unique_ptr<uint8_t[]>& userRow);
+    void readSnapshot(FlashSnapshot& snapshot);
 };
 
 #endif // _D2XNVMFLASH_H
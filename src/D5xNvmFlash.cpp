@@ -23,6 +23,7 @@
 #define CMDEX_KEY       0xa500
 
 #define NVM_REG_BASE    0x41004000
+#define NVM_REG(reg)    (NVM_REG_BASE + (reg))
 
 #define NVM_REG_CTRLA   0x00
 #define NVM_REG_CTRLB   0x04
@@ -40,6 +41,8 @@
 #define NVM_CMD_SSB     0x16
 #define NVM_CMD_PBC     0x15
 
+#define NVM_STATUS_CMD_ERROR    VmApplet::StatusUser
+
 #define ERASE_BLOCK_PAGES 16 // pages
 
 // NVM User Page
@@ -51,15 +54,17 @@
 #define NVM_UP_BOD33_RESET_MASK     0x2
 #define NVM_UP_NVM_LOCK_OFFSET      0x8
 
+// 128-bit serial number, the words are not contiguous
+static const uint32_t SerialNumberWords[] = { 0x8061FC, 0x806010, 0x806014, 0x806018 };
+
 D5xNvmFlash::D5xNvmFlash(
     Samba& samba,
     const std::string& name,
     uint32_t pages,
     uint32_t size,
-    uint32_t user,
-    uint32_t stack)
+    const SramMap& sram)
     :
-    Flash(samba, name, 0, pages, size, 1, 32, user, stack), _eraseAuto(true)
+    Flash(samba, name, 0, pages, size, 1, 32, sram), _eraseAuto(true)
 {
 }
 
@@ -81,14 +86,29 @@ D5xNvmFlash::erase(uint32_t offset, uint32_t size)
         throw FlashEraseError();
 
     uint32_t eraseEnd = (offset + size + eraseSize - 1) / eraseSize;
+    VmProgram program;
 
-    // Erase each erase size set of pages
+    // Erase each erase size set of pages, as many blocks per run as fit
     for (uint32_t eraseNum = offset / eraseSize; eraseNum < eraseEnd; eraseNum++)
     {
+        VmProgram block;
+
         // Issue erase command
-        writeRegU32(NVM_REG_ADDR, eraseNum * eraseSize);
-        command(NVM_CMD_EB);
+        block.write(NVM_REG(NVM_REG_ADDR), eraseNum * eraseSize);
+        command(block, NVM_CMD_EB);
+
+        if (program.size() + block.size() > _vm.capacity())
+            execute(program);
+        program.append(block);
     }
+
+    execute(program);
+}
+
+uint32_t
+D5xNvmFlash::pagesPerErase()
+{
+    return ERASE_BLOCK_PAGES;
 }
 
 void
@@ -117,78 +137,55 @@ D5xNvmFlash::eraseAuto(bool enable)
     _eraseAuto = enable;
 }
 
-std::vector<bool>
-D5xNvmFlash::getLockRegions()
+void
+D5xNvmFlash::readSnapshot(FlashSnapshot& snapshot)
 {
     uint8_t lockBits = 0;
-    uint32_t addr = NVM_UP_ADDR + NVM_UP_NVM_LOCK_OFFSET;
-    std::vector<bool> regions(_lockRegions);
 
+    // Everything lives in the user page so read it in one go
+    snapshot.userRow.resize(NVM_UP_SIZE);
+    _samba.read(NVM_UP_ADDR, &snapshot.userRow[0], NVM_UP_SIZE);
+
+    snapshot.regions.assign(_lockRegions, false);
     for (uint32_t region = 0; region < _lockRegions; region++)
     {
         if (region % 8 == 0)
-            lockBits = _samba.readByte(addr++);
-        regions[region] = (lockBits & (1 << (region % 8))) == 0;
+            lockBits = snapshot.userRow[NVM_UP_NVM_LOCK_OFFSET + region / 8];
+        snapshot.regions[region] = (lockBits & (1 << (region % 8))) == 0;
     }
 
-    return regions;
-}
-
-bool
-D5xNvmFlash::getSecurity()
-{
-    // There doesn't seem to be a way to read this
-    return false;
-}
-
-bool
-D5xNvmFlash::getBod()
-{
-    uint8_t byte = _samba.readByte(NVM_UP_ADDR + NVM_UP_BOD33_DISABLE_OFFSET);
-
-    return (byte & NVM_UP_BOD33_DISABLE_MASK) == 0;
-}
-
-bool
-D5xNvmFlash::getBor()
-{
-    uint8_t byte = _samba.readByte(NVM_UP_ADDR + NVM_UP_BOD33_RESET_OFFSET);
+    // There doesn't seem to be a way to read the security bit
+    snapshot.security = false;
+    snapshot.bod = (snapshot.userRow[NVM_UP_BOD33_DISABLE_OFFSET] & NVM_UP_BOD33_DISABLE_MASK) == 0;
+    snapshot.bor = (snapshot.userRow[NVM_UP_BOD33_RESET_OFFSET] & NVM_UP_BOD33_RESET_MASK) != 0;
+    snapshot.bootFlash = true;
 
-    return (byte & NVM_UP_BOD33_RESET_MASK) != 0;
-}
-
-bool
-D5xNvmFlash::getBootFlash()
-{
-    return true;
-}
-
-void
-D5xNvmFlash::readUserPage(std::unique_ptr<uint8_t[]>& userPage)
-{
-    if (!userPage)
-    {
-        userPage.reset(new uint8_t[NVM_UP_SIZE]);
-        _samba.read(NVM_UP_ADDR, userPage.get(), NVM_UP_SIZE);
-    }
+    snapshot.uniqueId.clear();
+    for (uint32_t word = 0; word < sizeof(SerialNumberWords) / sizeof(SerialNumberWords[0]); word++)
+        snapshot.uniqueId.push_back(_samba.readWord(SerialNumberWords[word]));
 }
 
 void
 D5xNvmFlash::writeOptions()
 {
-    std::unique_ptr<uint8_t[]> userPage;
+    // Compare against the current state and force a fresh read afterwards
+    FlashSnapshot current = snapshot();
+    std::vector<uint8_t>& userPage = current.userRow;
+    bool modified = false;
 
-    if (canBor() && _bor.isDirty() && _bor.get() != getBor())
+    invalidateSnapshot();
+
+    if (canBor() && _bor.isDirty() && _bor.get() != current.bor)
     {
-        readUserPage(userPage);
+        modified = true;
         if (_bor.get())
             userPage[NVM_UP_BOD33_RESET_OFFSET] |= NVM_UP_BOD33_RESET_MASK;
         else
             userPage[NVM_UP_BOD33_RESET_OFFSET] &= ~NVM_UP_BOD33_RESET_MASK;
     }
-    if (canBod() && _bod.isDirty() && _bod.get() != getBod())
+    if (canBod() && _bod.isDirty() && _bod.get() != current.bod)
     {
-        readUserPage(userPage);
+        modified = true;
         if (_bod.get())
             userPage[NVM_UP_BOD33_DISABLE_OFFSET] &= ~NVM_UP_BOD33_DISABLE_MASK;
         else
@@ -197,10 +194,9 @@ D5xNvmFlash::writeOptions()
     if (_regions.isDirty())
     {
         // Check if any lock bits are different from the current set
-        std::vector<bool> current = getLockRegions();
-        if (!equal(_regions.get().begin(), _regions.get().end(), current.begin()))
+        if (!equal(_regions.get().begin(), _regions.get().end(), current.regions.begin()))
         {
-            readUserPage(userPage);
+            modified = true;
 
             uint8_t* lockBits = &userPage[NVM_UP_NVM_LOCK_OFFSET];
             for (uint32_t region = 0; region < _regions.get().size(); region++)
@@ -214,7 +210,7 @@ D5xNvmFlash::writeOptions()
     }
 
     // Erase and write the user page if modified
-    if (userPage)
+    if (modified)
     {
         // Configure manual page write and disable caches
         writeRegU16(NVM_REG_CTRLA, (readRegU16(NVM_REG_CTRLA) | (0x3 << 14)) & 0xffcf);
@@ -234,9 +230,8 @@ D5xNvmFlash::writeOptions()
 
             // Copy quad word to page buffer
             _wordCopy.setDstAddr(NVM_UP_ADDR + offset);
-            _wordCopy.setSrcAddr(_onBufferA ? _pageBufferA : _pageBufferB);
+            _wordCopy.setSrcAddr(nextBuffer());
             _wordCopy.setWords(4);
-            _onBufferA = !_onBufferA;
             waitReady();
             _wordCopy.runv();
 
@@ -247,7 +242,7 @@ D5xNvmFlash::writeOptions()
     }
 
     // Always do security last
-    if (_security.isDirty() && _security.get() == true && _security.get() != getSecurity())
+    if (_security.isDirty() && _security.get() == true && _security.get() != current.security)
     {
         command(NVM_CMD_SSB);
     }
@@ -261,29 +256,28 @@ D5xNvmFlash::writePage(uint32_t page)
         throw FlashPageError();
     }
 
-    // Configure manual page write and disable caches
-    writeRegU16(NVM_REG_CTRLA, (readRegU16(NVM_REG_CTRLA) | (0x3 << 14)) & 0xffcf);
-
     // Auto-erase if writing at the start of the erase page
     if (_eraseAuto && page % ERASE_BLOCK_PAGES == 0)
     {
         erase(page * _size, ERASE_BLOCK_PAGES * _size);
     }
 
-    // Clear page bur
-    command(NVM_CMD_PBC);
-
     uint32_t addr = _addr + (page * _size );
+    VmProgram program;
 
-    _wordCopy.setDstAddr(addr);
-    _wordCopy.setSrcAddr(_onBufferA ? _pageBufferA : _pageBufferB);
-    _wordCopy.setWords(_size / sizeof(uint32_t));
-    _onBufferA = !_onBufferA;
-    waitReady();
-    _wordCopy.runv();
-
-    writeRegU32(NVM_REG_ADDR, addr);
-    command(NVM_CMD_WP);
+    // Configure manual page write and disable caches
+    program.read(NVM_REG(NVM_REG_CTRLA), true)
+           .orAcc(0x3 << 14)
+           .andAcc(0xffcf)
+           .writeAcc(NVM_REG(NVM_REG_CTRLA), true);
+
+    // Clear page buffer, copy the page to it and write it in one run
+    command(program, NVM_CMD_PBC);
+    program.copy(addr, nextBuffer(), _size / sizeof(uint32_t))
+           .write(NVM_REG(NVM_REG_ADDR), addr);
+    command(program, NVM_CMD_WP);
+
+    execute(program);
 }
 
 void
@@ -307,8 +301,11 @@ D5xNvmFlash::readRegU16(uint8_t reg)
 void
 D5xNvmFlash::writeRegU16(uint8_t reg, uint16_t value)
 {
-    _samba.writeByte(NVM_REG_BASE + reg, value & 0xff);
-    _samba.writeByte(NVM_REG_BASE + reg + 1, value >> 8);
+    VmProgram program;
+
+    // A single halfword store so the register never sees half a value
+    program.write(NVM_REG(reg), value, true);
+    _vm.execute(program);
 }
 
 uint32_t
@@ -323,21 +320,50 @@ D5xNvmFlash::writeRegU32(uint8_t reg, uint32_t value)
     _samba.writeWord(NVM_REG_BASE + reg, value);
 }
 
+void
+D5xNvmFlash::command(VmProgram& program, uint8_t cmd)
+{
+    uint32_t done;
+
+    program.poll(NVM_REG(NVM_REG_STATUS), 0x1, 0x1, 0, 0, true)
+           .write(NVM_REG(NVM_REG_CTRLB), CMDEX_KEY | cmd)
+           .poll(NVM_REG(NVM_REG_STATUS), 0x1, 0x1, 0, 0, true)
+           .read(NVM_REG(NVM_REG_INTFLAG), true);
+
+    // On error clear the error bits before stopping so the host does not
+    // need another round trip
+    done = program.branch(0xce, 0);
+    program.write(NVM_REG(NVM_REG_INTFLAG), 0xce, true)
+           .halt(NVM_STATUS_CMD_ERROR)
+           .target(done);
+}
+
 void
 D5xNvmFlash::command(uint8_t cmd)
 {
-    waitReady();
+    VmProgram program;
 
-    writeRegU32(NVM_REG_CTRLB, CMDEX_KEY | cmd);
+    command(program, cmd);
+    execute(program);
+}
 
-    waitReady();
+void
+D5xNvmFlash::execute(VmProgram& program)
+{
+    if (program.empty())
+        return;
+
+    uint32_t status = _vm.execute(program);
+    program.clear();
 
-    if (readRegU16(NVM_REG_INTFLAG) & 0xce)
+    if (status == NVM_STATUS_CMD_ERROR)
     {
-        // Clear the error bits
-        writeRegU16(NVM_REG_INTFLAG, 0xce);
         throw FlashCmdError();
     }
+    else if (status != VmApplet::StatusOk)
+    {
+        throw FlashTimeoutError();
+    }
 }
 
 void
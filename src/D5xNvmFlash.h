@@ -33,29 +33,20 @@ public:
         const std::string& name,
         uint32_t pages,
         uint32_t size,
-        uint32_t user,
-        uint32_t stack);
+        const SramMap& sram);
 
     virtual ~D5xNvmFlash();
 
+    uint32_t pagesPerErase();
+    uint32_t decodeRate() { return 8000; }
+
     void eraseAll(uint32_t offset);
     void eraseAuto(bool enable);
 
-    std::vector<bool> getLockRegions();
-
-    bool getSecurity();
-
-    bool getBod();
     bool canBod() { return true; }
-
-    bool getBor();
     bool canBor() { return true; }
-
-    bool getBootFlash();
     bool canBootFlash() { return false; }
 
-    std::vector<uint32_t> getUniqueId() { return std::vector<uint32_t>(); }
-
     void writeOptions();
 
     void writePage(uint32_t page);
@@ -73,9 +64,11 @@ protected:
 
     void waitReady();
     void command(uint8_t cmd);
+    void command(VmProgram& program, uint8_t cmd);
+    void execute(VmProgram& program);
     void erase(uint32_t offset, uint32_t size);
     void checkError();
-    void readUserPage(std::unique_ptr<uint8_t[]>& userPage);
+    void readSnapshot(FlashSnapshot& snapshot);
 };
 
 #endif // _D5XNVMFLASH_H
@@ -48,7 +48,6 @@ Device::readChipId(uint32_t& chipId, uint32_t& extChipId)
 void
 Device::create()
 {
-    Flash* flashPtr;
     uint32_t chipId = 0;
     uint32_t cpuId = 0;
     uint32_t extChipId = 0;
@@ -95,6 +94,15 @@ Device::create()
         }
     }
 
+    create(chipId, extChipId, deviceId);
+    _flash->init();
+}
+
+void
+Device::create(uint32_t chipId, uint32_t extChipId, uint32_t deviceId)
+{
+    Flash* flashPtr;
+
     // Instantiate the proper flash for the device
     switch (chipId & 0x7fffffe0)
     {
@@ -103,74 +111,74 @@ Device::create()
     //
     case 0x272a0a40:
         _family = FAMILY_SAM7SE;
-        flashPtr = new EfcFlash(_samba, "AT91SAM7SE512", 0x100000, 2048, 256, 2, 32, 0x202000, 0x208000, true);
+        flashPtr = new EfcFlash(_samba, "AT91SAM7SE512", 0x100000, 2048, 256, 2, 32, SramMap(0x200000, 0x8000).reserve(0x200000, 0x2000).reserve(0x207000, 0x1000), true);
         break;
     case 0x272a0940:
         _family = FAMILY_SAM7SE;
-        flashPtr = new EfcFlash(_samba, "AT91SAM7SE256", 0x100000, 1024, 256, 1, 16, 0x202000, 0x208000, true);
+        flashPtr = new EfcFlash(_samba, "AT91SAM7SE256", 0x100000, 1024, 256, 1, 16, SramMap(0x200000, 0x8000).reserve(0x200000, 0x2000).reserve(0x207000, 0x1000), true);
         break;
     case 0x272a0340:
         _family = FAMILY_SAM7SE;
-        flashPtr = new EfcFlash(_samba, "AT91SAM7SE32", 0x100000, 256, 128, 1, 8, 0x201400, 0x201C00, true);
+        flashPtr = new EfcFlash(_samba, "AT91SAM7SE32", 0x100000, 256, 128, 1, 8, SramMap(0x200000, 0x2000).reserve(0x200000, 0x1400).reserve(0x201c00, 0x400), true);
         break;
     //
     // SAM7S
     //
     case 0x270b0a40:
         _family = FAMILY_SAM7S;
-        flashPtr = new EfcFlash(_samba, "AT91SAM7S512", 0x100000, 2048, 256, 2, 32, 0x202000, 0x210000, false);
+        flashPtr = new EfcFlash(_samba, "AT91SAM7S512", 0x100000, 2048, 256, 2, 32, SramMap(0x200000, 0x10000).reserve(0x200000, 0x2000).reserve(0x20f000, 0x1000), false);
         break;
     case 0x270d0940: // A
     case 0x270b0940: // B/C
         _family = FAMILY_SAM7S;
-        flashPtr = new EfcFlash(_samba, "AT91SAM7S256", 0x100000, 1024, 256, 1, 16, 0x202000, 0x210000, false);
+        flashPtr = new EfcFlash(_samba, "AT91SAM7S256", 0x100000, 1024, 256, 1, 16, SramMap(0x200000, 0x10000).reserve(0x200000, 0x2000).reserve(0x20f000, 0x1000), false);
         break;
     case 0x270c0740: // A
     case 0x270a0740: // B/C
         _family = FAMILY_SAM7S;
-        flashPtr = new EfcFlash(_samba, "AT91SAM7S128", 0x100000, 512, 256, 1, 8, 0x202000, 0x208000, false);
+        flashPtr = new EfcFlash(_samba, "AT91SAM7S128", 0x100000, 512, 256, 1, 8, SramMap(0x200000, 0x8000).reserve(0x200000, 0x2000).reserve(0x207000, 0x1000), false);
         break;
     case 0x27090540:
         _family = FAMILY_SAM7S;
-        flashPtr = new EfcFlash(_samba, "AT91SAM7S64", 0x100000, 512, 128, 1, 16, 0x202000, 0x204000, false);
+        flashPtr = new EfcFlash(_samba, "AT91SAM7S64", 0x100000, 512, 128, 1, 16, SramMap(0x200000, 0x4000).reserve(0x200000, 0x2000).reserve(0x203800, 0x800), false);
         break;
     case 0x27080340:
         _family = FAMILY_SAM7S;
-        flashPtr = new EfcFlash(_samba, "AT91SAM7S32", 0x100000, 256, 128, 1, 8, 0x201400, 0x202000, false);
+        flashPtr = new EfcFlash(_samba, "AT91SAM7S32", 0x100000, 256, 128, 1, 8, SramMap(0x200000, 0x2000).reserve(0x200000, 0x1400).reserve(0x201f00, 0x100), false);
         break;
     case 0x27050240:
         _family = FAMILY_SAM7S;
-        flashPtr = new EfcFlash(_samba, "AT91SAM7S16", 0x100000, 256, 64, 1, 8, 0x200000, 0x200e00, false);
+        flashPtr = new EfcFlash(_samba, "AT91SAM7S16", 0x100000, 256, 64, 1, 8, SramMap(0x200000, 0x1000).reserve(0x200e00, 0x200), false);
         break;
     //
     // SAM7XC
     //
     case 0x271c0a40:
         _family = FAMILY_SAM7XC;
-        flashPtr = new EfcFlash(_samba, "AT91SAMXC512", 0x100000, 2048, 256, 2, 32, 0x202000, 0x220000, true);
+        flashPtr = new EfcFlash(_samba, "AT91SAMXC512", 0x100000, 2048, 256, 2, 32, SramMap(0x200000, 0x20000).reserve(0x200000, 0x2000).reserve(0x21f000, 0x1000), true);
         break;
     case 0x271b0940:
         _family = FAMILY_SAM7XC;
-        flashPtr = new EfcFlash(_samba, "AT91SAMXC256", 0x100000, 1024, 256, 1, 16, 0x202000, 0x210000, true);
+        flashPtr = new EfcFlash(_samba, "AT91SAMXC256", 0x100000, 1024, 256, 1, 16, SramMap(0x200000, 0x10000).reserve(0x200000, 0x2000).reserve(0x20f000, 0x1000), true);
         break;
     case 0x271a0740:
         _family = FAMILY_SAM7XC;
-        flashPtr = new EfcFlash(_samba, "AT91SAMXC128", 0x100000, 512, 256, 1, 8, 0x202000, 0x208000, true);
+        flashPtr = new EfcFlash(_samba, "AT91SAMXC128", 0x100000, 512, 256, 1, 8, SramMap(0x200000, 0x8000).reserve(0x200000, 0x2000).reserve(0x207000, 0x1000), true);
         break;
     //
     // SAM7X
     //
     case 0x275c0a40:
         _family = FAMILY_SAM7X;
-        flashPtr = new EfcFlash(_samba, "AT91SAMX512", 0x100000, 2048, 256, 2, 32, 0x202000, 0x220000, true);
+        flashPtr = new EfcFlash(_samba, "AT91SAMX512", 0x100000, 2048, 256, 2, 32, SramMap(0x200000, 0x20000).reserve(0x200000, 0x2000).reserve(0x21f000, 0x1000), true);
         break;
     case 0x275b0940:
         _family = FAMILY_SAM7X;
-        flashPtr = new EfcFlash(_samba, "AT91SAMX256", 0x100000, 1024, 256, 1, 16, 0x202000, 0x210000, true);
+        flashPtr = new EfcFlash(_samba, "AT91SAMX256", 0x100000, 1024, 256, 1, 16, SramMap(0x200000, 0x10000).reserve(0x200000, 0x2000).reserve(0x20f000, 0x1000), true);
         break;
     case 0x275a0740:
         _family = FAMILY_SAM7X;
-        flashPtr = new EfcFlash(_samba, "AT91SAMX128", 0x100000, 512, 256, 1, 8, 0x202000, 0x208000, true);
+        flashPtr = new EfcFlash(_samba, "AT91SAMX128", 0x100000, 512, 256, 1, 8, SramMap(0x200000, 0x8000).reserve(0x200000, 0x2000).reserve(0x207000, 0x1000), true);
         break;
     //
     // SAM4S
@@ -179,43 +187,43 @@ Device::create()
     case 0x29970ee0: // B
     case 0x29A70ee0: // C
         _family = FAMILY_SAM4S;
-        flashPtr = new EefcFlash(_samba, "ATSAM4SD32", 0x400000, 4096, 512, 2, 256, 4, 0x20001000, 0x20010000, 0x400e0a00, false);
+        flashPtr = new EefcFlash(_samba, "ATSAM4SD32", 0x400000, 4096, 512, 2, 256, 4, SramMap(0x20000000, 0x10000).reserve(0x20000000, 0x1000).reserve(0x2000f000, 0x1000), 0x400e0a00, false);
         break;
     case 0x29870c30: // A
     case 0x29970c30: // B
     case 0x29a70c30: // C
         _family = FAMILY_SAM4S;
-        flashPtr = new EefcFlash(_samba, "ATSAM4SD16", 0x400000, 2048, 512, 2, 256, 4, 0x20001000, 0x20010000, 0x400e0a00, false);
+        flashPtr = new EefcFlash(_samba, "ATSAM4SD16", 0x400000, 2048, 512, 2, 256, 4, SramMap(0x20000000, 0x10000).reserve(0x20000000, 0x1000).reserve(0x2000f000, 0x1000), 0x400e0a00, false);
         break;
     case 0x28870ce0: // A
     case 0x28970ce0: // B
     case 0x28A70ce0: // C
         _family = FAMILY_SAM4S;
-        flashPtr = new EefcFlash(_samba, "ATSAM4SA16", 0x400000, 2048, 512, 1, 256, 4, 0x20001000, 0x20010000, 0x400e0a00, false);
+        flashPtr = new EefcFlash(_samba, "ATSAM4SA16", 0x400000, 2048, 512, 1, 256, 4, SramMap(0x20000000, 0x10000).reserve(0x20000000, 0x1000).reserve(0x2000f000, 0x1000), 0x400e0a00, false);
         break;
     case 0x288c0ce0 : // A
     case 0x289c0ce0 : // B
     case 0x28ac0ce0 : // C
         _family = FAMILY_SAM4S;
-        flashPtr = new EefcFlash(_samba, "ATSAM4S16", 0x400000, 2048, 512, 1, 128, 4, 0x20001000, 0x20020000, 0x400e0a00, false);
+        flashPtr = new EefcFlash(_samba, "ATSAM4S16", 0x400000, 2048, 512, 1, 128, 4, SramMap(0x20000000, 0x20000).reserve(0x20000000, 0x1000).reserve(0x2001f000, 0x1000), 0x400e0a00, false);
         break;
     case 0x288c0ae0 : // A
     case 0x289c0ae0 : // B
     case 0x28ac0ae0 : // C
         _family = FAMILY_SAM4S;
-        flashPtr = new EefcFlash(_samba, "ATSAM4S8", 0x400000, 1024, 512, 1, 64, 4, 0x20001000, 0x20020000, 0x400e0a00, false);
+        flashPtr = new EefcFlash(_samba, "ATSAM4S8", 0x400000, 1024, 512, 1, 64, 4, SramMap(0x20000000, 0x20000).reserve(0x20000000, 0x1000).reserve(0x2001f000, 0x1000), 0x400e0a00, false);
         break;
     case 0x288b09e0 : // A
     case 0x289b09e0 : // B
     case 0x28ab09e0 : // C
         _family = FAMILY_SAM4S;
-        flashPtr = new EefcFlash(_samba, "ATSAM4S4", 0x400000, 512, 512, 1, 32, 4, 0x20001000, 0x20010000, 0x400e0a00, false);
+        flashPtr = new EefcFlash(_samba, "ATSAM4S4", 0x400000, 512, 512, 1, 32, 4, SramMap(0x20000000, 0x10000).reserve(0x20000000, 0x1000).reserve(0x2000f000, 0x1000), 0x400e0a00, false);
         break;
     case 0x288b07e0 : // A
     case 0x289b07e0 : // B
     case 0x28ab07e0 : // C
         _family = FAMILY_SAM4S;
-        flashPtr = new EefcFlash(_samba, "ATSAM4S2", 0x400000, 256, 512, 1, 16, 4, 0x20001000, 0x20010000, 0x400e0a00, false);
+        flashPtr = new EefcFlash(_samba, "ATSAM4S2", 0x400000, 256, 512, 1, 16, 4, SramMap(0x20000000, 0x10000).reserve(0x20000000, 0x1000).reserve(0x2000f000, 0x1000), 0x400e0a00, false);
         break;
     //
     // SAM3N
@@ -224,25 +232,25 @@ Device::create()
     case 0x29440960 : // B
     case 0x29540960 : // C
         _family = FAMILY_SAM3N;
-        flashPtr = new EefcFlash(_samba, "ATSAM3N4", 0x400000, 1024, 256, 1, 16, 4, 0x20001000, 0x20006000, 0x400e0a00, false);
+        flashPtr = new EefcFlash(_samba, "ATSAM3N4", 0x400000, 1024, 256, 1, 16, 4, SramMap(0x20000000, 0x6000).reserve(0x20000000, 0x1000).reserve(0x20005800, 0x800), 0x400e0a00, false);
         break;
     case 0x29390760 : // A
     case 0x29490760 : // B
     case 0x29590760 : // C
         _family = FAMILY_SAM3N;
-        flashPtr = new EefcFlash(_samba, "ATSAM3N2", 0x400000, 512, 256, 1, 8, 4, 0x20001000, 0x20004000, 0x400e0a00, false);
+        flashPtr = new EefcFlash(_samba, "ATSAM3N2", 0x400000, 512, 256, 1, 8, 4, SramMap(0x20000000, 0x4000).reserve(0x20000000, 0x1000).reserve(0x20003800, 0x800), 0x400e0a00, false);
         break;
     case 0x29380560 : // A
     case 0x29480560 : // B
     case 0x29580560 : // C
         _family = FAMILY_SAM3N;
-        flashPtr = new EefcFlash(_samba, "ATSAM3N1", 0x400000, 256, 256, 1, 4, 4, 0x20000800, 0x20002000, 0x400e0a00, false);
+        flashPtr = new EefcFlash(_samba, "ATSAM3N1", 0x400000, 256, 256, 1, 4, 4, SramMap(0x20000000, 0x2000).reserve(0x20000000, 0x800).reserve(0x20001c00, 0x400), 0x400e0a00, false);
         break;
     case 0x29380360 : // A
     case 0x29480360 : // B
     case 0x29580360 : // C
         _family = FAMILY_SAM3N;
-        flashPtr = new EefcFlash(_samba, "ATSAM3N0", 0x400000, 128, 256, 1, 1, 4, 0x20000800, 0x20002000, 0x400e0a00, false);
+        flashPtr = new EefcFlash(_samba, "ATSAM3N0", 0x400000, 128, 256, 1, 1, 4, SramMap(0x20000000, 0x2000).reserve(0x20000000, 0x800).reserve(0x20001c00, 0x400), 0x400e0a00, false);
         break;
     //
     // SAM3S
@@ -250,30 +258,30 @@ Device::create()
     case 0x299b0a60 : // B
     case 0x29ab0a60 : // C
         _family = FAMILY_SAM3S;
-        flashPtr = new EefcFlash(_samba, "ATSAM3SD8", 0x400000, 2048, 256, 1, 16, 4, 0x20001000, 0x20010000, 0x400e0a00, false);
+        flashPtr = new EefcFlash(_samba, "ATSAM3SD8", 0x400000, 2048, 256, 1, 16, 4, SramMap(0x20000000, 0x10000).reserve(0x20000000, 0x1000).reserve(0x2000f000, 0x1000), 0x400e0a00, false);
         break;
     case 0x289b0a60 : // B
     case 0x28ab0a60 : // C
         _family = FAMILY_SAM3S;
-        flashPtr = new EefcFlash(_samba, "ATSAM3S8", 0x400000, 2048, 256, 1, 16, 4, 0x20001000, 0x20010000, 0x400e0a00, false);
+        flashPtr = new EefcFlash(_samba, "ATSAM3S8", 0x400000, 2048, 256, 1, 16, 4, SramMap(0x20000000, 0x10000).reserve(0x20000000, 0x1000).reserve(0x2000f000, 0x1000), 0x400e0a00, false);
         break;
     case 0x28800960 : // A
     case 0x28900960 : // B
     case 0x28a00960 : // C
         _family = FAMILY_SAM3S;
-        flashPtr = new EefcFlash(_samba, "ATSAM3S4", 0x400000, 1024, 256, 1, 16, 4, 0x20001000, 0x2000c000, 0x400e0a00, false);
+        flashPtr = new EefcFlash(_samba, "ATSAM3S4", 0x400000, 1024, 256, 1, 16, 4, SramMap(0x20000000, 0xc000).reserve(0x20000000, 0x1000).reserve(0x2000b000, 0x1000), 0x400e0a00, false);
         break;
     case 0x288a0760 : // A
     case 0x289a0760 : // B
     case 0x28aa0760 : // C
         _family = FAMILY_SAM3S;
-        flashPtr = new EefcFlash(_samba, "ATSAM3S2", 0x400000, 512, 256, 1, 8, 4, 0x20000800, 0x20008000, 0x400e0a00, false);
+        flashPtr = new EefcFlash(_samba, "ATSAM3S2", 0x400000, 512, 256, 1, 8, 4, SramMap(0x20000000, 0x8000).reserve(0x20000000, 0x800).reserve(0x20007000, 0x1000), 0x400e0a00, false);
         break;
     case 0x28890560 : // A
     case 0x28990560 : // B
     case 0x28a90560 : // C
         _family = FAMILY_SAM3S;
-        flashPtr = new EefcFlash(_samba, "ATSAM3S1", 0x400000, 256, 256, 1, 4, 4, 0x20000800, 0x20004000, 0x400e0a00, false);
+        flashPtr = new EefcFlash(_samba, "ATSAM3S1", 0x400000, 256, 256, 1, 4, 4, SramMap(0x20000000, 0x4000).reserve(0x20000000, 0x800).reserve(0x20003800, 0x800), 0x400e0a00, false);
         break;
     //
     // SAM3U
@@ -281,17 +289,17 @@ Device::create()
     case 0x28000960 : // C
     case 0x28100960 : // E
         _family = FAMILY_SAM3U;
-        flashPtr = new EefcFlash(_samba, "ATSAM3U4", 0xE0000, 1024, 256, 2, 32, 4, 0x20001000, 0x20008000, 0x400e0800, false);
+        flashPtr = new EefcFlash(_samba, "ATSAM3U4", 0xE0000, 1024, 256, 2, 32, 4, SramMap(0x20000000, 0x8000).reserve(0x20000000, 0x1000).reserve(0x20007000, 0x1000), 0x400e0800, false);
         break;
     case 0x280a0760 : // C
     case 0x281a0760 : // E
         _family = FAMILY_SAM3U;
-        flashPtr = new EefcFlash(_samba, "ATSAM3U2", 0x80000, 512, 256, 1, 16, 4, 0x20001000, 0x20004000, 0x400e0800, false);
+        flashPtr = new EefcFlash(_samba, "ATSAM3U2", 0x80000, 512, 256, 1, 16, 4, SramMap(0x20000000, 0x4000).reserve(0x20000000, 0x1000).reserve(0x20003800, 0x800), 0x400e0800, false);
         break;
     case 0x28090560 : // C
     case 0x28190560 : // E
         _family = FAMILY_SAM3U;
-        flashPtr = new EefcFlash(_samba, "ATSAM3U1", 0x80000, 256, 256, 1, 8, 4, 0x20001000, 0x20002000, 0x400e0800, false);
+        flashPtr = new EefcFlash(_samba, "ATSAM3U1", 0x80000, 256, 256, 1, 8, 4, SramMap(0x20000000, 0x2000).reserve(0x20000000, 0x1000).reserve(0x20001c00, 0x400), 0x400e0800, false);
         break;
     //
     // SAM3X
@@ -300,49 +308,49 @@ Device::create()
     case 0x285e0a60 : // 8E
     case 0x284e0a60 : // 8C
         _family = FAMILY_SAM3X;
-        flashPtr = new EefcFlash(_samba, "ATSAM3X8", 0x80000, 2048, 256, 2, 32, 4, 0x20001000, 0x20010000, 0x400e0a00, false);
+        flashPtr = new EefcFlash(_samba, "ATSAM3X8", 0x80000, 2048, 256, 2, 32, 4, SramMap(0x20000000, 0x10000).reserve(0x20000000, 0x1000).reserve(0x2000f000, 0x1000), 0x400e0a00, false);
         break;
     case 0x285b0960 : // 4E
     case 0x284b0960 : // 4C
         _family = FAMILY_SAM3X;
-        flashPtr = new EefcFlash(_samba, "ATSAM3X4", 0x80000, 1024, 256, 2, 16, 4, 0x20001000, 0x20008000, 0x400e0a00, false);
+        flashPtr = new EefcFlash(_samba, "ATSAM3X4", 0x80000, 1024, 256, 2, 16, 4, SramMap(0x20000000, 0x8000).reserve(0x20000000, 0x1000).reserve(0x20007000, 0x1000), 0x400e0a00, false);
         break;
     //
     // SAM3A
     //
     case 0x283e0A60 : // 8C
         _family = FAMILY_SAM3A;
-        flashPtr = new EefcFlash(_samba, "ATSAM3A8", 0x80000, 2048, 256, 2, 32, 4, 0x20001000, 0x20010000, 0x400e0a00, false);
+        flashPtr = new EefcFlash(_samba, "ATSAM3A8", 0x80000, 2048, 256, 2, 32, 4, SramMap(0x20000000, 0x10000).reserve(0x20000000, 0x1000).reserve(0x2000f000, 0x1000), 0x400e0a00, false);
         break;
     case 0x283b0960 : // 4C
         _family = FAMILY_SAM3A;
-        flashPtr = new EefcFlash(_samba, "ATSAM3A4", 0x80000, 1024, 256, 2, 16, 4, 0x20001000, 0x20008000, 0x400e0a00, false);
+        flashPtr = new EefcFlash(_samba, "ATSAM3A4", 0x80000, 1024, 256, 2, 16, 4, SramMap(0x20000000, 0x8000).reserve(0x20000000, 0x1000).reserve(0x20007000, 0x1000), 0x400e0a00, false);
         break;
     //
     // SAM7L
     //
     case 0x27330740 :
         _family = FAMILY_SAM7L;
-        flashPtr = new EefcFlash(_samba, "ATSAM7L128", 0x100000, 512, 256, 1, 16, 0, 0x2ffb40, 0x300700, 0xffffff60, false);
+        flashPtr = new EefcFlash(_samba, "ATSAM7L128", 0x100000, 512, 256, 1, 16, 0, SramMap(0x2ff000, 0x1800).reserve(0x2ff000, 0xb40).reserve(0x300700, 0x100), 0xffffff60, false);
         break;
     case 0x27330540 :
         _family = FAMILY_SAM7L;
-        flashPtr = new EefcFlash(_samba, "ATSAM7L64", 0x100000, 256, 256, 1, 8, 0, 0x2ffb40, 0x300700, 0xffffff60, false);
+        flashPtr = new EefcFlash(_samba, "ATSAM7L64", 0x100000, 256, 256, 1, 8, 0, SramMap(0x2ff000, 0x1800).reserve(0x2ff000, 0xb40).reserve(0x300700, 0x100), 0xffffff60, false);
         break;
     //
     // SAM9XE
     //
     case 0x329aa3a0 :
         _family = FAMILY_SAM9XE;
-        flashPtr = new EefcFlash(_samba, "ATSAM9XE512", 0x200000, 1024, 512, 1, 32, 0, 0x300000, 0x307000, 0xfffffa00, true);
+        flashPtr = new EefcFlash(_samba, "ATSAM9XE512", 0x200000, 1024, 512, 1, 32, 0, SramMap(0x300000, 0x8000).reserve(0x307000, 0x1000), 0xfffffa00, true);
         break;
     case 0x329a93a0 :
         _family = FAMILY_SAM9XE;
-        flashPtr = new EefcFlash(_samba, "ATSAM9XE256", 0x200000, 512, 512, 1, 16, 0, 0x300000, 0x307000, 0xfffffa00, true);
+        flashPtr = new EefcFlash(_samba, "ATSAM9XE256", 0x200000, 512, 512, 1, 16, 0, SramMap(0x300000, 0x8000).reserve(0x307000, 0x1000), 0xfffffa00, true);
         break;
     case 0x329973a0 :
         _family = FAMILY_SAM9XE;
-        flashPtr = new EefcFlash(_samba, "ATSAM9XE128", 0x200000, 256, 512, 1, 8, 0, 0x300000, 0x303000, 0xfffffa00, true);
+        flashPtr = new EefcFlash(_samba, "ATSAM9XE128", 0x200000, 256, 512, 1, 8, 0, SramMap(0x300000, 0x4000).reserve(0x303000, 0x1000), 0xfffffa00, true);
         break;
     //
     // SAM4E
@@ -353,12 +361,15 @@ Device::create()
         case 0x00120200: // E
         case 0x00120201: // C
             _family = FAMILY_SAM4E;
-            flashPtr = new EefcFlash(_samba, "ATSAM4E16", 0x400000, 2048, 512, 1, 128, 4, 0x20001000, 0x20020000, 0x400e0a00, false);
+            flashPtr = new EefcFlash(_samba, "ATSAM4E16", 0x400000, 2048, 512, 1, 128, 4, SramMap(0x20000000, 0x20000).reserve(0x20000000, 0x1000).reserve(0x2001f000, 0x1000), 0x400e0a00, false);
             break;
         case 0x00120208: // E
         case 0x00120209: // C
             _family = FAMILY_SAM4E;
-            flashPtr = new EefcFlash(_samba, "ATSAM4E8", 0x400000, 1024, 512, 1, 64, 4, 0x20001000, 0x20020000, 0x400e0a00, false);
+            flashPtr = new EefcFlash(_samba, "ATSAM4E8", 0x400000, 1024, 512, 1, 64, 4, SramMap(0x20000000, 0x20000).reserve(0x20000000, 0x1000).reserve(0x2001f000, 0x1000), 0x400e0a00, false);
+            break;
+        default:
+            throw DeviceUnsupportedError();
             break;
         }
         break;
@@ -367,56 +378,56 @@ Device::create()
     //
     case 0x210d0a00:
         _family = FAMILY_SAME70;
-        flashPtr = new EefcFlash(_samba, "ATSAME70x19", 0x400000, 1024, 512, 1, 32, 4, 0x20401000, 0x20404000, 0x400e0c00, false);
+        flashPtr = new EefcFlash(_samba, "ATSAME70x19", 0x400000, 1024, 512, 1, 32, 4, SramMap(0x20400000, 0x40000).reserve(0x20400000, 0x1000).reserve(0x2043e000, 0x2000), 0x400e0c00, false);
         break;
     case 0x21020c00:
         _family = FAMILY_SAME70;
-        flashPtr = new EefcFlash(_samba, "ATSAME70x20", 0x400000, 2048, 512, 1, 64, 4, 0x20401000, 0x20404000, 0x400e0c00, false);
+        flashPtr = new EefcFlash(_samba, "ATSAME70x20", 0x400000, 2048, 512, 1, 64, 4, SramMap(0x20400000, 0x60000).reserve(0x20400000, 0x1000).reserve(0x2045e000, 0x2000), 0x400e0c00, false);
         break;
     case 0x21020e00:
         _family = FAMILY_SAME70;
-        flashPtr = new EefcFlash(_samba, "ATSAME70x21", 0x400000, 4096, 512, 1, 128, 4, 0x20401000, 0x20404000, 0x400e0c00, false);
+        flashPtr = new EefcFlash(_samba, "ATSAME70x21", 0x400000, 4096, 512, 1, 128, 4, SramMap(0x20400000, 0x60000).reserve(0x20400000, 0x1000).reserve(0x2045e000, 0x2000), 0x400e0c00, false);
         break;
     //
     // SAMS70
     //
     case 0x211d0a00:
         _family = FAMILY_SAMS70;
-        flashPtr = new EefcFlash(_samba, "ATSAMS70x19", 0x400000, 1024, 512, 1, 32, 4, 0x20401000, 0x20404000, 0x400e0c00, false);
+        flashPtr = new EefcFlash(_samba, "ATSAMS70x19", 0x400000, 1024, 512, 1, 32, 4, SramMap(0x20400000, 0x40000).reserve(0x20400000, 0x1000).reserve(0x2043e000, 0x2000), 0x400e0c00, false);
         break;
     case 0x21120c00:
         _family = FAMILY_SAMS70;
-        flashPtr = new EefcFlash(_samba, "ATSAMS70x20", 0x400000, 2048, 512, 1, 64, 4, 0x20401000, 0x20404000, 0x400e0c00, false);
+        flashPtr = new EefcFlash(_samba, "ATSAMS70x20", 0x400000, 2048, 512, 1, 64, 4, SramMap(0x20400000, 0x60000).reserve(0x20400000, 0x1000).reserve(0x2045e000, 0x2000), 0x400e0c00, false);
         break;
     case 0x21120e00:
         _family = FAMILY_SAMS70;
-        flashPtr = new EefcFlash(_samba, "ATSAMS70x21", 0x400000, 4096, 512, 1, 128, 4, 0x20401000, 0x20404000, 0x400e0c00, false);
+        flashPtr = new EefcFlash(_samba, "ATSAMS70x21", 0x400000, 4096, 512, 1, 128, 4, SramMap(0x20400000, 0x60000).reserve(0x20400000, 0x1000).reserve(0x2045e000, 0x2000), 0x400e0c00, false);
         break;
     //
     // SAMV70
     //
     case 0x213d0a00:
         _family = FAMILY_SAMV70;
-        flashPtr = new EefcFlash(_samba, "ATSAMV70x19", 0x400000, 1024, 512, 1, 32, 4, 0x20401000, 0x20404000, 0x400e0c00, false);
+        flashPtr = new EefcFlash(_samba, "ATSAMV70x19", 0x400000, 1024, 512, 1, 32, 4, SramMap(0x20400000, 0x40000).reserve(0x20400000, 0x1000).reserve(0x2043e000, 0x2000), 0x400e0c00, false);
         break;
     case 0x21320c00:
         _family = FAMILY_SAMV70;
-        flashPtr = new EefcFlash(_samba, "ATSAMV70x20", 0x400000, 2048, 512, 1, 64, 4, 0x20401000, 0x20404000, 0x400e0c00, false);
+        flashPtr = new EefcFlash(_samba, "ATSAMV70x20", 0x400000, 2048, 512, 1, 64, 4, SramMap(0x20400000, 0x60000).reserve(0x20400000, 0x1000).reserve(0x2045e000, 0x2000), 0x400e0c00, false);
         break;
     //
     // SAMV71
     //
     case 0x212d0a00:
         _family = FAMILY_SAMV71;
-        flashPtr = new EefcFlash(_samba, "ATSAMV71x19", 0x400000, 1024, 512, 1, 32, 4, 0x20401000, 0x20404000, 0x400e0c00, false);
+        flashPtr = new EefcFlash(_samba, "ATSAMV71x19", 0x400000, 1024, 512, 1, 32, 4, SramMap(0x20400000, 0x40000).reserve(0x20400000, 0x1000).reserve(0x2043e000, 0x2000), 0x400e0c00, false);
         break;
     case 0x21220c00:
         _family = FAMILY_SAMV71;
-        flashPtr = new EefcFlash(_samba, "ATSAMV71x20", 0x400000, 2048, 512, 1, 64, 4, 0x20401000, 0x20404000, 0x400e0c00, false);
+        flashPtr = new EefcFlash(_samba, "ATSAMV71x20", 0x400000, 2048, 512, 1, 64, 4, SramMap(0x20400000, 0x60000).reserve(0x20400000, 0x1000).reserve(0x2045e000, 0x2000), 0x400e0c00, false);
         break;
     case 0x21220e00:
         _family = FAMILY_SAMV71;
-        flashPtr = new EefcFlash(_samba, "ATSAMV71x21", 0x400000, 4096, 512, 1, 128, 4, 0x20401000, 0x20404000, 0x400e0c00, false);
+        flashPtr = new EefcFlash(_samba, "ATSAMV71x21", 0x400000, 4096, 512, 1, 128, 4, SramMap(0x20400000, 0x60000).reserve(0x20400000, 0x1000).reserve(0x2045e000, 0x2000), 0x400e0c00, false);
         break;
     //
     // No CHIPID devices
@@ -436,7 +447,7 @@ Device::create()
         case 0x10010056: // E15B WLCSP
         case 0x10010063: // E15C WLCSP
             _family = FAMILY_SAMD21;
-            flashPtr = new D2xNvmFlash(_samba, "ATSAMD21x15", 512, 64, 0x20000800, 0x20001000) ;
+            flashPtr = new D2xNvmFlash(_samba, "ATSAMD21x15", 512, 64, SramMap(0x20000000, 0x1000).reserve(0x20000000, 0x800).reserve(0x20000e00, 0x200)) ;
             break;
 
         case 0x10010002: // J16A
@@ -448,7 +459,7 @@ Device::create()
         case 0x10010055: // E16B WLCSP
         case 0x10010062: // E16C WLCSP
             _family = FAMILY_SAMD21;
-            flashPtr = new D2xNvmFlash(_samba, "ATSAMD21x16", 1024, 64, 0x20001000, 0x20002000) ;
+            flashPtr = new D2xNvmFlash(_samba, "ATSAMD21x16", 1024, 64, SramMap(0x20000000, 0x2000).reserve(0x20000000, 0x1000).reserve(0x20001c00, 0x400)) ;
             break;
 
         case 0x10010001: // J17A
@@ -456,7 +467,7 @@ Device::create()
         case 0x1001000b: // E17A
         case 0x10010010: // G17A WLCSP
             _family = FAMILY_SAMD21;
-            flashPtr = new D2xNvmFlash(_samba, "ATSAMD21x17", 2048, 64, 0x20002000, 0x20004000) ;
+            flashPtr = new D2xNvmFlash(_samba, "ATSAMD21x17", 2048, 64, SramMap(0x20000000, 0x4000).reserve(0x20000000, 0x2000).reserve(0x20003800, 0x800)) ;
             break;
 
         case 0x10010000: // J18A
@@ -464,7 +475,7 @@ Device::create()
         case 0x1001000a: // E18A
         case 0x1001000f: // G18A WLCSP
             _family = FAMILY_SAMD21;
-            flashPtr = new D2xNvmFlash(_samba, "ATSAMD21x18", 4096, 64, 0x20004000, 0x20008000) ;
+            flashPtr = new D2xNvmFlash(_samba, "ATSAMD21x18", 4096, 64, SramMap(0x20000000, 0x8000).reserve(0x20000000, 0x4000).reserve(0x20007000, 0x1000)) ;
             break;
 
         //
@@ -473,24 +484,24 @@ Device::create()
         case 0x1001001e: // E16A
         case 0x1001001b: // G16A
             _family = FAMILY_SAMR21;
-            flashPtr = new D2xNvmFlash(_samba, "ATSAMR21x16", 1024, 64, 0x20001000, 0x20002000) ;
+            flashPtr = new D2xNvmFlash(_samba, "ATSAMR21x16", 1024, 64, SramMap(0x20000000, 0x2000).reserve(0x20000000, 0x1000).reserve(0x20001c00, 0x400)) ;
             break;
 
         case 0x1001001d: // E17A
         case 0x1001001a: // G17A
             _family = FAMILY_SAMR21;
-            flashPtr = new D2xNvmFlash(_samba, "ATSAMR21x17", 2048, 64, 0x20002000, 0x20004000) ;
+            flashPtr = new D2xNvmFlash(_samba, "ATSAMR21x17", 2048, 64, SramMap(0x20000000, 0x4000).reserve(0x20000000, 0x2000).reserve(0x20003800, 0x800)) ;
             break;
 
         case 0x1001001c: // E18A
         case 0x10010019: // G18A
             _family = FAMILY_SAMR21;
-            flashPtr = new D2xNvmFlash(_samba, "ATSAMR21x18", 4096, 64, 0x20004000, 0x20008000) ;
+            flashPtr = new D2xNvmFlash(_samba, "ATSAMR21x18", 4096, 64, SramMap(0x20000000, 0x8000).reserve(0x20000000, 0x4000).reserve(0x20007000, 0x1000)) ;
             break;
 
         case 0x10010018: // E19A
             _family = FAMILY_SAMR21;
-            flashPtr = new D2xNvmFlash(_samba, "ATSAMR21x19", 4096, 64, 0x20004000, 0x20008000) ;
+            flashPtr = new D2xNvmFlash(_samba, "ATSAMR21x19", 4096, 64, SramMap(0x20000000, 0x8000).reserve(0x20000000, 0x4000).reserve(0x20007000, 0x1000)) ;
             break;
 
         //
@@ -499,7 +510,7 @@ Device::create()
         case 0x1081000d: // E15A
         case 0x1081001c: // E15B
             _family = FAMILY_SAMD21;
-            flashPtr = new D2xNvmFlash(_samba, "ATSAML21x15", 512, 64, 0x20000800, 0x20001000) ;
+            flashPtr = new D2xNvmFlash(_samba, "ATSAML21x15", 512, 64, SramMap(0x20000000, 0x1000).reserve(0x20000000, 0x800).reserve(0x20000e00, 0x200)) ;
             break;
 
         case 0x10810002: // J16A
@@ -509,7 +520,7 @@ Device::create()
         case 0x10810016: // G16B
         case 0x1081001b: // E16B
             _family = FAMILY_SAML21;
-            flashPtr = new D2xNvmFlash(_samba, "ATSAML21x16", 1024, 64, 0x20001000, 0x20002000) ;
+            flashPtr = new D2xNvmFlash(_samba, "ATSAML21x16", 1024, 64, SramMap(0x20000000, 0x2000).reserve(0x20000000, 0x1000).reserve(0x20001c00, 0x400)) ;
             break;
 
         case 0x10810001: // J17A
@@ -519,7 +530,7 @@ Device::create()
         case 0x10810015: // G17B
         case 0x1081001a: // E17B
             _family = FAMILY_SAML21;
-            flashPtr = new D2xNvmFlash(_samba, "ATSAML21x17", 2048, 64, 0x20002000, 0x20004000) ;
+            flashPtr = new D2xNvmFlash(_samba, "ATSAML21x17", 2048, 64, SramMap(0x20000000, 0x4000).reserve(0x20000000, 0x2000).reserve(0x20003800, 0x800)) ;
             break;
 
         case 0x10810000: // J18A
@@ -529,7 +540,7 @@ Device::create()
         case 0x10810014: // G18B
         case 0x10810019: // E18B
             _family = FAMILY_SAML21;
-            flashPtr = new D2xNvmFlash(_samba, "ATSAML21x18", 4096, 64, 0x20004000, 0x20008000) ;
+            flashPtr = new D2xNvmFlash(_samba, "ATSAML21x18", 4096, 64, SramMap(0x20000000, 0x8000).reserve(0x20000000, 0x4000).reserve(0x20007000, 0x1000)) ;
             break;
 
         //
@@ -538,7 +549,7 @@ Device::create()
         case 0x60060006: // J18A
         case 0x60060008: // G18A
             _family = FAMILY_SAMD51;
-            flashPtr = new D5xNvmFlash(_samba, "ATSAMD51x18", 512, 512, 0x20004000, 0x20008000) ;
+            flashPtr = new D5xNvmFlash(_samba, "ATSAMD51x18", 512, 512, SramMap(0x20000000, 0x20000).reserve(0x20000000, 0x4000).reserve(0x2001e000, 0x2000)) ;
             break;
 
         case 0x60060001: // P19A
@@ -546,14 +557,14 @@ Device::create()
         case 0x60060005: // J19A
         case 0x60060007: // G19A
             _family = FAMILY_SAMD51;
-            flashPtr = new D5xNvmFlash(_samba, "ATSAMD51x19", 1024, 512, 0x20004000, 0x20008000) ;
+            flashPtr = new D5xNvmFlash(_samba, "ATSAMD51x19", 1024, 512, SramMap(0x20000000, 0x30000).reserve(0x20000000, 0x4000).reserve(0x2002e000, 0x2000)) ;
             break;
 
         case 0x60060000: // P20A
         case 0x60060002: // N20A
         case 0x60060004: // J20A
             _family = FAMILY_SAMD51;
-            flashPtr = new D5xNvmFlash(_samba, "ATSAMD51x20", 2048, 512, 0x20004000, 0x20008000) ;
+            flashPtr = new D5xNvmFlash(_samba, "ATSAMD51x20", 2048, 512, SramMap(0x20000000, 0x40000).reserve(0x20000000, 0x4000).reserve(0x2003e000, 0x2000)) ;
             break;
 
         //
@@ -561,19 +572,19 @@ Device::create()
         //
         case 0x61810003: // J18A
             _family = FAMILY_SAME51;
-            flashPtr = new D5xNvmFlash(_samba, "ATSAME51x18", 512, 512, 0x20004000, 0x20008000) ;
+            flashPtr = new D5xNvmFlash(_samba, "ATSAME51x18", 512, 512, SramMap(0x20000000, 0x20000).reserve(0x20000000, 0x4000).reserve(0x2001e000, 0x2000)) ;
             break;
 
         case 0x61810002: // J19A
         case 0x61810001: // N19A
             _family = FAMILY_SAME51;
-            flashPtr = new D5xNvmFlash(_samba, "ATSAME51x19", 1024, 512, 0x20004000, 0x20008000) ;
+            flashPtr = new D5xNvmFlash(_samba, "ATSAME51x19", 1024, 512, SramMap(0x20000000, 0x30000).reserve(0x20000000, 0x4000).reserve(0x2002e000, 0x2000)) ;
             break;
 
         case 0x61810004: // J20A
         case 0x61810000: // N20A
             _family = FAMILY_SAME51;
-            flashPtr = new D5xNvmFlash(_samba, "ATSAME51x20", 2048, 512, 0x20004000, 0x20008000) ;
+            flashPtr = new D5xNvmFlash(_samba, "ATSAME51x20", 2048, 512, SramMap(0x20000000, 0x40000).reserve(0x20000000, 0x4000).reserve(0x2003e000, 0x2000)) ;
             break;
 
         //
@@ -581,19 +592,19 @@ Device::create()
         //
         case 0x61830006: // J18A
             _family = FAMILY_SAME53;
-            flashPtr = new D5xNvmFlash(_samba, "ATSAME53x18", 512, 512, 0x20004000, 0x20008000) ;
+            flashPtr = new D5xNvmFlash(_samba, "ATSAME53x18", 512, 512, SramMap(0x20000000, 0x20000).reserve(0x20000000, 0x4000).reserve(0x2001e000, 0x2000)) ;
             break;
 
         case 0x61830005: // J19A
         case 0x61830003: // N19A
             _family = FAMILY_SAME53;
-            flashPtr = new D5xNvmFlash(_samba, "ATSAME53x19", 1024, 512, 0x20004000, 0x20008000) ;
+            flashPtr = new D5xNvmFlash(_samba, "ATSAME53x19", 1024, 512, SramMap(0x20000000, 0x30000).reserve(0x20000000, 0x4000).reserve(0x2002e000, 0x2000)) ;
             break;
 
         case 0x61830004: // J20A
         case 0x61830002: // N20A
             _family = FAMILY_SAME53;
-            flashPtr = new D5xNvmFlash(_samba, "ATSAME53x20", 2048, 512, 0x20004000, 0x20008000) ;
+            flashPtr = new D5xNvmFlash(_samba, "ATSAME53x20", 2048, 512, SramMap(0x20000000, 0x40000).reserve(0x20000000, 0x4000).reserve(0x2003e000, 0x2000)) ;
             break;
 
         //
@@ -602,13 +613,13 @@ Device::create()
         case 0x61840001: // P19A
         case 0x61840003: // N19A
             _family = FAMILY_SAME54;
-            flashPtr = new D5xNvmFlash(_samba, "ATSAME54x19", 1024, 512, 0x20004000, 0x20008000) ;
+            flashPtr = new D5xNvmFlash(_samba, "ATSAME54x19", 1024, 512, SramMap(0x20000000, 0x30000).reserve(0x20000000, 0x4000).reserve(0x2002e000, 0x2000)) ;
             break;
 
         case 0x61840000: // P20A
         case 0x61840002: // N20A
             _family = FAMILY_SAME54;
-            flashPtr = new D5xNvmFlash(_samba, "ATSAME54x20", 2048, 512, 0x20004000, 0x20008000) ;
+            flashPtr = new D5xNvmFlash(_samba, "ATSAME54x20", 2048, 512, SramMap(0x20000000, 0x40000).reserve(0x20000000, 0x4000).reserve(0x2003e000, 0x2000)) ;
             break;
 
         //
@@ -84,6 +84,10 @@ public:
 
     void create();
 
+    // Set up the flash of the part with these identifiers as create would,
+    // without talking to it
+    void create(uint32_t chipId, uint32_t extChipId, uint32_t deviceId);
+
     Family getFamily() { return _family; }
 
     typedef std::unique_ptr<Flash> const FlashPtr;
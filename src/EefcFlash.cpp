@@ -44,6 +44,8 @@
 #define EEFC1_FSR       (_regs + 0x208)
 #define EEFC1_FRR       (_regs + 0x20C)
 
+#define EEFC_STATUS_FSR_ERROR   VmApplet::StatusUser
+
 #define EEFC_FCMD_GETD  0x0
 #define EEFC_FCMD_WP    0x1
 #define EEFC_FCMD_WPL   0x2
@@ -77,27 +79,32 @@ EefcFlash::EefcFlash(Samba& samba,
                      uint32_t planes,
                      uint32_t lockRegions,
                      uint32_t uniqueIdWords,
-                     uint32_t user,
-                     uint32_t stack,
+                     const SramMap& sram,
                      uint32_t regs,
                      bool canBrownout)
-    : Flash(samba, name, addr, pages, size, planes, lockRegions, user, stack),
+    : Flash(samba, name, addr, pages, size, planes, lockRegions, sram),
       _regs(regs), _uniqueIdWords(uniqueIdWords), _canBrownout(canBrownout), _eraseAuto(true)
 {
     assert(planes == 1 || planes == 2);
     assert(pages <= 4096);
     assert(lockRegions <= 256);
-
-    // SAM3 Errata (FWS must be 6)
-    _samba.writeWord(EEFC0_FMR, 0x6 << 8);
-    if (planes == 2)
-        _samba.writeWord(EEFC1_FMR, 0x6 << 8);
 }
 
 EefcFlash::~EefcFlash()
 {
 }
 
+void
+EefcFlash::init()
+{
+    Flash::init();
+
+    // SAM3 Errata (FWS must be 6)
+    _samba.writeWord(EEFC0_FMR, 0x6 << 8);
+    if (_planes == 2)
+        _samba.writeWord(EEFC1_FMR, 0x6 << 8);
+}
+
 void
 EefcFlash::eraseAll(uint32_t offset)
 {
@@ -146,99 +153,47 @@ EefcFlash::eraseAuto(bool enable)
     _eraseAuto = enable;
 }
 
-std::vector<bool>
-EefcFlash::getLockRegions()
-{
-    std::vector<bool> regions(_lockRegions);
-    uint32_t frr;
-    uint32_t bit;
-
-    waitFSR();
-    for (uint32_t region = 0; region < _lockRegions; region++)
-    {
-        if (_planes == 2 && region >= _lockRegions / 2)
-        {
-            bit = region - _lockRegions / 2;
-            writeFCR1(EEFC_FCMD_GLB, 0);
-            waitFSR();
-            frr = readFRR1();
-            while (bit >= 32)
-            {
-                frr = readFRR1();
-                bit -= 32;
-            }
-            regions[region] = (frr & (1 << bit)) != 0;
-        }
-        else
-        {
-            bit = region;
-            writeFCR0(EEFC_FCMD_GLB, 0);
-            waitFSR();
-            frr = readFRR0();
-            while (bit >= 32)
-            {
-                frr = readFRR0();
-                bit -= 32;
-            }
-            regions[region] = (frr & (1 << bit)) != 0;
-        }
-    }
-
-    return regions;
-}
-
-bool
-EefcFlash::getSecurity()
-{
-    waitFSR();
-    writeFCR0(EEFC_FCMD_GGPB, 0);
-    waitFSR();
-    return (readFRR0() & (1 << 0));
-}
-
-bool
-EefcFlash::getBod()
+void
+EefcFlash::readSnapshot(FlashSnapshot& snapshot)
 {
-    if (!_canBrownout)
-        return false;
+    uint32_t gpnvm;
+    uint32_t frr = 0;
+    uint32_t planeRegions = _lockRegions / _planes;
 
+    // A single GGPB returns all of the GPNVM bits
     waitFSR();
     writeFCR0(EEFC_FCMD_GGPB, 0);
     waitFSR();
-    return (readFRR0() & (1 << 1));
-}
+    gpnvm = readFRR0();
 
-bool
-EefcFlash::getBor()
-{
-    if (!_canBrownout)
-        return false;
+    snapshot.security = (gpnvm & (1 << 0)) != 0;
+    snapshot.bod = _canBrownout && (gpnvm & (1 << 1)) != 0;
+    snapshot.bor = _canBrownout && (gpnvm & (1 << 2)) != 0;
+    snapshot.bootFlash = (gpnvm & (1 << (_canBrownout ? 3 : 1))) != 0;
 
-    waitFSR();
-    writeFCR0(EEFC_FCMD_GGPB, 0);
-    waitFSR();
-    return (readFRR0() & (1 << 2));
-}
+    // A single GLB per plane, then each FRR read returns the next 32 lock bits
+    snapshot.regions.assign(_lockRegions, false);
+    for (uint32_t plane = 0; plane < _planes; plane++)
+    {
+        if (plane == 0)
+            writeFCR0(EEFC_FCMD_GLB, 0);
+        else
+            writeFCR1(EEFC_FCMD_GLB, 0);
+        waitFSR();
 
-bool
-EefcFlash::getBootFlash()
-{
-    waitFSR();
-    writeFCR0(EEFC_FCMD_GGPB, 0);
-    waitFSR();
-    return (readFRR0() & (1 << (_canBrownout ? 3 : 1)));
-}
+        for (uint32_t bit = 0; bit < planeRegions; bit++)
+        {
+            if (bit % 32 == 0)
+                frr = (plane == 0) ? readFRR0() : readFRR1();
+            snapshot.regions[plane * planeRegions + bit] = ((frr >> (bit % 32)) & 0x1) != 0;
+        }
+    }
 
-std::vector<uint32_t>
-EefcFlash::getUniqueId()
-{
-    std::vector<uint32_t> value;
+    snapshot.uniqueId.clear();
 
     // No unique id for this chip
     if (_uniqueIdWords == 0)
-        return value;
-
-    waitFSR();
+        return;
 
     // Start read
     writeFCR0(EEFC_FCMD_STUI, 0);
@@ -249,68 +204,86 @@ EefcFlash::getUniqueId()
     {
         // Read from the beginning of the flash region
         // Other flash reads are not allowed while reading the unique id
-        value.push_back(_samba.readWord(addr + word * 4));
+        snapshot.uniqueId.push_back(_samba.readWord(addr + word * 4));
     }
 
     // End read
     writeFCR0(EEFC_FCMD_SPUI, 0);
 
     waitFSR();
-    return value;
 }
 
 void
 EefcFlash::writeOptions()
 {
-    if (canBootFlash() && _bootFlash.isDirty() && _bootFlash.get() != getBootFlash())
-    {
-        waitFSR();
-        writeFCR0(_bootFlash.get() ? EEFC_FCMD_SGPB : EEFC_FCMD_CGPB, (canBod() ? 3 : 1));
-    }
-    if (canBor() && _bor.isDirty() && _bor.get() != getBor())
-    {
-        waitFSR();
-        writeFCR0(_bor.get() ? EEFC_FCMD_SGPB : EEFC_FCMD_CGPB, 2);
-    }
-    if (canBod() && _bod.isDirty() && _bod.get() != getBod())
-    {
-        waitFSR();
-        writeFCR0(_bod.get() ? EEFC_FCMD_SGPB : EEFC_FCMD_CGPB, 1);
-    }
+    // Compare against the current state and force a fresh read afterwards
+    FlashSnapshot current = snapshot();
+    invalidateSnapshot();
+
+    VmProgram program;
+
+    if (canBootFlash() && _bootFlash.isDirty() && _bootFlash.get() != current.bootFlash)
+        command(program, 0, _bootFlash.get() ? EEFC_FCMD_SGPB : EEFC_FCMD_CGPB, (canBod() ? 3 : 1));
+    if (canBor() && _bor.isDirty() && _bor.get() != current.bor)
+        command(program, 0, _bor.get() ? EEFC_FCMD_SGPB : EEFC_FCMD_CGPB, 2);
+    if (canBod() && _bod.isDirty() && _bod.get() != current.bod)
+        command(program, 0, _bod.get() ? EEFC_FCMD_SGPB : EEFC_FCMD_CGPB, 1);
     if (_regions.isDirty())
     {
-        uint32_t page;
-        std::vector<bool> current;
-
         if (_regions.get().size() > _lockRegions)
             throw FlashRegionError();
 
-        current = getLockRegions();
-
         for (uint32_t region = 0; region < _lockRegions; region++)
         {
-            if (_regions.get()[region] != current[region])
+            if (_regions.get()[region] != current.regions[region])
             {
+                uint8_t cmd = _regions.get()[region] ? EEFC_FCMD_SLB : EEFC_FCMD_CLB;
+
                 if (_planes == 2 && region >= _lockRegions / 2)
-                {
-                    page = (region - _lockRegions / 2) * _pages / _lockRegions;
-                    waitFSR();
-                    writeFCR1(_regions.get()[region] ? EEFC_FCMD_SLB : EEFC_FCMD_CLB, page);
-                }
+                    command(program, 1, cmd, (region - _lockRegions / 2) * _pages / _lockRegions);
                 else
-                {
-                    page = region * _pages / _lockRegions;
-                    waitFSR();
-                    writeFCR0(_regions.get()[region] ? EEFC_FCMD_SLB : EEFC_FCMD_CLB, page);
-                }
+                    command(program, 0, cmd, region * _pages / _lockRegions);
             }
         }
     }
-    if (_security.isDirty() && _security.get() == true && _security.get() != getSecurity())
-    {
-        waitFSR();
-        writeFCR0(EEFC_FCMD_SGPB, 0);
-    }
+    if (_security.isDirty() && _security.get() == true && _security.get() != current.security)
+        command(program, 0, EEFC_FCMD_SGPB, 0);
+
+    execute(program);
+}
+
+void
+EefcFlash::command(VmProgram& program, uint32_t plane, uint8_t cmd, uint32_t arg)
+{
+    VmProgram step;
+
+    // Wait for the previous command before starting the next one
+    step.poll(EEFC0_FSR, 0x1, 0x1, 0x6, EEFC_STATUS_FSR_ERROR);
+    if (_planes == 2)
+        step.poll(EEFC1_FSR, 0x1, 0x1, 0x6, EEFC_STATUS_FSR_ERROR);
+    step.write(plane ? EEFC1_FCR : EEFC0_FCR, (EEFC_KEY << 24) | (arg << 8) | cmd);
+
+    if (program.size() + step.size() > _vm.capacity())
+        execute(program);
+    program.append(step);
+}
+
+void
+EefcFlash::execute(VmProgram& program)
+{
+    if (program.empty())
+        return;
+
+    uint32_t status = _vm.execute(program);
+    program.clear();
+
+    if (status == VmApplet::StatusOk)
+        return;
+    if (status != EEFC_STATUS_FSR_ERROR)
+        throw FlashTimeoutError();
+    if (_vm.getResult() & 0x2)
+        throw FlashCmdError();
+    throw FlashLockError();
 }
 
 void
@@ -319,31 +292,38 @@ EefcFlash::writePage(uint32_t page)
     if (page >= _pages)
         throw FlashPageError();
 
-    _wordCopy.setDstAddr(_addr + page * _size);
-    _wordCopy.setSrcAddr(_onBufferA ? _pageBufferA : _pageBufferB);
-    _onBufferA = !_onBufferA;
+    uint8_t cmd = _eraseAuto ? EEFC_FCMD_EWP : EEFC_FCMD_WP;
+    VmProgram program;
+
+    // Wait for the previous command, copy the page to the latch buffer
+    // and start the write in a single run of the interpreter
+    program.poll(EEFC0_FSR, 0x1, 0x1, 0x6, EEFC_STATUS_FSR_ERROR);
+    if (_planes == 2)
+        program.poll(EEFC1_FSR, 0x1, 0x1, 0x6, EEFC_STATUS_FSR_ERROR);
+    program.copy(_addr + page * _size, nextBuffer(), _size / sizeof(uint32_t));
+    if (_planes == 2 && page >= _pages / 2)
+        program.write(EEFC1_FCR, (EEFC_KEY << 24) | ((page - _pages / 2) << 8) | cmd);
+    else
+        program.write(EEFC0_FCR, (EEFC_KEY << 24) | (page << 8) | cmd);
+
+    uint32_t status = _vm.execute(program);
+    if (status == VmApplet::StatusOk)
+        return;
+    if (status != EEFC_STATUS_FSR_ERROR)
+        throw FlashTimeoutError();
+    if ((_vm.getResult() & 0x2) == 0)
+        throw FlashLockError();
+
     // Some chip families have page restrictions on calling EEFC_FCMD_EWP on all pages
     // e.g. 16K boundary on SAM4S
     // Print a warning indicating that the flash must be erased first
-    try
+    if (page > 0)
     {
-        waitFSR();
+        printf("\nNOTE: Some chip families may not support auto-erase on all flash regions.\n");
+        printf("      Try erasing the flash first (bossash), or erasing at the same time (bossac).");
+        fflush(stdout);
     }
-    catch (FlashCmdError& exc)
-    {
-        if (page > 0)
-        {
-            printf("\nNOTE: Some chip families may not support auto-erase on all flash regions.\n");
-            printf("      Try erasing the flash first (bossash), or erasing at the same time (bossac).");
-            fflush(stdout);
-        }
-        throw;
-    }
-    _wordCopy.runv();
-    if (_planes == 2 && page >= _pages / 2)
-        writeFCR1(_eraseAuto ? EEFC_FCMD_EWP : EEFC_FCMD_WP, page - _pages / 2);
-    else
-        writeFCR0(_eraseAuto ? EEFC_FCMD_EWP : EEFC_FCMD_WP, page);
+    throw FlashCmdError();
 }
 
 void
@@ -355,11 +335,36 @@ EefcFlash::readPage(uint32_t page, uint8_t* data)
     // The SAM3 firmware has a bug where it returns all zeros for reads
     // directly from the flash so instead, we copy the flash page to
     // SRAM and read it from there.
-    _wordCopy.setDstAddr(_onBufferA ? _pageBufferA : _pageBufferB);
+    _wordCopy.setDstAddr(buffer());
     _wordCopy.setSrcAddr(_addr + page * _size);
     waitFSR();
     _wordCopy.runv();
-    _samba.read(_onBufferA ? _pageBufferA : _pageBufferB, data, _size);
+    _samba.read(buffer(), data, _size);
+}
+
+void
+EefcFlash::readPages(uint32_t page, uint32_t count, uint8_t* data)
+{
+    if (page + count > _pages || count > _buffers)
+        throw FlashPageError();
+
+    // Same workaround as readPage but for the whole buffer ring at once
+    _wordCopy.setDstAddr(_bufferBase);
+    _wordCopy.setSrcAddr(_addr + page * _size);
+    _wordCopy.setWords(count * _size / sizeof(uint32_t));
+    waitFSR();
+    _wordCopy.runv();
+    _wordCopy.setWords(_size / sizeof(uint32_t));
+    _samba.read(_bufferBase, data, count * _size);
+}
+
+uint16_t
+EefcFlash::checksumBuffer(uint32_t start_addr, uint32_t size)
+{
+    // The flash cannot be read while a write is still in progress
+    waitFSR();
+
+    return Flash::checksumBuffer(start_addr, size);
 }
 
 void
@@ -45,43 +45,44 @@ public:
               uint32_t planes,
               uint32_t lockRegions,
               uint32_t uniqueIdWords,
-              uint32_t user,
-              uint32_t stack,
+              const SramMap& sram,
               uint32_t regs,
               bool canBrownout);
     virtual ~EefcFlash();
 
-    void eraseAll(uint32_t offset);
-    void eraseAuto(bool enable);
+    void init();
 
-    std::vector<bool> getLockRegions();
+    uint32_t pagesPerErase() { return PagesPerErase; }
+    uint32_t decodeRate() { return 5000; }
 
-    bool getSecurity();
+    void eraseAll(uint32_t offset);
+    void eraseAuto(bool enable);
 
-    bool getBod();
     bool canBod() { return _canBrownout; }
-
-    bool getBor();
     bool canBor() { return _canBrownout; }
-
-    bool getBootFlash();
     bool canBootFlash() { return true; }
 
-    std::vector<uint32_t> getUniqueId();
-
     void writeOptions();
 
     void writePage(uint32_t page);
     void readPage(uint32_t page, uint8_t* data);
+    void readPages(uint32_t page, uint32_t count, uint8_t* data);
+
+    uint16_t checksumBuffer(uint32_t start_addr, uint32_t size);
 
     static const uint32_t PagesPerErase;
 
+protected:
+    void readSnapshot(FlashSnapshot& snapshot);
+
 private:
     uint32_t _regs;
     uint32_t _uniqueIdWords;
     bool _canBrownout;
     bool _eraseAuto;
 
+    void command(VmProgram& program, uint32_t plane, uint8_t cmd, uint32_t arg);
+    void execute(VmProgram& program);
     void waitFSR(int seconds = 1);
     void writeFCR0(uint8_t cmd, uint32_t arg);
     void writeFCR1(uint8_t cmd, uint32_t arg);
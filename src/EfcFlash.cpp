@@ -58,23 +58,27 @@ EfcFlash::EfcFlash(Samba& samba,
                    uint32_t size,
                    uint32_t planes,
                    uint32_t lockRegions,
-                   uint32_t user,
-                   uint32_t stack,
+                   const SramMap& sram,
                    bool canBootFlash)
-    : Flash(samba, name, addr, pages, size, planes, lockRegions, user, stack),
+    : Flash(samba, name, addr, pages, size, planes, lockRegions, sram),
       _canBootFlash(canBootFlash)
 {
     assert(planes == 1 || planes == 2);
     assert(pages <= planes * 1024);
     assert(lockRegions <= 32);
-
-    eraseAuto(true);
 }
 
 EfcFlash::~EfcFlash()
 {
 }
 
+void
+EfcFlash::init()
+{
+    Flash::init();
+    eraseAuto(true);
+}
+
 void
 EfcFlash::eraseAll(uint32_t offset)
 {
@@ -110,71 +114,52 @@ EfcFlash::eraseAuto(bool enable)
     }
 }
 
-std::vector<bool>
-EfcFlash::getLockRegions()
+void
+EfcFlash::readSnapshot(FlashSnapshot& snapshot)
 {
-    std::vector<bool> regions(_lockRegions);
     uint32_t fsr0;
     uint32_t fsr1;
 
+    // The lock and GPNVM bits are all reported in FSR
     fsr0 = readFSR0();
     if (_planes == 2)
         fsr1 = readFSR1();
     else
         fsr1 = 0;
 
+    snapshot.regions.assign(_lockRegions, false);
     for (uint32_t region = 0; region < _lockRegions; region++)
     {
         if (_planes == 2 && region >= _lockRegions / 2)
-            regions[region] = (fsr1 & (1 << (16 + region - _lockRegions / 2))) != 0;
+            snapshot.regions[region] = (fsr1 & (1 << (16 + region - _lockRegions / 2))) != 0;
         else
-            regions[region] = (fsr0 & (1 << (16 + region))) != 0;
+            snapshot.regions[region] = (fsr0 & (1 << (16 + region))) != 0;
     }
 
-    return regions;
-}
-
-bool
-EfcFlash::getSecurity()
-{
-    return (readFSR0() & (1 << 4));
-}
-
-bool
-EfcFlash::getBod()
-{
-    return (readFSR0() & (1 << 8));
-}
-
-bool
-EfcFlash::getBor()
-{
-    return (readFSR0() & (2 << 8));
-}
-
-bool
-EfcFlash::getBootFlash()
-{
-    if (!_canBootFlash)
-        return false;
-
-    return (readFSR0() & (1 << 10));
+    snapshot.security = (fsr0 & (1 << 4)) != 0;
+    snapshot.bod = (fsr0 & (1 << 8)) != 0;
+    snapshot.bor = (fsr0 & (2 << 8)) != 0;
+    snapshot.bootFlash = _canBootFlash && (fsr0 & (1 << 10)) != 0;
 }
 
 void
 EfcFlash::writeOptions()
 {
-    if (canBootFlash() && _bootFlash.isDirty() && _bootFlash.get() != getBootFlash())
+    // Compare against the current state and force a fresh read afterwards
+    FlashSnapshot current = snapshot();
+    invalidateSnapshot();
+
+    if (canBootFlash() && _bootFlash.isDirty() && _bootFlash.get() != current.bootFlash)
     {
         waitFSR();
         writeFCR0(_bootFlash.get() ? EFC_FCMD_SGPB : EFC_FCMD_CGPB, 2);
     }
-    if (canBor() && _bor.isDirty() && _bor.get() != getBor())
+    if (canBor() && _bor.isDirty() && _bor.get() != current.bor)
     {
         waitFSR();
         writeFCR0(_bor.get() ? EFC_FCMD_SGPB : EFC_FCMD_CGPB, 1);
     }
-    if (canBod() && _bod.isDirty() && _bod.get() != getBod())
+    if (canBod() && _bod.isDirty() && _bod.get() != current.bod)
     {
         waitFSR();
         writeFCR0(_bod.get() ? EFC_FCMD_SGPB : EFC_FCMD_CGPB, 0);
@@ -182,13 +167,10 @@ EfcFlash::writeOptions()
     if (_regions.isDirty())
     {
         uint32_t page;
-        std::vector<bool> current;
-
-        current = getLockRegions();
 
         for (uint32_t region = 0; region < _regions.get().size(); region++)
         {
-            if (_regions.get()[region] != current[region])
+            if (_regions.get()[region] != current.regions[region])
             {
                 if (_planes == 2 && region >= _lockRegions / 2)
                 {
@@ -205,7 +187,7 @@ EfcFlash::writeOptions()
             }
         }
     }
-    if (_security.isDirty() && _security.get() == true && _security.get() != getSecurity())
+    if (_security.isDirty() && _security.get() == true && _security.get() != current.security)
     {
         waitFSR();
         writeFCR0(EFC_FCMD_SSB, 0);
@@ -219,8 +201,7 @@ EfcFlash::writePage(uint32_t page)
         throw FlashPageError();
 
     _wordCopy.setDstAddr(_addr + page * _size);
-    _wordCopy.setSrcAddr(_onBufferA ? _pageBufferA : _pageBufferB);
-    _onBufferA = !_onBufferA;
+    _wordCopy.setSrcAddr(nextBuffer());
     waitFSR();
     _wordCopy.run();
     if (_planes == 2 && page >= _pages / 2)
@@ -239,6 +220,24 @@ EfcFlash::readPage(uint32_t page, uint8_t* data)
     _samba.read(_addr + page * _size, data, _size);
 }
 
+void
+EfcFlash::readPages(uint32_t page, uint32_t count, uint8_t* data)
+{
+    waitFSR();
+    Flash::readPages(page, count, data);
+}
+
+uint16_t
+EfcFlash::checksumBuffer(uint32_t start_addr, uint32_t size)
+{
+    _crc16.setStartAddr(_addr + start_addr);
+    _crc16.setSize(size);
+    waitFSR();
+    _crc16.run();
+
+    return _crc16.getCrc();
+}
+
 void
 EfcFlash::waitFSR(int seconds)
 {
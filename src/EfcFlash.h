@@ -44,33 +44,29 @@ public:
              uint32_t size,
              uint32_t planes,
              uint32_t lockRegions,
-             uint32_t user,
-             uint32_t stack,
+             const SramMap& sram,
              bool canBootFlash);
     virtual ~EfcFlash();
 
+    void init();
+
     void eraseAll(uint32_t offset);
     void eraseAuto(bool enable);
 
-    std::vector<bool> getLockRegions();
-
-    bool getSecurity();
-
-    bool getBod();
     bool canBod() { return true; }
-
-    bool getBor();
     bool canBor() { return true; }
-
-    bool getBootFlash();
     bool canBootFlash() { return _canBootFlash; }
 
-    std::vector<uint32_t> getUniqueId() { return std::vector<uint32_t>(); }
-
     void writeOptions();
 
     void writePage(uint32_t page);
     void readPage(uint32_t page, uint8_t* data);
+    void readPages(uint32_t page, uint32_t count, uint8_t* data);
+
+    uint16_t checksumBuffer(uint32_t start_addr, uint32_t size);
+
+protected:
+    void readSnapshot(FlashSnapshot& snapshot);
 
 private:
     bool _canBootFlash;
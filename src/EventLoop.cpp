@@ -0,0 +1,249 @@
+///////////////////////////////////////////////////////////////////////////////
+// BOSSA
+//
+// Copyright (c) 2011-2018, ShumaTech
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the <organization> nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#include <vector>
+#include <system_error>
+
+#include "EventLoop.h"
+
+// Descriptors reported by each wait
+#define MAX_EVENTS      64
+
+EventLoop::EventLoop() : _stopped(false), _nextTimer(0)
+{
+    _epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (_epfd < 0)
+        throw std::system_error(errno, std::system_category(), "epoll_create1");
+
+    _wakeFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (_wakeFd < 0)
+    {
+        int errnum = errno;
+
+        ::close(_epfd);
+        throw std::system_error(errnum, std::system_category(), "eventfd");
+    }
+    watch(_wakeFd, Readable, [this]() { wake(); });
+}
+
+EventLoop::~EventLoop()
+{
+    ::close(_wakeFd);
+    ::close(_epfd);
+}
+
+uint64_t
+EventLoop::now()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+void
+EventLoop::update(int fd, Watch& watch)
+{
+    struct epoll_event event;
+    bool added = (watch.events != 0);
+
+    watch.events = (watch.readable ? EPOLLIN : 0) | (watch.writable ? EPOLLOUT : 0);
+
+    event.events = watch.events;
+    event.data.fd = fd;
+
+    if (watch.events == 0)
+    {
+        epoll_ctl(_epfd, EPOLL_CTL_DEL, fd, &event);
+        _watches.erase(fd);
+    }
+    else if (epoll_ctl(_epfd, added ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, fd, &event) != 0)
+    {
+        // A descriptor closed while watched has already left the epoll set
+        if (!added || errno != ENOENT || epoll_ctl(_epfd, EPOLL_CTL_ADD, fd, &event) != 0)
+            throw std::system_error(errno, std::system_category(), "epoll_ctl");
+    }
+}
+
+void
+EventLoop::watch(int fd, Event event, Callback handler)
+{
+    Watch& watch = _watches[fd];
+
+    if (event == Readable)
+        watch.readable = handler;
+    else
+        watch.writable = handler;
+    update(fd, watch);
+}
+
+void
+EventLoop::unwatch(int fd, Event event)
+{
+    std::map<int, Watch>::iterator it = _watches.find(fd);
+
+    if (it == _watches.end())
+        return;
+
+    if (event == Readable)
+        it->second.readable = nullptr;
+    else
+        it->second.writable = nullptr;
+    update(fd, it->second);
+}
+
+void
+EventLoop::unwatch(int fd)
+{
+    unwatch(fd, Readable);
+    unwatch(fd, Writable);
+}
+
+uint32_t
+EventLoop::timer(int millisecs, Callback callback)
+{
+    Timer timer;
+
+    timer.id = ++_nextTimer;
+    timer.callback = callback;
+    _timers.insert(std::make_pair(now() + millisecs, timer));
+
+    return timer.id;
+}
+
+void
+EventLoop::cancel(uint32_t id)
+{
+    for (std::multimap<uint64_t, Timer>::iterator it = _timers.begin(); it != _timers.end(); it++)
+    {
+        if (it->second.id == id)
+        {
+            _timers.erase(it);
+            return;
+        }
+    }
+}
+
+void
+EventLoop::post(Callback callback)
+{
+    uint64_t one = 1;
+
+    {
+        std::lock_guard<std::mutex> lock(_postMutex);
+        _posted.push_back(callback);
+    }
+
+    // A full counter still wakes the loop, so the result can be ignored
+    if (::write(_wakeFd, &one, sizeof(one)) < 0)
+        return;
+}
+
+void
+EventLoop::wake()
+{
+    uint64_t count;
+    std::vector<Callback> posted;
+
+    if (::read(_wakeFd, &count, sizeof(count)) < 0 && errno != EAGAIN)
+        throw std::system_error(errno, std::system_category(), "eventfd");
+
+    {
+        std::lock_guard<std::mutex> lock(_postMutex);
+        posted.swap(_posted);
+    }
+
+    for (uint32_t index = 0; index < posted.size(); index++)
+        posted[index]();
+}
+
+void
+EventLoop::run()
+{
+    struct epoll_event events[MAX_EVENTS];
+
+    _stopped = false;
+    while (!_stopped)
+    {
+        int timeout = -1;
+        int ready;
+
+        if (!_timers.empty())
+        {
+            uint64_t time = now();
+            uint64_t deadline = _timers.begin()->first;
+
+            timeout = deadline > time ? deadline - time : 0;
+        }
+
+        ready = epoll_wait(_epfd, events, MAX_EVENTS, timeout);
+        if (ready < 0 && errno != EINTR)
+            throw std::system_error(errno, std::system_category(), "epoll_wait");
+
+        // Handlers can change the watches, so look each one up again and
+        // call a copy of it
+        for (int event = 0; event < ready; event++)
+        {
+            int fd = events[event].data.fd;
+            std::map<int, Watch>::iterator it;
+            Callback callback;
+
+            it = _watches.find(fd);
+            if (it != _watches.end() && (events[event].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) &&
+                it->second.readable)
+            {
+                callback = it->second.readable;
+                callback();
+            }
+
+            it = _watches.find(fd);
+            if (it != _watches.end() && (events[event].events & (EPOLLOUT | EPOLLERR | EPOLLHUP)) &&
+                it->second.writable)
+            {
+                callback = it->second.writable;
+                callback();
+            }
+        }
+
+        // Fire expired timers one at a time as the callbacks can add more
+        uint64_t time = now();
+        while (!_timers.empty() && _timers.begin()->first <= time)
+        {
+            Callback callback = _timers.begin()->second.callback;
+
+            _timers.erase(_timers.begin());
+            callback();
+        }
+    }
+}
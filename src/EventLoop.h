@@ -0,0 +1,104 @@
+///////////////////////////////////////////////////////////////////////////////
+// BOSSA
+//
+// Copyright (c) 2011-2018, ShumaTech
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the <organization> nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+#ifndef _EVENTLOOP_H
+#define _EVENTLOOP_H
+
+#include <stdint.h>
+
+#include <map>
+#include <mutex>
+#include <vector>
+#include <functional>
+
+// Waits on many descriptors and timers from a single thread and calls back
+// when one is ready
+class EventLoop
+{
+public:
+    EventLoop();
+    virtual ~EventLoop();
+
+    enum Event
+    {
+        Readable = 1,
+        Writable = 2,
+    };
+
+    typedef std::function<void()> Callback;
+
+    // Call the handler each time the descriptor is ready until unwatched
+    void watch(int fd, Event event, Callback handler);
+    void unwatch(int fd, Event event);
+    void unwatch(int fd);
+
+    // Call the callback once after the given time
+    uint32_t timer(int millisecs, Callback callback);
+    void cancel(uint32_t id);
+
+    // Call the callback on the loop as soon as it can.  This is the only
+    // call that is safe from another thread.
+    void post(Callback callback);
+
+    void run();
+    void stop() { _stopped = true; }
+
+private:
+    struct Watch
+    {
+        Watch() : events(0) {}
+
+        uint32_t events;
+        Callback readable;
+        Callback writable;
+    };
+
+    struct Timer
+    {
+        uint32_t id;
+        Callback callback;
+    };
+
+    int _epfd;
+    int _wakeFd;
+    bool _stopped;
+    uint32_t _nextTimer;
+    std::map<int, Watch> _watches;
+    std::multimap<uint64_t, Timer> _timers;
+    std::mutex _postMutex;
+    std::vector<Callback> _posted;
+
+    void update(int fd, Watch& watch);
+    void wake();
+    static uint64_t now();
+
+    EventLoop(const EventLoop&);
+    EventLoop& operator=(const EventLoop&);
+};
+
+#endif // _EVENTLOOP_H
@@ -0,0 +1,114 @@
+///////////////////////////////////////////////////////////////////////////////
+// BOSSA
+//
+// Copyright (c) 2011-2018, ShumaTech
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the <organization> nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+#include <errno.h>
+#include <unistd.h>
+
+#include <system_error>
+
+#include "Fiber.h"
+
+const size_t Fiber::DefaultStackSize = 512 * 1024;
+
+static thread_local Fiber* currentFiber = NULL;
+
+Fiber::Fiber(EventLoop& loop, std::function<void()> body, size_t stackSize) :
+    _loop(loop), _body(body), _stack(stackSize), _finished(false)
+{
+    if (getcontext(&_context) != 0)
+        throw std::system_error(errno, std::system_category(), "getcontext");
+
+    _context.uc_stack.ss_sp = &_stack[0];
+    _context.uc_stack.ss_size = _stack.size();
+    _context.uc_link = &_caller;
+    makecontext(&_context, entry, 0);
+}
+
+Fiber::~Fiber()
+{
+}
+
+Fiber*
+Fiber::current()
+{
+    return currentFiber;
+}
+
+void
+Fiber::entry()
+{
+    Fiber* fiber = currentFiber;
+
+    // Nothing can unwind past the top of the stack
+    try
+    {
+        fiber->_body();
+    }
+    catch (...)
+    {
+    }
+
+    fiber->_finished = true;
+    currentFiber = NULL;
+}
+
+void
+Fiber::resume()
+{
+    Fiber* caller = currentFiber;
+
+    if (_finished)
+        return;
+
+    currentFiber = this;
+    swapcontext(&_caller, &_context);
+    currentFiber = caller;
+}
+
+void
+Fiber::yield()
+{
+    Fiber* fiber = currentFiber;
+
+    swapcontext(&fiber->_context, &fiber->_caller);
+}
+
+void
+Fiber::sleep(int millisecs)
+{
+    Fiber* fiber = currentFiber;
+
+    if (!fiber)
+    {
+        usleep(millisecs * 1000);
+        return;
+    }
+
+    fiber->_loop.timer(millisecs, [fiber]() { fiber->resume(); });
+    yield();
+}
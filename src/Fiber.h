@@ -0,0 +1,79 @@
+///////////////////////////////////////////////////////////////////////////////
+// BOSSA
+//
+// Copyright (c) 2011-2018, ShumaTech
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the <organization> nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+#ifndef _FIBER_H
+#define _FIBER_H
+
+#include <ucontext.h>
+
+#include <vector>
+#include <functional>
+
+#include "EventLoop.h"
+
+// A function run on a stack of its own that can give up the thread part
+// way through and carry on later.  This lets blocking code such as a
+// programming session share an event loop with many others.
+class Fiber
+{
+public:
+    Fiber(EventLoop& loop, std::function<void()> body, size_t stackSize = DefaultStackSize);
+    virtual ~Fiber();
+
+    // Run the fiber until it yields or finishes
+    void resume();
+    bool finished() { return _finished; }
+    EventLoop& loop() { return _loop; }
+
+    // The fiber running on this thread or NULL outside of one
+    static Fiber* current();
+
+    // Give the thread back to whoever resumed the running fiber.  Something
+    // must already be set up to resume it again.
+    static void yield();
+
+    // Wait without holding up the other fibers
+    static void sleep(int millisecs);
+
+    static const size_t DefaultStackSize;
+
+private:
+    EventLoop& _loop;
+    std::function<void()> _body;
+    std::vector<char> _stack;
+    ucontext_t _context;
+    ucontext_t _caller;
+    bool _finished;
+
+    static void entry();
+
+    Fiber(const Fiber&);
+    Fiber& operator=(const Fiber&);
+};
+
+#endif // _FIBER_H
@@ -0,0 +1,115 @@
+///////////////////////////////////////////////////////////////////////////////
+// BOSSA
+//
+// Copyright (c) 2011-2018, ShumaTech
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the <organization> nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+#include "FiberSerialPort.h"
+#include "Fiber.h"
+
+FiberSerialPort::FiberSerialPort(EventLoop& loop, SerialPort::Ptr port) :
+    SerialPort(port->name()), _port(std::move(port))
+{
+    _port->attach(loop);
+}
+
+bool
+FiberSerialPort::open(int baud, int data, SerialPort::Parity parity, SerialPort::StopBit stop)
+{
+    return _port->open(baud, data, parity, stop);
+}
+
+int
+FiberSerialPort::wait(std::function<void(Completion)> start)
+{
+    Fiber* fiber = Fiber::current();
+    bool waiting = false;
+    bool finished = false;
+    int result = -1;
+
+    start([&](int res)
+    {
+        result = res;
+        finished = true;
+        if (waiting)
+            fiber->resume();
+    });
+
+    // The transfer may have finished without going near the loop
+    if (!finished)
+    {
+        waiting = true;
+        Fiber::yield();
+    }
+
+    return result;
+}
+
+int
+FiberSerialPort::read(uint8_t* data, int size)
+{
+    if (!Fiber::current())
+        return _port->read(data, size);
+
+    return wait([&](Completion done) { _port->readAsync(data, size, done); });
+}
+
+int
+FiberSerialPort::write(const uint8_t* data, int size)
+{
+    if (!Fiber::current())
+        return _port->write(data, size);
+
+    return wait([&](Completion done) { _port->writeAsync(data, size, done); });
+}
+
+int
+FiberSerialPort::get()
+{
+    uint8_t byte;
+
+    if (read(&byte, 1) != 1)
+        return -1;
+
+    return byte;
+}
+
+int
+FiberSerialPort::put(int c)
+{
+    uint8_t byte;
+
+    byte = c;
+    return write(&byte, 1);
+}
+
+void
+FiberSerialPort::flush()
+{
+    if (!Fiber::current())
+        _port->flush();
+    else
+        Fiber::sleep(1);
+}
@@ -0,0 +1,67 @@
+///////////////////////////////////////////////////////////////////////////////
+// BOSSA
+//
+// Copyright (c) 2011-2018, ShumaTech
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the <organization> nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+#ifndef _FIBERSERIALPORT_H
+#define _FIBERSERIALPORT_H
+
+#include "SerialPort.h"
+#include "EventLoop.h"
+
+// Wraps a port so that its blocking calls made from a fiber wait on the
+// event loop instead, leaving the thread free for the other fibers
+class FiberSerialPort : public SerialPort
+{
+public:
+    FiberSerialPort(EventLoop& loop, SerialPort::Ptr port);
+    virtual ~FiberSerialPort() {}
+
+    bool open(int baud = 115200,
+              int data = 8,
+              SerialPort::Parity parity = SerialPort::ParityNone,
+              SerialPort::StopBit stop = SerialPort::StopBitOne);
+    void close() { _port->close(); }
+
+    bool isUsb() { return _port->isUsb(); }
+
+    int read(uint8_t* data, int size);
+    int write(const uint8_t* data, int size);
+    int get();
+    int put(int c);
+
+    bool timeout(int millisecs) { return _port->timeout(millisecs); }
+    void flush();
+    void setDTR(bool dtr) { _port->setDTR(dtr); }
+    void setRTS(bool rts) { _port->setRTS(rts); }
+
+private:
+    SerialPort::Ptr _port;
+
+    int wait(std::function<void(Completion)> start);
+};
+
+#endif // _FIBERSERIALPORT_H
@@ -29,6 +29,11 @@
 #include "Flash.h"
 
 #include <assert.h>
+#include <algorithm>
+
+const uint32_t Flash::StackSize = 0x100;
+const uint32_t Flash::MaxBufferWindow = 0x10000;
+const uint32_t Flash::VmProgramSize = 0x200;
 
 Flash::Flash(Samba& samba,
              const std::string& name,
@@ -37,23 +42,97 @@ Flash::Flash(Samba& samba,
              uint32_t size,
              uint32_t planes,
              uint32_t lockRegions,
-             uint32_t user,
-             uint32_t stack)
+             const SramMap& sram)
     : _samba(samba), _name(name), _addr(addr), _pages(pages), _size(size),
-      _planes(planes), _lockRegions(lockRegions), _user(user), _wordCopy(samba, user)
+      _planes(planes), _lockRegions(lockRegions), _sram(sram),
+      _wordCopy(samba, _sram.alloc(sizeof(WordCopyArm::code))),
+      _crc16(samba, _sram.alloc(sizeof(Crc16Arm::code))),
+      _lz4(samba, _sram.alloc(sizeof(Lz4Arm::code))),
+      _vm(samba, _sram.alloc(sizeof(VmArm::code)), _sram.alloc(VmProgramSize), VmProgramSize),
+      _blockSum(samba, _sram.alloc(sizeof(BlockSumArm::code)))
 {
+    uint32_t stack;
+
     assert((size & (size - 1)) == 0);
     assert((pages & (pages - 1)) == 0);
     assert((lockRegions & (lockRegions - 1)) == 0);
 
-    _wordCopy.setWords(size / sizeof(uint32_t));
+    stack = _sram.allocStack(StackSize);
+
     _wordCopy.setStack(stack);
+    _crc16.setStack(stack);
+    _lz4.setStack(stack);
+    _vm.setStack(stack);
+    _blockSum.setStack(stack);
+
+    // Half of the rest of the SRAM becomes a ring of page buffers so that
+    // several pages can be sent in one transfer.  The other half holds
+    // compressed data waiting to be decoded into the ring.  Parts too small
+    // for both give all of it to the ring and send uncompressed.
+    _buffers = std::min(_sram.free() / 2, MaxBufferWindow) / size;
+    if (_buffers < 2)
+        _buffers = std::min(_sram.free(), MaxBufferWindow) / size;
+    if (_buffers < 2)
+        throw SramPlanError();
+    _bufferBase = _sram.alloc(_buffers * size);
+    _bufferIndex = 0;
+
+    _stagingSize = std::min(_sram.free(), _buffers * size) & ~3;
+    _staging = _sram.alloc(_stagingSize);
+}
+
+void
+Flash::init()
+{
+    _wordCopy.setWords(_size / sizeof(uint32_t));
+}
+
+const FlashSnapshot&
+Flash::snapshot()
+{
+    if (!_snapshot.valid)
+    {
+        readSnapshot(_snapshot);
+        _snapshot.valid = true;
+    }
+
+    return _snapshot;
+}
+
+std::vector<bool>
+Flash::getLockRegions()
+{
+    return snapshot().regions;
+}
+
+bool
+Flash::getSecurity()
+{
+    return snapshot().security;
+}
+
+bool
+Flash::getBod()
+{
+    return snapshot().bod;
+}
 
-    _onBufferA = true;
+bool
+Flash::getBor()
+{
+    return snapshot().bor;
+}
+
+bool
+Flash::getBootFlash()
+{
+    return snapshot().bootFlash;
+}
 
-    // page buffers will have the size of a physical page and will be situated right after the applet
-    _pageBufferA = ((_user + _wordCopy.size() + 3) / 4) * 4; // we need to avoid non 32bits aligned access on Cortex-M0+
-    _pageBufferB = _pageBufferA + size;
+std::vector<uint32_t>
+Flash::getUniqueId()
+{
+    return snapshot().uniqueId;
 }
 
 void
@@ -92,15 +171,140 @@ Flash::setBootFlash(bool enable)
         _bootFlash.set(enable);
 }
 
+uint32_t
+Flash::nextBuffer()
+{
+    uint32_t addr = buffer();
+
+    _bufferIndex = (_bufferIndex + 1) % _buffers;
+
+    return addr;
+}
+
+void
+Flash::loadBuffer(const uint8_t* data, uint32_t bufferSize)
+{
+    uint32_t pages = (bufferSize + _size - 1) / _size;
+
+    // Data spanning several buffers must not wrap around the ring
+    if (_bufferIndex + pages > _buffers)
+        _bufferIndex = 0;
+
+    _samba.write(buffer(), data, bufferSize);
+}
+
+void
+Flash::loadCompressed(const uint8_t* block, uint32_t size, uint32_t rawSize)
+{
+    uint32_t pages = (rawSize + _size - 1) / _size;
+
+    assert(size <= _stagingSize);
+
+    if (_bufferIndex + pages > _buffers)
+        _bufferIndex = 0;
+
+    _samba.write(_staging, block, size);
+    _lz4.setSrcAddr(_staging);
+    _lz4.setSrcSize(size);
+    _lz4.setDstAddr(buffer());
+    _lz4.runv();
+}
+
 void
-Flash::loadBuffer(const uint8_t* data, uint16_t bufferSize)
+Flash::loadBuffer(const uint8_t* data, uint32_t size, const std::vector<FlashCopy>& copies)
 {
-    _samba.write(_onBufferA ? _pageBufferA : _pageBufferB, data, bufferSize);
+    uint32_t pages = (size + _size - 1) / _size;
+    uint32_t offset = 0;
+    VmProgram program;
+
+    if (_bufferIndex + pages > _buffers)
+        _bufferIndex = 0;
+
+    // Send the data between the copies and let the interpreter fill in
+    // the rest straight from flash
+    for (std::vector<FlashCopy>::const_iterator it = copies.begin(); it != copies.end(); it++)
+    {
+        assert(it->offset >= offset && it->offset + it->size <= size);
+        assert(it->offset % 4 == 0 && it->src % 4 == 0 && it->size % 4 == 0);
+
+        if (it->offset > offset)
+            _samba.write(buffer() + offset, data + offset, it->offset - offset);
+        offset = it->offset + it->size;
+
+        VmProgram step;
+        step.copy(buffer() + it->offset, _addr + it->src, it->size / sizeof(uint32_t));
+        if (program.size() + step.size() > _vm.capacity())
+        {
+            _vm.execute(program);
+            program.clear();
+        }
+        program.append(step);
+    }
+
+    if (offset < size)
+        _samba.write(buffer() + offset, data + offset, size - offset);
+    if (!program.empty())
+        _vm.execute(program);
 }
 
 void
 Flash::writeBuffer(uint32_t dst_addr, uint32_t size)
 {
-    _samba.writeBuffer(_onBufferA ? _pageBufferA : _pageBufferB, dst_addr + _addr, size);
+    uint32_t addr = buffer();
+
+    _bufferIndex = (_bufferIndex + (size + _size - 1) / _size) % _buffers;
+    _samba.writeBuffer(addr, dst_addr + _addr, size);
+}
+
+void
+Flash::readPages(uint32_t page, uint32_t count, uint8_t* data)
+{
+    if (page + count > _pages)
+        throw FlashPageError();
+
+    _samba.read(_addr + page * _size, data, count * _size);
+}
+
+
+uint16_t
+Flash::checksumBuffer(uint32_t start_addr, uint32_t size)
+{
+    // Use the extended Samba command if available
+    if (_samba.canChecksumBuffer() && size <= _samba.checksumBufferSize())
+        return _samba.checksumBuffer(start_addr + _addr, size);
+
+    _crc16.setStartAddr(start_addr + _addr);
+    _crc16.setSize(size);
+    _crc16.runv();
+
+    return _crc16.getCrc();
 }
 
+void
+Flash::blockSums(uint32_t start_addr, uint32_t blockSize, uint32_t blocks, std::vector<uint32_t>& sums)
+{
+    // Two words per block are collected in the buffer ring
+    uint32_t maxBlocks = _buffers * _size / (2 * sizeof(uint32_t));
+    std::vector<uint8_t> data;
+
+    sums.clear();
+    _blockSum.setBlockSize(blockSize);
+    _blockSum.setDstAddr(_bufferBase);
+
+    while (blocks > 0)
+    {
+        uint32_t count = std::min(blocks, maxBlocks);
+
+        _blockSum.setStartAddr(start_addr + _addr);
+        _blockSum.setBlocks(count);
+        _blockSum.runv();
+
+        data.resize(count * 2 * sizeof(uint32_t));
+        _samba.read(_bufferBase, &data[0], data.size());
+        for (uint32_t i = 0; i < data.size(); i += sizeof(uint32_t))
+            sums.push_back(data[i] | (data[i + 1] << 8) | (data[i + 2] << 16) | ((uint32_t) data[i + 3] << 24));
+
+        start_addr += count * blockSize;
+        blocks -= count;
+    }
+}
@@ -35,7 +35,12 @@
 #include <exception>
 
 #include "Samba.h"
+#include "SramMap.h"
 #include "WordCopyApplet.h"
+#include "Crc16Applet.h"
+#include "Lz4Applet.h"
+#include "VmApplet.h"
+#include "BlockSumApplet.h"
 
 class FlashPageError : public std::exception
 {
@@ -88,6 +93,37 @@ public:
 
 };
 
+// Cached copy of the flash controller state.  All of the option bits,
+// lock bits, unique id words and the user row are read in a single pass
+// so that the getters do not each cost a round trip to the device.
+class FlashSnapshot
+{
+public:
+    FlashSnapshot() : valid(false), security(false), bod(false), bor(false), bootFlash(false) {}
+
+    bool valid;
+    bool security;
+    bool bod;
+    bool bor;
+    bool bootFlash;
+    std::vector<bool> regions;
+    std::vector<uint32_t> uniqueId;
+    std::vector<uint8_t> userRow;
+};
+
+// Part of a buffer that can be copied from data already in flash rather
+// than sent over the link.  The offset is within the buffer and the source
+// is a flash offset.
+class FlashCopy
+{
+public:
+    FlashCopy(uint32_t offset, uint32_t src, uint32_t size) : offset(offset), src(src), size(size) {}
+
+    uint32_t offset;
+    uint32_t src;
+    uint32_t size;
+};
+
 template<class T>
 class FlashOption
 {
@@ -113,10 +149,13 @@ public:
           uint32_t size,                 // Page size in bytes
           uint32_t planes,               // Number of flash planes
           uint32_t lockRegions,          // Number of flash lock regions
-          uint32_t user,                 // Address in SRAM where the applet and buffers will be placed
-          uint32_t stack);               // Address in SRAM where the applet stack will be placed
+          const SramMap& sram);          // SRAM available for the applets, stack and buffers
     virtual ~Flash() {}
 
+    // Get the controller of a connected device ready.  Nothing before this
+    // talks to the device, so a flash can be set up just to plan a run.
+    virtual void init();
+
     const std::string& name() { return _name; }
 
     virtual uint32_t address() { return _addr; }
@@ -125,39 +164,63 @@ public:
     virtual uint32_t numPlanes() { return _planes; }
     virtual uint32_t totalSize() { return _size * _pages; }
     virtual uint32_t lockRegions() { return _lockRegions; }
+    virtual uint32_t pagesPerErase() { return 1; }
+    virtual uint32_t bufferWindow() { return _buffers * _size; }
+
+    // Rough speed of the decompression applet in bytes per millisecond,
+    // or zero if compressed transfers are not supported
+    virtual uint32_t decodeRate() { return 0; }
+    virtual uint32_t stagingSize() { return _stagingSize; }
 
     virtual void eraseAll(uint32_t offset) = 0;
     virtual void eraseAuto(bool enable) = 0;
 
-    virtual std::vector<bool> getLockRegions() = 0;
+    virtual std::vector<bool> getLockRegions();
     virtual void setLockRegions(const std::vector<bool>& regions);
 
-    virtual bool getSecurity() = 0;
+    virtual bool getSecurity();
     virtual void setSecurity();
 
-    virtual bool getBod() = 0;
+    virtual bool getBod();
     virtual void setBod(bool enable);
     virtual bool canBod() = 0;
 
-    virtual bool getBor() = 0;
+    virtual bool getBor();
     virtual void setBor(bool enable);
     virtual bool canBor() = 0;
 
-    virtual bool getBootFlash() = 0;
+    virtual bool getBootFlash();
     virtual void setBootFlash(bool enable);
     virtual bool canBootFlash() = 0;
 
-    virtual std::vector<uint32_t> getUniqueId() = 0;
+    virtual std::vector<uint32_t> getUniqueId();
+
+    const FlashSnapshot& snapshot();
+    void invalidateSnapshot() { _snapshot.valid = false; }
 
     virtual void writeOptions() = 0;
 
     virtual void writePage(uint32_t page) = 0;
     virtual void readPage(uint32_t page, uint8_t* data) = 0;
+    virtual void readPages(uint32_t page, uint32_t count, uint8_t* data);
 
     virtual void writeBuffer(uint32_t dst_addr, uint32_t size);
-    virtual void loadBuffer(const uint8_t* data, uint16_t size);
+    virtual void loadBuffer(const uint8_t* data, uint32_t size);
+    virtual void loadCompressed(const uint8_t* block, uint32_t size, uint32_t rawSize);
+    virtual void loadBuffer(const uint8_t* data, uint32_t size, const std::vector<FlashCopy>& copies);
+    virtual uint16_t checksumBuffer(uint32_t start_addr, uint32_t size);
+    virtual void blockSums(uint32_t start_addr, uint32_t blockSize, uint32_t blocks, std::vector<uint32_t>& sums);
 
 protected:
+    virtual void readSnapshot(FlashSnapshot& snapshot) = 0;
+
+    uint32_t buffer() { return _bufferBase + _bufferIndex * _size; }
+    uint32_t nextBuffer();
+
+    static const uint32_t StackSize;
+    static const uint32_t MaxBufferWindow;
+    static const uint32_t VmProgramSize;
+
     Samba& _samba;
     std::string _name;
     uint32_t _addr;
@@ -165,8 +228,12 @@ protected:
     uint32_t _size;
     uint32_t _planes;
     uint32_t _lockRegions;
-    uint32_t _user;
+    SramPlan _sram;
     WordCopyApplet _wordCopy;
+    Crc16Applet _crc16;
+    Lz4Applet _lz4;
+    VmApplet _vm;
+    BlockSumApplet _blockSum;
 
     FlashOption<bool> _bootFlash;
     FlashOption< std::vector<bool> > _regions;
@@ -174,9 +241,16 @@ protected:
     FlashOption<bool> _bor;
     FlashOption<bool> _security;
 
-    bool _onBufferA;
-    uint32_t _pageBufferA;
-    uint32_t _pageBufferB;
+    FlashSnapshot _snapshot;
+
+    // Ring of page buffers following the applets
+    uint32_t _bufferBase;
+    uint32_t _buffers;
+    uint32_t _bufferIndex;
+
+    // Compressed blocks are staged here and decoded into the ring
+    uint32_t _staging;
+    uint32_t _stagingSize;
 };
 
 #endif // _FLASH_H
@@ -28,15 +28,33 @@
 ///////////////////////////////////////////////////////////////////////////////
 #include <string>
 #include <exception>
+#include <algorithm>
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
 
 #include "Flasher.h"
+#include "BlockDiff.h"
+#include "Pipeline.h"
+#include "PreparedImage.h"
 
 using namespace std;
 
+// Link bytes taken by the extra commands that start the decoder applet
+#define COMPRESS_OVERHEAD   80
+
+// Only send a compressed block when the time saved on the link is more than
+// the time spent decoding it plus a few extra commands
+bool
+Flasher::compressPays(uint32_t size, uint32_t blockSize, uint32_t stagingSize, uint32_t linkRate, uint32_t decodeRate)
+{
+    uint32_t sent = blockSize + COMPRESS_OVERHEAD;
+
+    return sent < size && blockSize <= stagingSize &&
+        (uint64_t) (size - sent) * 1000 / linkRate > (uint64_t) size * 1000 / decodeRate;
+}
+
 void
 FlasherInfo::print()
 {
@@ -79,189 +97,883 @@ FlasherInfo::print()
     }
 }
 
+FlasherChecksum::FlasherChecksum(const uint8_t* data, uint32_t size, uint32_t pageSize)
+{
+    uint32_t numPages = (size + pageSize - 1) / pageSize;
+    uint32_t lastSize = size - (numPages > 0 ? (numPages - 1) * pageSize : 0);
+    std::vector<uint8_t> zeros(pageSize, 0);
+
+    // CRC every page in a single pass over the data
+    _pageCrcs.resize(numPages);
+    for (uint32_t page = 0; page < numPages; page++)
+    {
+        uint32_t bytes = (page == numPages - 1) ? lastSize : pageSize;
+        _pageCrcs[page] = Samba::checksumCalc(data + page * pageSize, bytes);
+    }
+
+    // The CRC is linear so running a CRC through a page of zeros is the XOR
+    // of the result for each of its bits.  These tables let the page CRCs
+    // be combined into the CRC of any run of pages.
+    for (int bit = 0; bit < 16; bit++)
+    {
+        _pageShift[bit] = Samba::checksumCalc(&zeros[0], pageSize, 1 << bit);
+        _lastShift[bit] = Samba::checksumCalc(&zeros[0], lastSize, 1 << bit);
+    }
+}
+
+uint16_t
+FlasherChecksum::shift(const uint16_t* table, uint16_t crc)
+{
+    uint16_t result = 0;
+
+    for (int bit = 0; bit < 16; bit++)
+    {
+        if (crc & (1 << bit))
+            result ^= table[bit];
+    }
+
+    return result;
+}
+
+uint16_t
+FlasherChecksum::pages(uint32_t firstPage, uint32_t numPages) const
+{
+    uint16_t crc = 0;
+
+    for (uint32_t page = firstPage; page < firstPage + numPages; page++)
+    {
+        if (page == _pageCrcs.size() - 1)
+            crc = shift(_lastShift, crc) ^ _pageCrcs[page];
+        else
+            crc = shift(_pageShift, crc) ^ _pageCrcs[page];
+    }
+
+    return crc;
+}
+
+FlasherChecksum::FlasherChecksum(const FlasherChecksum& checksum, uint32_t firstPage, uint32_t numPages) :
+    _pageCrcs(checksum._pageCrcs.begin() + firstPage, checksum._pageCrcs.begin() + firstPage + numPages)
+{
+    // Only the last page of the whole can be short
+    bool last = firstPage + numPages == checksum._pageCrcs.size();
+
+    memcpy(_pageShift, checksum._pageShift, sizeof(_pageShift));
+    memcpy(_lastShift, last ? checksum._lastShift : checksum._pageShift, sizeof(_lastShift));
+}
+
 void
 Flasher::erase(uint32_t foffset)
 {
     _observer.onStatus("Erase flash\n");
     _flash->eraseAll(foffset);
     _flash->eraseAuto(false);
+    _erased = foffset;
+
+    if (_contentMap)
+    {
+        _contentMap->erase(foffset, _flash->totalSize() - foffset);
+        _contentMap->save();
+    }
 }
 
 void
-Flasher::write(const char* filename, uint32_t foffset)
+Flasher::write(const char* filename, uint32_t foffset, Journal* journal)
+{
+    ImageSource image(filename);
+
+    write(image, foffset, journal);
+}
+
+std::vector<ImageExtent>
+Flasher::extents(ImageSource& image, uint32_t foffset, uint32_t& numPages)
 {
-    FILE* infile;
     uint32_t pageSize = _flash->pageSize();
-    uint32_t pageNum = 0;
-    uint32_t numPages;
-    long fsize;
-    size_t fbytes;
+    std::vector<ImageExtent> extents;
 
     if (foffset % pageSize != 0 || foffset >= _flash->totalSize())
         throw FlashOffsetError();
-    
-    infile = fopen(filename, "rb");
-    if (!infile)
-        throw FileOpenError(errno);
 
-    try
+    extents = image.extents(_flash->address(), foffset, pageSize, _flash->pagesPerErase() * pageSize);
+    if (!_patches.empty())
+        extents = overlay(extents, foffset);
+
+    // Data placed by its address is still kept clear of anything below the
+    // offset, such as a bootloader
+    numPages = 0;
+    for (uint32_t extent = 0; extent < extents.size(); extent++)
     {
-        if (fseek(infile, 0, SEEK_END) != 0 || (fsize = ftell(infile)) < 0)
-            throw FileIoError(errno);
-        
-        rewind(infile);
+        if (extents[extent].offset < foffset)
+            throw FlashOffsetError();
+        if ((uint64_t) extents[extent].offset + extents[extent].size > _flash->totalSize())
+            throw FileSizeError();
+        numPages += (extents[extent].size + pageSize - 1) / pageSize;
+    }
+
+    return extents;
+}
+
+std::vector<ImageExtent>
+Flasher::overlay(const std::vector<ImageExtent>& extents, uint32_t foffset)
+{
+    uint32_t pageSize = _flash->pageSize();
+    uint32_t unitSize = _flash->pagesPerErase() * pageSize;
+    std::vector<std::pair<uint32_t, uint32_t>> units;
+    std::vector<ImageExtent> result;
 
-        numPages = (fsize + pageSize - 1) / pageSize;
-        if (numPages > _flash->numPages())
+    _overlays.clear();
+    _overlayChecksums.clear();
+
+    // Whole erase units are patched so that no unit is split between two
+    // extents and erased again part way through
+    for (uint32_t patch = 0; patch < _patches.size(); patch++)
+    {
+        uint32_t offset = _patches[patch].offset;
+        uint64_t end = (uint64_t) offset + _patches[patch].data.size();
+
+        if (offset < foffset)
+            throw FlashOffsetError();
+        if (end > _flash->totalSize())
             throw FileSizeError();
 
-        _observer.onStatus("Write %ld bytes to flash (%u pages)\n", fsize, numPages);
+        units.push_back(std::make_pair(max(offset / unitSize * unitSize, foffset),
+                                       (uint32_t) min((end + unitSize - 1) / unitSize * unitSize,
+                                                      (uint64_t) _flash->totalSize())));
+    }
+
+    std::sort(units.begin(), units.end());
+    for (uint32_t unit = 1; unit < units.size(); unit++)
+    {
+        if (units[unit].first <= units[unit - 1].second)
+        {
+            units[unit - 1].second = max(units[unit - 1].second, units[unit].second);
+            units.erase(units.begin() + unit--);
+        }
+    }
 
-        if (_samba.canWriteBuffer())
+    // The rest of the image keeps its data and the page CRCs it already has
+    for (uint32_t extent = 0; extent < extents.size(); extent++)
+    {
+        const ImageExtent& run = extents[extent];
+        uint32_t start = run.offset;
+        uint32_t end = run.offset + run.size;
+
+        for (uint32_t unit = 0; unit <= units.size() && start < end; unit++)
         {
-            uint32_t offset = 0;
-            uint32_t bufferSize = _samba.writeBufferSize();
-            uint8_t buffer[bufferSize];
-            
-            while ((fbytes = fread(buffer, 1, bufferSize, infile)) > 0)
+            uint32_t next = unit < units.size() ? min(units[unit].first, end) : end;
+
+            if (next > start)
             {
-                _observer.onProgress(offset / pageSize, numPages);
-                
-                if (fbytes < bufferSize)
-                {
-                    memset(buffer + fbytes, 0, bufferSize - fbytes);
-                    fbytes = (fbytes + pageSize - 1) / pageSize * pageSize;
-                }
-                
-                _flash->loadBuffer(buffer, fbytes);
-                _flash->writeBuffer(foffset + offset, fbytes);
-                offset += fbytes;                
+                uint32_t firstPage = (start - run.offset) / pageSize;
+
+                _overlayChecksums.push_back(FlasherChecksum(*run.checksum, firstPage,
+                                                            (next - start + pageSize - 1) / pageSize));
+                result.push_back(ImageExtent(start, run.data + start - run.offset, next - start,
+                                             &_overlayChecksums.back()));
             }
+            if (unit < units.size())
+                start = max(start, units[unit].second);
+        }
+    }
+
+    // The patched units are built from the image, erased flash where it
+    // has no data, and the records laid over both
+    for (uint32_t unit = 0; unit < units.size(); unit++)
+    {
+        uint32_t start = units[unit].first;
+        uint32_t end = units[unit].second;
 
+        _overlays.push_back(std::string(end - start, '\xff'));
+        std::string& buffer = _overlays.back();
+
+        for (uint32_t extent = 0; extent < extents.size(); extent++)
+        {
+            const ImageExtent& run = extents[extent];
+            uint32_t from = max(start, run.offset);
+            uint32_t to = min(end, run.offset + run.size);
+
+            if (from < to)
+                memcpy(&buffer[from - start], run.data + from - run.offset, to - from);
         }
-        else
+
+        for (uint32_t patch = 0; patch < _patches.size(); patch++)
         {
-            uint8_t buffer[pageSize];
-            uint32_t pageOffset = foffset / pageSize;
+            const ImagePatch& record = _patches[patch];
 
-            while ((fbytes = fread(buffer, 1, pageSize, infile)) > 0)
-            {
-                _observer.onProgress(pageNum, numPages);
+            if (record.offset >= start && record.offset < end)
+                memcpy(&buffer[record.offset - start], record.data.data(), record.data.size());
+        }
 
-                _flash->loadBuffer(buffer, fbytes);
-                _flash->writePage(pageOffset + pageNum);
+        _overlayChecksums.push_back(FlasherChecksum((const uint8_t*) buffer.data(), buffer.size(), pageSize));
+        result.push_back(ImageExtent(start, (const uint8_t*) buffer.data(), buffer.size(),
+                                     &_overlayChecksums.back()));
+    }
 
-                pageNum++;
-                if (pageNum == numPages || fbytes != pageSize)
-                    break;
-            }
+    std::sort(result.begin(), result.end(),
+              [](const ImageExtent& a, const ImageExtent& b) { return a.offset < b.offset; });
 
-        }
+    return result;
+}
+
+bool
+Flasher::patched(const ImageExtent& extent)
+{
+    for (std::list<std::string>::iterator buffer = _overlays.begin(); buffer != _overlays.end(); buffer++)
+    {
+        if (extent.data == (const uint8_t*) buffer->data())
+            return true;
     }
-    catch(...)
+
+    return false;
+}
+
+void
+Flasher::write(ImageSource& image, uint32_t foffset, Journal* journal)
+{
+    uint32_t numPages;
+    uint32_t donePages = 0;
+    std::vector<ImageExtent> extents = this->extents(image, foffset, numPages);
+
+    // The journal follows a single run of the image
+    if (image.addressed() || !_patches.empty())
+        journal = NULL;
+
+    forgetContents(extents);
+
+    if (image.addressed())
+        _observer.onStatus("Write %u bytes of %s image to flash (%u pages)\n",
+                           image.segmentBytes(), image.formatName(), numPages);
+    else
+        _observer.onStatus("Write %u bytes to flash (%u pages)\n", image.size(), numPages);
+
+    for (uint32_t extent = 0; extent < extents.size(); extent++)
     {
-        fclose(infile);
-        throw;
+        // Patched units differ on every board and are not worth caching
+        writeExtent(extents[extent], journal, donePages, numPages, !patched(extents[extent]));
+        donePages += (extents[extent].size + _flash->pageSize() - 1) / _flash->pageSize();
     }
-    
-    fclose(infile);
+
     _observer.onProgress(numPages, numPages);
+
+    // What was erased is now written
+    _erased = NoErase;
+
+    if (_contentMap)
+        _contentMap->save();
+
+    if (journal)
+        journal->finish();
+}
+
+std::function<bool(FlasherWindow&)>
+Flasher::windows(const ImageExtent& extent, uint32_t start, uint32_t bufferSize, bool pad, bool journal)
+{
+    uint32_t pageSize = _flash->pageSize();
+    uint32_t unitSize = _flash->pagesPerErase() * pageSize;
+    uint32_t decodeRate = _flash->decodeRate();
+    std::shared_ptr<Lz4Compressor> compressor(new Lz4Compressor());
+    uint32_t offset = start;
+    uint16_t crc = 0;
+
+    // Everything here runs ahead on the pipeline thread and must not touch
+    // the device.  Whether a compressed window is worth sending is left to
+    // sendWindow, so that a window prepared once suits any link.
+    return [=](FlasherWindow& window) mutable
+    {
+        if (offset >= extent.size)
+            return false;
+
+        // An inline pipeline hands back the same window each time
+        window = FlasherWindow();
+        window.offset = offset;
+        window.size = min(bufferSize, extent.size - offset);
+        window.writeSize = window.size;
+        window.data = extent.data + offset;
+
+        // Only the tail of the image needs copying to pad it out to a page
+        if (pad && window.size % pageSize != 0)
+        {
+            window.writeSize = (window.size + pageSize - 1) / pageSize * pageSize;
+            window.padded.assign(window.data, window.data + window.size);
+            window.padded.resize(window.writeSize, 0);
+            window.data = &window.padded[0];
+        }
+
+        window.blank = true;
+        for (uint32_t i = 0; i < window.writeSize && window.blank; i++)
+            window.blank = window.data[i] == 0xff;
+
+        // The journal CRCs are chained a page at a time up to each erase
+        // unit boundary
+        for (uint32_t page = 0; journal && page * pageSize < window.writeSize; page++)
+        {
+            uint32_t end = offset + (page + 1) * pageSize;
+
+            crc = Samba::checksumCalc(window.data + page * pageSize,
+                                      min(pageSize, window.size - page * pageSize), crc);
+            if (end % unitSize == 0)
+            {
+                window.checkpoints.push_back(std::make_pair(end, crc));
+                crc = 0;
+            }
+        }
+
+        if (decodeRate > 0 && !window.blank)
+        {
+            compressor->compress(window.data, window.writeSize, window.compressed);
+            window.block = &window.compressed[0];
+            window.blockSize = window.compressed.size();
+        }
+
+        offset += window.size;
+        return true;
+    };
 }
 
 bool
-Flasher::verify(const char* filename, uint32_t& pageErrors, uint32_t& totalErrors, uint32_t foffset)
+Flasher::skipWindow(const ImageExtent& extent, const FlasherWindow& window, uint32_t erased)
+{
+    // Flash erased in this session already holds a blank window
+    return window.blank && erased != NoErase && extent.offset + window.offset >= erased;
+}
+
+std::function<bool(FlasherWindow&)>
+Flasher::prepare(const ImageExtent& extent, uint32_t start, uint32_t bufferSize, bool pad, bool journal, bool cache)
 {
-    FILE* infile;
     uint32_t pageSize = _flash->pageSize();
-    uint8_t bufferA[pageSize];
-    uint8_t bufferB[pageSize];
-    uint32_t pageNum = 0;
-    uint32_t numPages;
-    uint32_t pageOffset;
-    uint32_t byteErrors = 0;
-    uint16_t flashCrc;
-    long fsize;
-    size_t fbytes;
+    uint32_t unitSize = _flash->pagesPerErase() * pageSize;
 
-    pageErrors = 0;
-    totalErrors = 0;
+    // A resumed write starts part way into windows of its own
+    if (!_preparedCache || !cache || start != 0)
+        return windows(extent, start, bufferSize, pad, journal);
 
-    if (foffset % pageSize != 0 || foffset >= _flash->totalSize())
-        throw FlashOffsetError();
-    
-    pageOffset = foffset / pageSize;
-    
-    infile = fopen(filename, "rb");
-    if (!infile)
-        throw FileOpenError(errno);
+    PreparedKey key(extent.data, extent.size, pageSize, unitSize, bufferSize, pad, _flash->decodeRate() > 0);
+    std::shared_ptr<PreparedImage> prepared = _preparedCache->find(key);
+    uint32_t index = 0;
 
-    try
+    if (prepared)
     {
-        if (fseek(infile, 0, SEEK_END) != 0 || (fsize = ftell(infile)) < 0)
-            throw FileIoError(errno);
-        
-        rewind(infile);
+        PreparedCache* preparedCache = _preparedCache;
+        std::function<bool(FlasherWindow&)> fresh;
 
-        numPages = (fsize + pageSize - 1) / pageSize;
-        if (numPages > _flash->numPages())
-            throw FileSizeError();
+        return [=](FlasherWindow& window) mutable
+        {
+            if (fresh)
+                return fresh(window);
+            if (index >= prepared->windows())
+                return false;
+            if (prepared->window(index++, extent.data, window))
+                return true;
 
-        _observer.onStatus("Verify %ld bytes of flash\n", fsize);
+            // The file no longer checks out, so prepare the rest of the
+            // windows again.  They are rebuilt from the start of this erase
+            // unit to keep the journal CRCs chained a whole unit at a time,
+            // and those already sent are passed over.
+            uint32_t offset = window.offset;
 
-        while ((fbytes = fread(bufferA, 1, pageSize, infile)) > 0)
+            preparedCache->discard(key);
+            fresh = windows(extent, offset / unitSize * unitSize, bufferSize, pad, true);
+            do
+            {
+                if (!fresh(window))
+                    return false;
+            } while (window.offset < offset);
+            return true;
+        };
+    }
+
+    // Prepare the windows as usual, with the journal CRCs that a later
+    // write might want, and store them once the last one is done
+    std::shared_ptr<PreparedBuilder> builder(new PreparedBuilder(key));
+    std::function<bool(FlasherWindow&)> produce = windows(extent, start, bufferSize, pad, true);
+    PreparedCache* preparedCache = _preparedCache;
+
+    return [=](FlasherWindow& window) mutable
+    {
+        if (!produce(window))
         {
-            byteErrors = 0;
-            
-            _observer.onProgress(pageNum, numPages);
+            preparedCache->store(key, *builder);
+            return false;
+        }
 
-            if (_samba.canChecksumBuffer())
-            {
-                uint16_t calcCrc = 0;
-                for (uint32_t i = 0; i < fbytes; i++)
-                    calcCrc = _samba.checksumCalc(bufferA[i], calcCrc);
-                
-                flashCrc = _samba.checksumBuffer((pageOffset + pageNum) * pageSize, fbytes);
-                
-                if (flashCrc != calcCrc)
-                {
-                    _flash->readPage(pageOffset + pageNum, bufferB);
+        builder->add(window);
+        return true;
+    };
+}
 
-                    for (uint32_t i = 0; i < fbytes; i++)
-                    {
-                        if (bufferA[i] != bufferB[i])
-                            byteErrors++;
-                    }
-                }
+void
+Flasher::sendWindow(const FlasherWindow& window)
+{
+    uint32_t decodeRate = _flash->decodeRate();
+
+    if (window.block && decodeRate > 0 &&
+        compressPays(window.writeSize, window.blockSize, _flash->stagingSize(), _samba.linkRate(), decodeRate))
+        _flash->loadCompressed(window.block, window.blockSize, window.writeSize);
+    else
+        _flash->loadBuffer(window.data, window.writeSize);
+}
+
+void
+Flasher::writeExtent(const ImageExtent& extent, Journal* journal, uint32_t donePages, uint32_t numPages,
+                     bool cache)
+{
+    uint32_t foffset = extent.offset;
+    uint32_t pageSize = _flash->pageSize();
+    uint32_t start = journal ? journal->completed() : 0;
+    uint32_t mark = start;
+    bool buffered = _samba.canWriteBuffer();
+    uint32_t bufferSize = transferSize(buffered ? _samba.writeBufferSize() : _flash->bufferWindow());
+    Pipeline<FlasherWindow> pipeline(prepare(extent, start, bufferSize, buffered, journal != NULL, cache));
+    FlasherWindow window;
+
+    while (pipeline.next(window))
+    {
+        uint32_t firstPage = window.offset / pageSize;
+
+        if (numPages)
+            _observer.onProgress(donePages + firstPage, numPages);
+
+        if (!skipWindow(extent, window, _erased))
+        {
+            sendWindow(window);
+            if (buffered)
+            {
+                _flash->writeBuffer(foffset + window.offset, window.writeSize);
             }
             else
             {
-                _flash->readPage(pageOffset + pageNum, bufferB);
-
-                for (uint32_t i = 0; i < fbytes; i++)
+                // Send the whole window in one transfer then program it a
+                // page at a time
+                for (uint32_t page = 0; page * pageSize < window.writeSize; page++)
                 {
-                    if (bufferA[i] != bufferB[i])
-                        byteErrors++;
+                    if (numPages)
+                        _observer.onProgress(donePages + firstPage + page, numPages);
+                    _flash->writePage((foffset + window.offset) / pageSize + page);
                 }
             }
-            
-            if (byteErrors != 0)
-            {
-                pageErrors++;
-                totalErrors += byteErrors;
-            }
 
-            pageNum++;
-            if (pageNum == numPages || fbytes != pageSize)
-                break;
+            if (_contentMap)
+                _contentMap->record(foffset + window.offset, window.data, window.writeSize);
+        }
+
+        for (uint32_t point = 0; point < window.checkpoints.size(); point++)
+        {
+            uint16_t crc = window.checkpoints[point].second;
+
+            checkpoint(journal, foffset, mark, window.checkpoints[point].first, crc);
         }
     }
-    catch(...)
+}
+
+bool
+Flasher::writeStream(int fd, uint32_t& pageErrors, uint32_t& totalErrors, uint32_t foffset, bool verify)
+{
+    uint32_t pageSize = _flash->pageSize();
+    uint32_t unitSize = _flash->pagesPerErase() * pageSize;
+    uint32_t window = transferSize(_samba.canWriteBuffer() ? _samba.writeBufferSize() : _flash->bufferWindow());
+    Journal* journal = NULL;
+    uint32_t written = 0;
+    std::string chunk;
+
+    if (foffset % pageSize != 0 || foffset >= _flash->totalSize())
+        throw FlashOffsetError();
+
+    pageErrors = 0;
+    totalErrors = 0;
+    _mismatches.clear();
+
+    _observer.onStatus("%s stream to flash\n", verify ? "Write and verify" : "Write");
+
+    // Chunks cover whole erase units so that each one is written just like
+    // an extent of an image, though one that is never seen again so there
+    // is no point keeping it prepared
+    ImageStream stream(fd, max(window, unitSize));
+
+    // The length of the stream is not known up front
+    forgetContents(foffset, _flash->totalSize() - foffset);
+
+    while (stream.next(chunk))
     {
-        fclose(infile);
-        throw;
+        const uint8_t* data = (const uint8_t*) chunk.data();
+
+        if ((uint64_t) foffset + written + chunk.size() > _flash->totalSize())
+            throw FileSizeError();
+
+        FlasherChecksum checksum(data, chunk.size(), pageSize);
+        ImageExtent extent(foffset + written, data, chunk.size(), &checksum);
+
+        if (verify)
+            writeVerifyExtent(extent, journal, 0, 0, pageErrors, totalErrors, false);
+        else
+            writeExtent(extent, NULL, 0, 0, false);
+
+        written += chunk.size();
+        _observer.onBytes(written);
+    }
+    _erased = NoErase;
+
+    _observer.onStatus("\nWrote %u bytes (%u pages)\n", written, (written + pageSize - 1) / pageSize);
+
+    if (_contentMap)
+        _contentMap->save();
+
+    return pageErrors == 0;
+}
+
+void
+Flasher::writeDiff(const char* filename, uint32_t foffset)
+{
+    ImageSource source(filename);
+
+    writeDiff(source, foffset);
+}
+
+void
+Flasher::writeDiff(ImageSource& source, uint32_t foffset)
+{
+    uint32_t pageSize = _flash->pageSize();
+    uint32_t unitSize = _flash->pagesPerErase() * pageSize;
+    uint32_t window = transferSize(_samba.canWriteBuffer() ? _samba.writeBufferSize() : _flash->bufferWindow());
+    std::vector<uint8_t> image;
+    std::vector<uint32_t> sums;
+    std::vector<uint32_t> scanned;
+    std::vector<bool> known;
+    std::vector<FlashCopy> copies;
+    uint32_t numPages;
+    uint32_t size;
+    uint32_t regionSize;
+    uint32_t blocks;
+    uint32_t reused = 0;
+    uint32_t fsize = source.size();
+
+    if (source.addressed())
+        throw ImageFormatError("A differential update needs a binary image");
+
+    if (foffset % pageSize != 0 || foffset >= _flash->totalSize())
+        throw FlashOffsetError();
+
+    // Each window must cover whole erase units, otherwise loading one
+    // window could depend on flash already erased for the one before
+    if (window < unitSize)
+    {
+        _observer.onStatus("Buffer window is too small for a differential update\n");
+        write(source, foffset);
+        return;
+    }
+
+    numPages = (fsize + pageSize - 1) / pageSize;
+    if (numPages > _flash->numPages() - foffset / pageSize)
+        throw FileSizeError();
+
+    size = numPages * pageSize;
+    image.assign(size, 0);
+    copy(source.data(), source.data() + fsize, image.begin());
+
+    // Sum the flash that the image is about to overwrite, apart from the
+    // blocks recorded by an earlier write to this device
+    regionSize = min((size + unitSize - 1) / unitSize * unitSize, _flash->totalSize() - foffset);
+    blocks = regionSize / ContentMap::BlockSize;
+    if (_contentMap && _contentMap->sums(foffset, blocks, sums, known) > 0 &&
+        checkContents(foffset, known))
+        _observer.onStatus("Using the flash contents recorded for this device\n");
+    else
+        known.assign(blocks, false);
+
+    uint32_t unknown = count(known.begin(), known.end(), false);
+    if (unknown > 0)
+        _observer.onStatus("Scan %u bytes of flash\n", unknown * ContentMap::BlockSize);
+    sums.resize(blocks * 2);
+    for (uint32_t block = 0; block < blocks; )
+    {
+        uint32_t run = 0;
+
+        while (block + run < blocks && !known[block + run])
+            run++;
+        if (run == 0)
+        {
+            block++;
+            continue;
+        }
+
+        _flash->blockSums(foffset + block * ContentMap::BlockSize, ContentMap::BlockSize, run, scanned);
+        copy(scanned.begin(), scanned.end(), sums.begin() + block * 2);
+        block += run;
+    }
+    forgetContents(foffset, size);
+
+    BlockDiff diff(sums, ContentMap::BlockSize);
+    bool descending = diff.plan(&image[0], size, window, copies);
+    for (uint32_t i = 0; i < copies.size(); i++)
+        reused += copies[i].size;
+
+    _observer.onStatus("Write %u bytes to flash (%u pages), %u bytes already in flash\n",
+                       fsize, numPages, reused);
+
+    uint32_t windows = (size + window - 1) / window;
+    for (uint32_t i = 0; i < windows; i++)
+    {
+        uint32_t windowNum = descending ? windows - 1 - i : i;
+        uint32_t start = windowNum * window;
+        uint32_t bytes = min(window, size - start);
+        std::vector<FlashCopy> windowCopies;
+
+        _observer.onProgress(i * window / pageSize, numPages);
+
+        for (uint32_t index = 0; index < copies.size(); index++)
+        {
+            if (copies[index].offset >= start && copies[index].offset < start + bytes)
+                windowCopies.push_back(FlashCopy(copies[index].offset - start,
+                                                 foffset + copies[index].src,
+                                                 copies[index].size));
+        }
+
+        _flash->loadBuffer(&image[start], bytes, windowCopies);
+        writeWindow(foffset + start, bytes);
+
+        // The sums are not proof that a block matches so send the window
+        // in full if the flash does not agree with it
+        if (!windowCopies.empty() &&
+            _flash->checksumBuffer(foffset + start, bytes) != _samba.checksumCalc(&image[start], bytes))
+        {
+            _flash->loadBuffer(&image[start], bytes);
+            writeWindow(foffset + start, bytes);
+        }
+    }
+
+    _observer.onProgress(numPages, numPages);
+    _erased = NoErase;
+
+    if (_contentMap)
+    {
+        _contentMap->record(foffset, &image[0], size);
+        _contentMap->save();
+    }
+}
+
+void
+Flasher::writeWindow(uint32_t offset, uint32_t size)
+{
+    uint32_t pageSize = _flash->pageSize();
+
+    if (_samba.canWriteBuffer())
+    {
+        _flash->writeBuffer(offset, size);
+    }
+    else
+    {
+        for (uint32_t page = 0; page < size / pageSize; page++)
+            _flash->writePage(offset / pageSize + page);
+    }
+}
+
+void
+Flasher::forgetContents(uint32_t foffset, uint32_t size)
+{
+    uint32_t unitSize = _flash->pagesPerErase() * _flash->pageSize();
+
+    if (!_contentMap)
+        return;
+
+    // Everything up to the end of the last erase unit is about to change.
+    // Save straight away so an interrupted write leaves nothing stale.
+    _contentMap->forget(foffset, (size + unitSize - 1) / unitSize * unitSize);
+    _contentMap->save();
+}
+
+void
+Flasher::forgetContents(const std::vector<ImageExtent>& extents)
+{
+    uint32_t unitSize = _flash->pagesPerErase() * _flash->pageSize();
+
+    if (!_contentMap)
+        return;
+
+    for (uint32_t extent = 0; extent < extents.size(); extent++)
+        _contentMap->forget(extents[extent].offset,
+                            (extents[extent].size + unitSize - 1) / unitSize * unitSize);
+    _contentMap->save();
+}
+
+bool
+Flasher::checkContents(uint32_t foffset, const std::vector<bool>& known)
+{
+    // Something else may have written the flash since, so compare each run
+    // of recorded blocks with the device in full
+    for (uint32_t block = 0; block < known.size(); )
+    {
+        uint32_t run = 0;
+
+        while (block + run < known.size() && known[block + run])
+            run++;
+        if (run == 0)
+        {
+            block++;
+            continue;
+        }
+
+        if (_flash->checksumBuffer(foffset + block * ContentMap::BlockSize, run * ContentMap::BlockSize) !=
+            _contentMap->crc(foffset + block * ContentMap::BlockSize, run))
+            return false;
+        block += run;
+    }
+
+    return true;
+}
+
+void
+Flasher::checkpoint(Journal*& journal, uint32_t foffset, uint32_t& mark, uint32_t offset, uint16_t& crc)
+{
+    uint32_t unitSize = _flash->pagesPerErase() * _flash->pageSize();
+
+    if (!journal || offset % unitSize != 0)
+        return;
+
+    // Record the erase units written since the last checkpoint once the
+    // flash agrees with them.  Stop journaling after the first mismatch.
+    if (_flash->checksumBuffer(foffset + mark, offset - mark) == crc)
+        journal->update(offset);
+    else
+        journal = NULL;
+
+    mark = offset;
+    crc = 0;
+}
+
+uint32_t
+Flasher::transferSize(uint32_t limit)
+{
+    uint32_t pageSize = _flash->pageSize();
+
+    return transferSize(pageSize, _flash->pagesPerErase() * pageSize, _flash->bufferWindow(), limit);
+}
+
+uint32_t
+Flasher::transferSize(uint32_t pageSize, uint32_t unitSize, uint32_t bufferWindow, uint32_t limit)
+{
+    uint32_t size = min(bufferWindow, limit);
+    uint32_t pages = 1;
+
+    // Keep windows aligned to the erase units so that checkpoints land on
+    // window boundaries
+    if (size >= unitSize)
+        return size / unitSize * unitSize;
+
+    while (pages * 2 * pageSize <= size)
+        pages *= 2;
+
+    return pages * pageSize;
+}
+
+void
+Flasher::loadBuffer(const uint8_t* data, uint32_t size)
+{
+    uint32_t decodeRate = _flash->decodeRate();
+
+    if (decodeRate > 0)
+    {
+        _compressor.compress(data, size, _block);
+
+        if (compressPays(size, _block.size(), _flash->stagingSize(), _samba.linkRate(), decodeRate))
+        {
+            _flash->loadCompressed(&_block[0], _block.size(), size);
+            return;
+        }
+    }
+
+    _flash->loadBuffer(data, size);
+}
+
+uint32_t
+Flasher::resume(const char* filename, Journal& journal, uint32_t foffset)
+{
+    ImageSource image(filename);
+
+    return resume(image, journal, foffset);
+}
+
+uint32_t
+Flasher::resume(ImageSource& image, Journal& journal, uint32_t foffset)
+{
+    uint32_t unitSize = _flash->pagesPerErase() * _flash->pageSize();
+    uint32_t completed = journal.completed();
+
+    if (completed == 0)
+        return 0;
+
+    if (image.addressed())
+        throw ImageFormatError("Only a binary image can be resumed");
+
+    // Checkpoints are only recorded at whole units within the image, so any
+    // other value comes from a different image or a damaged journal.  Only
+    // the last unit in the journal is checked.  If the flash no longer holds
+    // it then none of the journal can be trusted.
+    if (completed < unitSize || completed % unitSize != 0 || completed > image.size() ||
+        _flash->checksumBuffer(foffset + completed - unitSize, unitSize) !=
+        _samba.checksumCalc(image.data() + completed - unitSize, unitSize))
+    {
+        _observer.onStatus("Journal does not match the flash contents, starting from the beginning\n");
+        journal.update(0);
+        return 0;
+    }
+
+    _observer.onStatus("Resume at offset 0x%x\n", foffset + completed);
+
+    return completed;
+}
+
+bool
+Flasher::verify(const char* filename, uint32_t& pageErrors, uint32_t& totalErrors, uint32_t foffset)
+{
+    ImageSource image(filename);
+
+    return verify(image, pageErrors, totalErrors, foffset);
+}
+
+bool
+Flasher::verify(ImageSource& image, uint32_t& pageErrors, uint32_t& totalErrors, uint32_t foffset)
+{
+    uint32_t pageSize = _flash->pageSize();
+    uint32_t windowPages;
+    uint32_t numPages;
+    uint32_t donePages = 0;
+    std::vector<ImageExtent> extents;
+
+    pageErrors = 0;
+    totalErrors = 0;
+    _mismatches.clear();
+
+    extents = this->extents(image, foffset, numPages);
+
+    if (image.addressed())
+        _observer.onStatus("Verify %u bytes of %s image\n", image.segmentBytes(), image.formatName());
+    else
+        _observer.onStatus("Verify %u bytes of flash\n", image.size());
+
+    if (numPages == 0)
+        return true;
+
+    // Checksum the largest window the bootloader accepts and only narrow
+    // down to individual pages when a window does not match
+    if (_samba.canChecksumBuffer())
+        windowPages = _samba.checksumBufferSize() / pageSize;
+    else
+        windowPages = _flash->bufferWindow() / pageSize;
+    if (windowPages == 0)
+        windowPages = 1;
+
+    for (uint32_t extent = 0; extent < extents.size(); extent++)
+    {
+        const ImageExtent& run = extents[extent];
+        uint32_t runPages = (run.size + pageSize - 1) / pageSize;
+
+        for (uint32_t pageNum = 0; pageNum < runPages; pageNum += windowPages)
+        {
+            _observer.onProgress(donePages + pageNum, numPages);
+
+            pageErrors += verifyPages(*run.checksum, run.data, run.size, run.offset, pageNum,
+                                      min(windowPages, runPages - pageNum), false, totalErrors);
+        }
+        donePages += runPages;
     }
-    
-    fclose(infile);
 
      _observer.onProgress(numPages, numPages);
     
@@ -271,15 +983,170 @@ Flasher::verify(const char* filename, uint32_t& pageErrors, uint32_t& totalError
     return true;
 }
 
+uint32_t
+Flasher::verifyPages(const FlasherChecksum& checksum,
+                     const uint8_t* data,
+                     uint32_t size,
+                     uint32_t addr,
+                     uint32_t firstPage,
+                     uint32_t numPages,
+                     bool mismatch,
+                     uint32_t& totalErrors)
+{
+    uint32_t pageSize = _flash->pageSize();
+    uint32_t start = firstPage * pageSize;
+    uint32_t bytes = min(numPages * pageSize, size - start);
+    uint32_t byteErrors;
+    uint8_t flashPage[pageSize];
+
+    // A known mismatch does not need to be checksummed again
+    if (!mismatch && _flash->checksumBuffer(addr + start, bytes) == checksum.pages(firstPage, numPages))
+        return 0;
+
+    // Split the window in two.  If the first half is good, the second half
+    // must hold the mismatch.
+    if (numPages > 1)
+    {
+        uint32_t half = numPages / 2;
+        uint32_t errors = verifyPages(checksum, data, size, addr, firstPage, half, false, totalErrors);
+
+        return errors + verifyPages(checksum, data, size, addr, firstPage + half, numPages - half,
+                                    errors == 0, totalErrors);
+    }
+
+    _flash->readPage((addr + start) / pageSize, flashPage);
+
+    byteErrors = _mismatches.compare(_flash->address() + addr + start, data + start, flashPage, bytes);
+    totalErrors += byteErrors;
+
+    return byteErrors != 0 ? 1 : 0;
+}
+
+bool
+Flasher::writeVerify(const char* filename, uint32_t& pageErrors, uint32_t& totalErrors, uint32_t foffset,
+                     Journal* journal)
+{
+    ImageSource image(filename);
+
+    return writeVerify(image, pageErrors, totalErrors, foffset, journal);
+}
+
+bool
+Flasher::writeVerify(ImageSource& image, uint32_t& pageErrors, uint32_t& totalErrors, uint32_t foffset,
+                     Journal* journal)
+{
+    uint32_t numPages;
+    uint32_t donePages = 0;
+    std::vector<ImageExtent> extents = this->extents(image, foffset, numPages);
+
+    pageErrors = 0;
+    totalErrors = 0;
+    _mismatches.clear();
+
+    if (image.addressed() || !_patches.empty())
+        journal = NULL;
+
+    forgetContents(extents);
+
+    if (image.addressed())
+        _observer.onStatus("Write and verify %u bytes of %s image to flash (%u pages)\n",
+                           image.segmentBytes(), image.formatName(), numPages);
+    else
+        _observer.onStatus("Write and verify %u bytes to flash (%u pages)\n", image.size(), numPages);
+
+    for (uint32_t extent = 0; extent < extents.size(); extent++)
+    {
+        writeVerifyExtent(extents[extent], journal, donePages, numPages, pageErrors, totalErrors,
+                          !patched(extents[extent]));
+        donePages += (extents[extent].size + _flash->pageSize() - 1) / _flash->pageSize();
+    }
+
+    _observer.onProgress(numPages, numPages);
+    _erased = NoErase;
+
+    if (_contentMap)
+        _contentMap->save();
+
+    if (pageErrors != 0)
+        return false;
+
+    if (journal)
+        journal->finish();
+
+    return true;
+}
+
+void
+Flasher::writeVerifyExtent(const ImageExtent& extent, Journal*& journal, uint32_t donePages, uint32_t numPages,
+                           uint32_t& pageErrors, uint32_t& totalErrors, bool cache)
+{
+    uint32_t size = extent.size;
+    uint32_t foffset = extent.offset;
+    uint32_t pageSize = _flash->pageSize();
+    uint32_t unitSize = _flash->pagesPerErase() * pageSize;
+    bool buffered = _samba.canWriteBuffer();
+    uint32_t bufferSize = transferSize(buffered ? _samba.writeBufferSize() : _flash->bufferWindow());
+    const FlasherChecksum& checksum = *extent.checksum;
+    Pipeline<FlasherWindow> pipeline(prepare(extent, journal ? journal->completed() : 0, bufferSize, buffered, false,
+                                             cache));
+    FlasherWindow window;
+
+    while (pipeline.next(window))
+    {
+        uint32_t offset = window.offset;
+        uint32_t firstPage = offset / pageSize;
+        uint32_t windowPages = (window.size + pageSize - 1) / pageSize;
+
+        if (numPages)
+            _observer.onProgress(donePages + firstPage, numPages);
+
+        if (!skipWindow(extent, window, _erased))
+        {
+            sendWindow(window);
+            if (buffered)
+            {
+                _flash->writeBuffer(foffset + offset, window.writeSize);
+            }
+            else
+            {
+                for (uint32_t page = 0; page < windowPages; page++)
+                    _flash->writePage((foffset + offset) / pageSize + page);
+            }
+        }
+
+        // The image CRCs are already known so only read the flash back if
+        // the checksums disagree
+        if (_flash->checksumBuffer(foffset + offset, window.size) != checksum.pages(firstPage, windowPages))
+        {
+            pageErrors += verifyPages(checksum, extent.data, size, foffset, firstPage,
+                                      windowPages, true, totalErrors);
+        }
+        else if (_contentMap)
+        {
+            _contentMap->record(foffset + offset, extent.data + offset, window.size);
+        }
+
+        // Every buffer so far has been verified so the journal can be
+        // advanced on each erase unit boundary
+        if (pageErrors != 0)
+            journal = NULL;
+        else if (journal && (offset + window.size) % unitSize == 0)
+            journal->update(offset + window.size);
+    }
+}
+
 void
 Flasher::read(const char* filename, uint32_t fsize, uint32_t foffset)
 {
     FILE* outfile;
     uint32_t pageSize = _flash->pageSize();
-    uint8_t buffer[pageSize];
+    uint32_t windowPages = _flash->bufferWindow() / pageSize;
+    uint8_t buffer[windowPages * pageSize];
     uint32_t pageNum = 0;
     uint32_t pageOffset;
     uint32_t numPages;
+    uint32_t count;
+    size_t bytes;
     size_t fbytes;
 
     if (foffset % pageSize != 0 || foffset >= _flash->totalSize())
@@ -302,16 +1169,16 @@ Flasher::read(const char* filename, uint32_t fsize, uint32_t foffset)
     
     try
     {
-        for (pageNum = 0; pageNum < numPages; pageNum++)
+        for (pageNum = 0; pageNum < numPages; pageNum += count)
         {
             _observer.onProgress(pageNum, numPages);
 
-            _flash->readPage(pageOffset + pageNum, buffer);
+            count = min(windowPages, numPages - pageNum);
+            _flash->readPages(pageOffset + pageNum, count, buffer);
 
-            if (pageNum == numPages - 1 && fsize % pageSize > 0)
-                pageSize = fsize % pageSize;
-            fbytes = fwrite(buffer, 1, pageSize, outfile);
-            if (fbytes != pageSize)
+            bytes = min(count * pageSize, fsize - pageNum * pageSize);
+            fbytes = fwrite(buffer, 1, bytes, outfile);
+            if (fbytes != bytes)
                 throw FileShortError();
         }
     }
@@ -327,7 +1194,7 @@ Flasher::read(const char* filename, uint32_t fsize, uint32_t foffset)
 }
 
 void
-Flasher::lock(string& regionArg, bool enable)
+Flasher::lock(const string& regionArg, bool enable)
 {
     if (regionArg.empty())
     {
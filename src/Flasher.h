@@ -32,11 +32,20 @@
 #include <string>
 #include <exception>
 #include <vector>
+#include <list>
+#include <functional>
 
 #include "Device.h"
 #include "Flash.h"
 #include "Samba.h"
 #include "FileError.h"
+#include "Journal.h"
+#include "ContentMap.h"
+#include "Lz4Compressor.h"
+#include "ImageSource.h"
+#include "VerifyDiff.h"
+
+class PreparedCache;
 
 class FlashOffsetError : public std::exception
 {
@@ -53,6 +62,9 @@ public:
     
     virtual void onStatus(const char *message, ...) = 0;
     virtual void onProgress(int num, int div) = 0;
+
+    // Progress of a stream whose size is not known up front
+    virtual void onBytes(uint32_t bytes) {}
 };
 
 class FlasherInfo
@@ -89,23 +101,146 @@ public:
     std::vector<uint32_t> uniqueId;
 };
 
+class FlasherChecksum
+{
+public:
+    FlasherChecksum(const uint8_t* data, uint32_t size, uint32_t pageSize);
+
+    // The CRCs of a run of the pages of another, without reading them again
+    FlasherChecksum(const FlasherChecksum& checksum, uint32_t firstPage, uint32_t numPages);
+    virtual ~FlasherChecksum() {}
+
+    uint16_t pages(uint32_t firstPage, uint32_t numPages) const;
+
+private:
+    std::vector<uint16_t> _pageCrcs;
+    uint16_t _pageShift[16];
+    uint16_t _lastShift[16];
+
+    static uint16_t shift(const uint16_t* table, uint16_t crc);
+};
+
+// A window of an extent made ready for the device ahead of time, so that
+// the thread talking to the device only has to send it
+class FlasherWindow
+{
+public:
+    FlasherWindow() : offset(0), size(0), writeSize(0), data(NULL), block(NULL), blockSize(0), blank(false) {}
+
+    uint32_t offset;
+    uint32_t size;
+    uint32_t writeSize;
+    const uint8_t* data;
+    std::vector<uint8_t> padded;
+
+    // The window compressed, which is only sent if that pays on the link
+    const uint8_t* block;
+    uint32_t blockSize;
+    std::vector<uint8_t> compressed;
+    bool blank;
+
+    // Journal CRCs of the data since the last erase unit boundary, at each
+    // boundary reached in the window
+    std::vector<std::pair<uint32_t, uint16_t>> checkpoints;
+};
+
 class Flasher
 {
 public:
-    Flasher(Samba& samba, Device& device, FlasherObserver& observer) : _samba(samba), _flash(device.getFlash()), _observer(observer) {}
+    Flasher(Samba& samba, Device& device, FlasherObserver& observer) : _samba(samba), _flash(device.getFlash()), _observer(observer), _contentMap(NULL), _preparedCache(NULL), _erased(NoErase) {}
     virtual ~Flasher() {}
 
+    // Keep the map up to date with everything written or erased
+    void setContentMap(ContentMap* contentMap) { _contentMap = contentMap; }
+
+    // Keep the windows of each image prepared in the cache, and use them
+    // again rather than preparing the same image for the same flash twice
+    void setPreparedCache(PreparedCache* preparedCache) { _preparedCache = preparedCache; }
+
+    // Lay the records of one unit over every image written or verified.
+    // Only the erase units that they touch are copied, the rest of the
+    // image is sent as it is with the page CRCs it already has.
+    void setPatches(const std::vector<ImagePatch>& patches) { _patches = patches; }
+
     void erase(uint32_t foffset);
-    void write(const char* filename, uint32_t foffset = 0);
+    void write(const char* filename, uint32_t foffset = 0, Journal* journal = NULL);
+    void write(ImageSource& image, uint32_t foffset = 0, Journal* journal = NULL);
+    void writeDiff(const char* filename, uint32_t foffset = 0);
+    void writeDiff(ImageSource& image, uint32_t foffset = 0);
     bool verify(const char* filename, uint32_t& pageErrors, uint32_t& totalErrors, uint32_t foffset = 0);
+    bool verify(ImageSource& image, uint32_t& pageErrors, uint32_t& totalErrors, uint32_t foffset = 0);
+    bool writeVerify(const char* filename, uint32_t& pageErrors, uint32_t& totalErrors, uint32_t foffset = 0,
+                     Journal* journal = NULL);
+    bool writeVerify(ImageSource& image, uint32_t& pageErrors, uint32_t& totalErrors, uint32_t foffset = 0,
+                     Journal* journal = NULL);
+    // Write a stream of unknown size, such as stdin, as it arrives while
+    // holding only a few windows of it in memory
+    bool writeStream(int fd, uint32_t& pageErrors, uint32_t& totalErrors, uint32_t foffset = 0,
+                     bool verify = false);
+    uint32_t resume(const char* filename, Journal& journal, uint32_t foffset = 0);
+    uint32_t resume(ImageSource& image, Journal& journal, uint32_t foffset = 0);
     void read(const char* filename, uint32_t fsize, uint32_t foffset = 0);
-    void lock(std::string& regionArg, bool enable);
+    void lock(const std::string& regionArg, bool enable);
     void info(FlasherInfo& info);
 
+    // Where the last verify found the flash to differ from the image
+    const VerifyDiff& mismatches() const { return _mismatches; }
+
+    // The bytes sent in each window of a write, given the page and erase
+    // unit sizes, the ring of page buffers and the largest transfer
+    static uint32_t transferSize(uint32_t pageSize, uint32_t unitSize, uint32_t bufferWindow, uint32_t limit);
+
+    // Whether sending a window compressed is quicker than sending it raw
+    static bool compressPays(uint32_t size, uint32_t blockSize, uint32_t stagingSize, uint32_t linkRate,
+                             uint32_t decodeRate);
+
+    // The steps of a write that do not touch the device, which Plan
+    // follows to show the same windows that a real run sends
+    std::vector<ImageExtent> extents(ImageSource& image, uint32_t foffset, uint32_t& numPages);
+    bool patched(const ImageExtent& extent);
+    std::function<bool(FlasherWindow&)> prepare(const ImageExtent& extent, uint32_t start, uint32_t bufferSize,
+                                                bool pad, bool journal, bool cache);
+    uint32_t transferSize(uint32_t limit);
+    static bool skipWindow(const ImageExtent& extent, const FlasherWindow& window, uint32_t erased);
+
+    static const uint32_t NoErase = 0xffffffff;
+
 private:
+    std::vector<ImageExtent> overlay(const std::vector<ImageExtent>& extents, uint32_t foffset);
+    std::function<bool(FlasherWindow&)> windows(const ImageExtent& extent, uint32_t start, uint32_t bufferSize,
+                                                bool pad, bool journal);
+    void sendWindow(const FlasherWindow& window);
+    void writeExtent(const ImageExtent& extent, Journal* journal, uint32_t donePages, uint32_t numPages,
+                     bool cache);
+    void writeVerifyExtent(const ImageExtent& extent, Journal*& journal, uint32_t donePages, uint32_t numPages,
+                           uint32_t& pageErrors, uint32_t& totalErrors, bool cache);
+    uint32_t verifyPages(const FlasherChecksum& checksum,
+                         const uint8_t* data,
+                         uint32_t size,
+                         uint32_t addr,
+                         uint32_t firstPage,
+                         uint32_t numPages,
+                         bool mismatch,
+                         uint32_t& totalErrors);
+    void loadBuffer(const uint8_t* data, uint32_t size);
+    void writeWindow(uint32_t offset, uint32_t size);
+    void forgetContents(uint32_t foffset, uint32_t size);
+    void forgetContents(const std::vector<ImageExtent>& extents);
+    bool checkContents(uint32_t foffset, const std::vector<bool>& known);
+    void checkpoint(Journal*& journal, uint32_t foffset, uint32_t& mark, uint32_t offset, uint16_t& crc);
+
     Samba& _samba;
     Device::FlashPtr& _flash;
     FlasherObserver& _observer;
+    ContentMap* _contentMap;
+    PreparedCache* _preparedCache;
+    uint32_t _erased;
+    VerifyDiff _mismatches;
+    Lz4Compressor _compressor;
+    std::vector<ImagePatch> _patches;
+    std::list<std::string> _overlays;
+    std::list<FlasherChecksum> _overlayChecksums;
+    std::vector<uint8_t> _block;
 };
 
 #endif // _FLASHER_H
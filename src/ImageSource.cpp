@@ -0,0 +1,744 @@
+///////////////////////////////////////////////////////////////////////////////
+// BOSSA
+//
+// Copyright (c) 2011-2018, ShumaTech
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the <organization> nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+
+#if !defined(__WIN32__)
+#include <sys/mman.h>
+#include <poll.h>
+#endif
+
+#include "ImageSource.h"
+#include "Flasher.h"
+
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
+
+#define UF2_MAGIC_START0    0x0a324655
+#define UF2_MAGIC_START1    0x9e5d5157
+#define UF2_MAGIC_END       0x0ab16f30
+#define UF2_NOT_MAIN_FLASH  0x00000001
+#define UF2_BLOCK_SIZE      512
+#define UF2_PAYLOAD         32
+#define UF2_MAX_PAYLOAD     476
+
+#define ELF_PT_LOAD         1
+
+static uint32_t
+le32(const uint8_t* data)
+{
+    return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t) data[3] << 24);
+}
+
+static uint16_t
+le16(const uint8_t* data)
+{
+    return data[0] | (data[1] << 8);
+}
+
+static int
+hexDigit(uint8_t c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+ImageSource::ImageSource(const char* filename, bool snapshot) :
+    _name(filename), _data(NULL), _size(0), _mapped(false), _format(Binary)
+{
+    load(filename, snapshot);
+
+    try
+    {
+        parse();
+    }
+    catch (...)
+    {
+#if !defined(__WIN32__)
+        if (_mapped)
+            munmap((void*) _data, _size);
+#endif
+        throw;
+    }
+}
+
+void
+ImageSource::load(const char* filename, bool snapshot)
+{
+    struct stat st;
+    int fd;
+
+    fd = open(filename, O_RDONLY | O_BINARY);
+    if (fd < 0)
+        throw FileOpenError(errno);
+
+    if (fstat(fd, &st) != 0 || st.st_size < 0 || st.st_size > 0xffffffffLL)
+    {
+        int errnum = errno;
+        close(fd);
+        throw FileIoError(errnum);
+    }
+    _size = st.st_size;
+
+    // Pipes have no size up front so they are read to the end
+    if (!S_ISREG(st.st_mode))
+    {
+        readAll(fd);
+        return;
+    }
+
+#if !defined(__WIN32__)
+    if (_size > 0 && !snapshot)
+    {
+        void* map = mmap(NULL, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED)
+        {
+            _data = (const uint8_t*) map;
+            _mapped = true;
+        }
+    }
+#endif
+
+    // Fall back to reading the file for anything that cannot be mapped
+    if (!_mapped)
+    {
+        FILE* infile = fdopen(fd, "rb");
+
+        if (!infile)
+        {
+            int errnum = errno;
+            close(fd);
+            throw FileIoError(errnum);
+        }
+
+        _contents.resize(_size);
+        if (_size > 0 && fread(&_contents[0], 1, _size, infile) != _size)
+        {
+            fclose(infile);
+            throw FileIoError(errno);
+        }
+        fclose(infile);
+        _data = (const uint8_t*) _contents.data();
+        return;
+    }
+
+    close(fd);
+}
+
+void
+ImageSource::readAll(int fd)
+{
+    char buffer[65536];
+    ssize_t got;
+
+    while ((got = ::read(fd, buffer, sizeof(buffer))) != 0)
+    {
+        if (got < 0)
+        {
+            int errnum = errno;
+
+            if (errnum == EINTR)
+                continue;
+            close(fd);
+            throw FileIoError(errnum);
+        }
+        if (_contents.size() + got > 0xffffffffULL)
+        {
+            close(fd);
+            throw FileSizeError();
+        }
+        _contents.append(buffer, got);
+    }
+    close(fd);
+
+    _size = _contents.size();
+    _data = (const uint8_t*) _contents.data();
+}
+
+ImageSource::ImageSource(const std::string& name, const std::vector<ImagePart>& parts) :
+    _name(name), _data(NULL), _size(0), _mapped(false), _format(Composite)
+{
+    for (uint32_t part = 0; part < parts.size(); part++)
+    {
+        ImageSource& image = *parts[part].image;
+
+        if (image.addressed())
+        {
+            _segments.insert(_segments.end(), image.segments().begin(), image.segments().end());
+        }
+        else if (image.size() > 0)
+        {
+            _segments.push_back(ImageSegment(parts[part].offset, image.data(), image.size(), true));
+        }
+        _parts.push_back(parts[part].image);
+    }
+}
+
+ImageSource::~ImageSource()
+{
+#if !defined(__WIN32__)
+    if (_mapped)
+        munmap((void*) _data, _size);
+#endif
+}
+
+FlasherChecksum&
+ImageSource::checksum(uint32_t pageSize)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    std::shared_ptr<FlasherChecksum>& checksum = _checksums[pageSize];
+
+    if (!checksum)
+        checksum.reset(new FlasherChecksum(_data, _size, pageSize));
+
+    return *checksum;
+}
+
+const char*
+ImageSource::formatName()
+{
+    switch (_format)
+    {
+    case IntelHex:
+        return "Intel HEX";
+    case Elf:
+        return "ELF";
+    case Uf2:
+        return "UF2";
+    case Composite:
+        return "combined";
+    default:
+        return "binary";
+    }
+}
+
+void
+ImageSource::parse()
+{
+    if (_size >= UF2_BLOCK_SIZE && le32(_data) == UF2_MAGIC_START0 && le32(_data + 4) == UF2_MAGIC_START1)
+    {
+        _format = Uf2;
+        parseUf2();
+    }
+    else if (_size >= 52 && memcmp(_data, "\x7f" "ELF", 4) == 0)
+    {
+        _format = Elf;
+        parseElf();
+    }
+    else if (_size > 0 && _data[0] == ':' && parseHex())
+    {
+        _format = IntelHex;
+    }
+    else
+    {
+        return;
+    }
+
+    std::sort(_segments.begin(), _segments.end(),
+              [](const ImageSegment& a, const ImageSegment& b) { return a.address < b.address; });
+}
+
+void
+ImageSource::addSegment(uint32_t address, const uint8_t* data, uint32_t size)
+{
+    if (size == 0)
+        return;
+
+    if ((uint64_t) address + size > 0x100000000ULL)
+        throw ImageFormatError("Image has data beyond the 4GB address space");
+
+    // Runs that follow on in both the address space and memory are joined
+    if (!_segments.empty())
+    {
+        ImageSegment& last = _segments.back();
+
+        if (last.address + last.size == address && last.data + last.size == data)
+        {
+            last.size += size;
+            return;
+        }
+    }
+
+    _segments.push_back(ImageSegment(address, data, size));
+}
+
+// Decode Intel HEX records.  A binary that only happens to start with a
+// colon fails on the first record and is left as it is.
+bool
+ImageSource::parseHex()
+{
+    const uint8_t* pos = _data;
+    const uint8_t* end = _data + _size;
+    uint8_t record[5 + 255];
+    uint32_t base = 0;
+    bool done = false;
+
+    // Each data byte takes two characters so the decoded data never
+    // outgrows this and the segments can point straight into it
+    _decoded.reserve(_size / 2);
+
+    while (pos < end && !done)
+    {
+        uint32_t length;
+        uint8_t sum = 0;
+
+        // Skip the line ending and any blank lines
+        if (*pos == '\r' || *pos == '\n' || *pos == ' ' || *pos == '\t')
+        {
+            pos++;
+            continue;
+        }
+
+        if (*pos != ':' || end - pos < 11)
+            break;
+
+        for (length = 0; length < 5 || length < 5u + record[0]; length++)
+        {
+            int high = pos + 2 + length * 2 < end ? hexDigit(pos[1 + length * 2]) : -1;
+            int low = high >= 0 ? hexDigit(pos[2 + length * 2]) : -1;
+
+            if (low < 0)
+                break;
+            record[length] = (high << 4) | low;
+            sum += record[length];
+        }
+        if (length < 5 || length != 5u + record[0] || sum != 0)
+            break;
+        // Extended addresses always carry two bytes
+        if ((record[3] == 0x02 || record[3] == 0x04) && record[0] != 2)
+            break;
+        pos += 1 + length * 2;
+
+        uint32_t address = (record[1] << 8) | record[2];
+        switch (record[3])
+        {
+        case 0x00:
+            addSegment(base + address, (const uint8_t*) _decoded.data() + _decoded.size(), record[0]);
+            _decoded.append((const char*) &record[4], record[0]);
+            break;
+        case 0x01:
+            done = true;
+            break;
+        case 0x02:
+            base = ((record[4] << 8) | record[5]) << 4;
+            break;
+        case 0x04:
+            base = ((record[4] << 8) | record[5]) << 16;
+            break;
+        default:
+            // Start addresses do not matter to the flash
+            break;
+        }
+    }
+
+    if (done)
+        return true;
+
+    // Only a file that went wrong after its first record is taken as a
+    // broken HEX file rather than a binary
+    if (pos == _data)
+    {
+        _segments.clear();
+        _decoded.clear();
+        return false;
+    }
+
+    throw ImageFormatError("Intel HEX file is corrupt or has no end record");
+}
+
+// Load the program headers of a 32-bit little endian ELF file.  The data
+// goes at the physical address, which is where it is loaded from.
+void
+ImageSource::parseElf()
+{
+    uint32_t phoff;
+    uint16_t phentsize;
+    uint16_t phnum;
+
+    if (_data[4] != 1 || _data[5] != 1)
+        throw ImageFormatError("Only 32-bit little endian ELF files are supported");
+
+    phoff = le32(_data + 28);
+    phentsize = le16(_data + 42);
+    phnum = le16(_data + 44);
+
+    if (phentsize < 32 || (uint64_t) phoff + (uint64_t) phentsize * phnum > _size)
+        throw ImageFormatError("ELF program headers are corrupt");
+
+    for (uint32_t header = 0; header < phnum; header++)
+    {
+        const uint8_t* ph = _data + phoff + header * phentsize;
+        uint32_t offset = le32(ph + 4);
+        uint32_t paddr = le32(ph + 12);
+        uint32_t filesz = le32(ph + 16);
+
+        if (le32(ph) != ELF_PT_LOAD || filesz == 0)
+            continue;
+
+        if ((uint64_t) offset + filesz > _size)
+            throw ImageFormatError("ELF segment lies outside the file");
+
+        addSegment(paddr, _data + offset, filesz);
+    }
+
+    if (_segments.empty())
+        throw ImageFormatError("ELF file has nothing to load");
+}
+
+// Take the payload of each UF2 block meant for the main flash
+void
+ImageSource::parseUf2()
+{
+    for (uint32_t offset = 0; offset + UF2_BLOCK_SIZE <= _size; offset += UF2_BLOCK_SIZE)
+    {
+        const uint8_t* block = _data + offset;
+        uint32_t flags = le32(block + 8);
+        uint32_t size = le32(block + 16);
+
+        if (le32(block) != UF2_MAGIC_START0 || le32(block + 4) != UF2_MAGIC_START1 ||
+            le32(block + UF2_BLOCK_SIZE - 4) != UF2_MAGIC_END || size > UF2_MAX_PAYLOAD)
+            throw ImageFormatError("UF2 file has a corrupt block");
+
+        if (!(flags & UF2_NOT_MAIN_FLASH))
+            addSegment(le32(block + 12), block + UF2_PAYLOAD, size);
+    }
+}
+
+uint32_t
+ImageSource::segmentBytes()
+{
+    uint32_t bytes = 0;
+
+    for (uint32_t segment = 0; segment < _segments.size(); segment++)
+        bytes += _segments[segment].size;
+
+    return bytes;
+}
+
+std::vector<ImageExtent>
+ImageSource::extents(uint32_t base, uint32_t foffset, uint32_t pageSize, uint32_t unitSize)
+{
+    if (_format == Binary)
+    {
+        std::vector<ImageExtent> extents;
+
+        if (_size > 0)
+            extents.push_back(ImageExtent(foffset, _data, _size, &checksum(pageSize)));
+        return extents;
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    Layout& layout = _layouts[std::make_tuple(base, pageSize, unitSize)];
+
+    if (layout.extents.empty())
+        buildLayout(layout, base, pageSize, unitSize);
+
+    return layout.extents;
+}
+
+void
+ImageSource::buildLayout(Layout& layout, uint32_t base, uint32_t pageSize, uint32_t unitSize)
+{
+    std::vector<ImageSegment> placed;
+    uint32_t first = 0;
+
+    // Relative segments only get their address once the flash is known
+    for (uint32_t segment = 0; segment < _segments.size(); segment++)
+    {
+        ImageSegment place = _segments[segment];
+
+        if (place.relative)
+        {
+            if ((uint64_t) base + place.address + place.size > 0x100000000ULL)
+                throw ImageFormatError("Image has data beyond the 4GB address space");
+            place.address += base;
+            place.relative = false;
+        }
+        placed.push_back(place);
+    }
+
+    std::sort(placed.begin(), placed.end(),
+              [](const ImageSegment& a, const ImageSegment& b) { return a.address < b.address; });
+
+    for (uint32_t segment = 1; segment < placed.size(); segment++)
+    {
+        if ((uint64_t) placed[segment - 1].address + placed[segment - 1].size > placed[segment].address)
+            throw ImageFormatError("Image has overlapping data");
+    }
+
+    if (!placed.empty() && placed[0].address < base)
+        throw ImageFormatError("Image has data below the start of flash");
+
+    // Gather the segments that share erase units and fill the gaps between
+    // them as erased flash
+    while (first < placed.size())
+    {
+        uint64_t start = (placed[first].address - base) / unitSize * unitSize;
+        uint64_t end = start;
+        uint32_t last = first;
+
+        do
+        {
+            uint64_t segmentEnd = (uint64_t) placed[last].address - base + placed[last].size;
+            end = std::max(end, (segmentEnd + unitSize - 1) / unitSize * unitSize);
+            last++;
+        }
+        while (last < placed.size() && placed[last].address - base <= end);
+
+        layout.buffers.push_back(std::string(end - start, '\xff'));
+        std::string& buffer = layout.buffers.back();
+        for (uint32_t segment = first; segment < last; segment++)
+        {
+            memcpy(&buffer[placed[segment].address - base - start], placed[segment].data,
+                   placed[segment].size);
+        }
+
+        layout.checksums.push_back(FlasherChecksum((const uint8_t*) buffer.data(), buffer.size(), pageSize));
+        layout.extents.push_back(ImageExtent(start, (const uint8_t*) buffer.data(), buffer.size(),
+                                             &layout.checksums.back()));
+        first = last;
+    }
+}
+
+// The modification time in nanoseconds where the platform has them
+static uint64_t
+modified(const struct stat& st)
+{
+#if defined(__linux__)
+    return st.st_mtim.tv_sec * 1000000000ULL + st.st_mtim.tv_nsec;
+#elif defined(__APPLE__)
+    return st.st_mtimespec.tv_sec * 1000000000ULL + st.st_mtimespec.tv_nsec;
+#else
+    return st.st_mtime * 1000000000ULL;
+#endif
+}
+
+ImageFuture
+loadImage(const std::string& path)
+{
+    return std::async(std::launch::async, [path]()
+    {
+        return std::make_shared<ImageSource>(path.c_str());
+    }).share();
+}
+
+ImageFuture
+readyImage(std::shared_ptr<ImageSource> image)
+{
+    std::promise<std::shared_ptr<ImageSource>> promise;
+
+    promise.set_value(image);
+    return promise.get_future().share();
+}
+
+ImageStream::ImageStream(int fd, uint32_t chunkSize, uint32_t depth) :
+    _fd(fd), _chunkSize(chunkSize), _depth(depth), _done(false), _stop(false), _errnum(0), _total(0)
+{
+    _thread = std::thread(&ImageStream::reader, this);
+}
+
+ImageStream::~ImageStream()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    _space.notify_all();
+    _thread.join();
+}
+
+void
+ImageStream::reader()
+{
+    std::string chunk;
+    int errnum = 0;
+
+    while (true)
+    {
+        ssize_t got;
+
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+
+            _space.wait(lock, [this]() { return _stop || _chunks.size() < _depth; });
+            if (_stop)
+                return;
+        }
+
+#if !defined(__WIN32__)
+        // Wake up now and then to see if the stream is still wanted
+        struct pollfd pfd = { _fd, POLLIN, 0 };
+
+        if (poll(&pfd, 1, 100) == 0)
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (_stop)
+                return;
+            continue;
+        }
+#endif
+
+        chunk.resize(_chunkSize);
+        got = 0;
+        while ((uint32_t) got < _chunkSize)
+        {
+            ssize_t part = ::read(_fd, &chunk[got], _chunkSize - got);
+
+            if (part < 0 && errno == EINTR)
+                continue;
+            if (part <= 0)
+            {
+                errnum = part < 0 ? errno : 0;
+                break;
+            }
+            got += part;
+        }
+        chunk.resize(got);
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_total + got > 0xffffffffULL)
+            errnum = EFBIG;
+        _total += got;
+        if (got > 0 && errnum == 0)
+            _chunks.push_back(chunk);
+        if ((uint32_t) got < _chunkSize || errnum != 0)
+        {
+            _errnum = errnum;
+            _done = true;
+        }
+        _ready.notify_one();
+        if (_done)
+            return;
+    }
+}
+
+bool
+ImageStream::next(std::string& chunk)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    _ready.wait(lock, [this]() { return _done || !_chunks.empty(); });
+
+    if (_chunks.empty())
+    {
+        if (_errnum == EFBIG)
+            throw FileSizeError();
+        if (_errnum != 0)
+            throw FileIoError(_errnum);
+        return false;
+    }
+
+    chunk.swap(_chunks.front());
+    _chunks.pop_front();
+    _space.notify_one();
+
+    return true;
+}
+
+std::shared_ptr<ImageSource>
+ImageCache::get(const std::string& path)
+{
+    bool hit;
+
+    return get(path, hit);
+}
+
+std::shared_ptr<ImageSource>
+ImageCache::get(const std::string& path, bool& hit)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    struct stat st;
+    std::map<std::string, Entry>::iterator it;
+
+    // Only regular files can be checked for changes
+    bool cacheable = (stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode));
+
+    it = _entries.find(path);
+    if (it != _entries.end())
+    {
+        Entry& entry = it->second;
+
+        if (cacheable && entry.dev == (uint64_t) st.st_dev && entry.ino == (uint64_t) st.st_ino &&
+            entry.size == (uint64_t) st.st_size && entry.mtime == modified(st))
+        {
+            hit = true;
+            entry.used = ++_uses;
+            return entry.image;
+        }
+        _entries.erase(it);
+    }
+
+    // Cached images are read rather than mapped.  A mapping would follow
+    // the file if it is rewritten in place while a job is using it, and
+    // fault if it is truncated.
+    hit = false;
+    std::shared_ptr<ImageSource> image(new ImageSource(path.c_str(), true));
+    if (!cacheable)
+        return image;
+
+    // Nor is a file that changed while it was being read
+    struct stat after;
+    if (stat(path.c_str(), &after) != 0 || after.st_dev != st.st_dev || after.st_ino != st.st_ino ||
+        after.st_size != st.st_size || modified(after) != modified(st))
+        return image;
+
+    while (!_entries.empty() && _entries.size() >= _capacity)
+    {
+        std::map<std::string, Entry>::iterator oldest = _entries.begin();
+
+        for (it = _entries.begin(); it != _entries.end(); it++)
+        {
+            if (it->second.used < oldest->second.used)
+                oldest = it;
+        }
+        _entries.erase(oldest);
+    }
+
+    Entry& entry = _entries[path];
+    entry.image = image;
+    entry.dev = st.st_dev;
+    entry.ino = st.st_ino;
+    entry.size = st.st_size;
+    entry.mtime = modified(st);
+    entry.used = ++_uses;
+
+    return image;
+}
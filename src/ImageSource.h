@@ -0,0 +1,272 @@
+///////////////////////////////////////////////////////////////////////////////
+// BOSSA
+//
+// Copyright (c) 2011-2018, ShumaTech
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the <organization> nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+#ifndef _IMAGESOURCE_H
+#define _IMAGESOURCE_H
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+#include <list>
+#include <deque>
+#include <map>
+#include <tuple>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <memory>
+#include <future>
+#include <exception>
+
+class FlasherChecksum;
+
+class ImageFormatError : public std::exception
+{
+public:
+    ImageFormatError(const char* reason) : std::exception(), _reason(reason) {}
+    virtual const char* what() const throw() { return _reason; }
+
+private:
+    const char* _reason;
+};
+
+// A run of bytes that an image puts at an address, or at an offset from
+// the start of flash when it is relative
+class ImageSegment
+{
+public:
+    ImageSegment(uint32_t address, const uint8_t* data, uint32_t size, bool relative = false) :
+        address(address), data(data), size(size), relative(relative) {}
+
+    uint32_t address;
+    const uint8_t* data;
+    uint32_t size;
+    bool relative;
+};
+
+// A piece of an image as it goes into flash, at an offset from the start
+// of the flash and with the page CRCs of its data
+class ImageExtent
+{
+public:
+    ImageExtent(uint32_t offset, const uint8_t* data, uint32_t size, const FlasherChecksum* checksum) :
+        offset(offset), data(data), size(size), checksum(checksum) {}
+
+    uint32_t offset;
+    const uint8_t* data;
+    uint32_t size;
+    const FlasherChecksum* checksum;
+};
+
+// Bytes laid over an image at an offset from the start of flash, such as
+// the serial number and keys of one unit
+class ImagePatch
+{
+public:
+    ImagePatch(uint32_t offset, const std::string& data) : offset(offset), data(data) {}
+
+    uint32_t offset;
+    std::string data;
+};
+
+class ImageSource;
+
+// An image to be combined with others, with a binary going at the offset
+// from the start of flash
+class ImagePart
+{
+public:
+    ImagePart(std::shared_ptr<ImageSource> image, uint32_t offset) : image(image), offset(offset) {}
+
+    std::shared_ptr<ImageSource> image;
+    uint32_t offset;
+};
+
+// A file to program, mapped into memory once and read by any number of
+// flashers at the same time.  Pipes and anything else that cannot be
+// mapped are read in full instead, as are snapshots that must not change
+// if the file does.
+//
+// Intel HEX, ELF and UF2 files are recognised by their contents and carry
+// the addresses of their data.  Anything else is a raw binary that goes
+// wherever it is told to.
+class ImageSource
+{
+public:
+    ImageSource(const char* filename, bool snapshot = false);
+    virtual ~ImageSource();
+
+    // Several images written as one, keeping the parts alive
+    ImageSource(const std::string& name, const std::vector<ImagePart>& parts);
+
+    enum Format
+    {
+        Binary,
+        IntelHex,
+        Elf,
+        Uf2,
+        Composite,
+    };
+
+    const std::string& name() { return _name; }
+    const uint8_t* data() { return _data; }
+    uint32_t size() { return _size; }
+
+    Format format() { return _format; }
+    const char* formatName();
+    bool addressed() { return _format != Binary; }
+
+    // The data of an addressed image in address order
+    const std::vector<ImageSegment>& segments() { return _segments; }
+    uint32_t segmentBytes();
+
+    // The image laid out for a flash at the base address.  A binary is one
+    // extent at the offset.  The segments of an addressed image are merged
+    // into extents covering whole erase units, with 0xff wherever the image
+    // has no data.
+    std::vector<ImageExtent> extents(uint32_t base, uint32_t foffset, uint32_t pageSize, uint32_t unitSize);
+
+    // Page CRCs are worked out the first time a page size is asked for and
+    // then shared by every flasher using the image
+    FlasherChecksum& checksum(uint32_t pageSize);
+
+private:
+    std::string _name;
+    const uint8_t* _data;
+    uint32_t _size;
+    bool _mapped;
+    std::string _contents;
+    std::mutex _mutex;
+    std::map<uint32_t, std::shared_ptr<FlasherChecksum>> _checksums;
+    Format _format;
+    std::string _decoded;
+    std::vector<ImageSegment> _segments;
+    std::vector<std::shared_ptr<ImageSource>> _parts;
+
+    struct Layout
+    {
+        std::vector<ImageExtent> extents;
+        std::list<std::string> buffers;
+        std::list<FlasherChecksum> checksums;
+    };
+    std::map<std::tuple<uint32_t, uint32_t, uint32_t>, Layout> _layouts;
+
+    void load(const char* filename, bool snapshot);
+    void readAll(int fd);
+    void parse();
+    bool parseHex();
+    void parseElf();
+    void parseUf2();
+    void addSegment(uint32_t address, const uint8_t* data, uint32_t size);
+    void buildLayout(Layout& layout, uint32_t base, uint32_t pageSize, uint32_t unitSize);
+
+    ImageSource(const ImageSource&);
+    ImageSource& operator=(const ImageSource&);
+};
+
+// An image that may still be loading on a thread of its own
+typedef std::shared_future<std::shared_ptr<ImageSource>> ImageFuture;
+
+// Start loading an image so that the file is read and parsed while the
+// device is connected.  Any error is thrown once the image is waited for.
+ImageFuture loadImage(const std::string& path);
+
+// An image that is already loaded, or none at all
+ImageFuture readyImage(std::shared_ptr<ImageSource> image);
+
+// A stream that cannot be held whole, such as stdin, read a chunk at a time
+// on a thread of its own so that reading overlaps programming.  At most
+// depth chunks are buffered before the reader waits for them to be taken.
+class ImageStream
+{
+public:
+    ImageStream(int fd, uint32_t chunkSize, uint32_t depth = DefaultDepth);
+    virtual ~ImageStream();
+
+    // Wait for the next chunk, which is only short at the end of the
+    // stream, and return false once the stream is done
+    bool next(std::string& chunk);
+
+    static const uint32_t DefaultDepth = 4;
+
+private:
+    int _fd;
+    uint32_t _chunkSize;
+    uint32_t _depth;
+    std::deque<std::string> _chunks;
+    std::mutex _mutex;
+    std::condition_variable _ready;
+    std::condition_variable _space;
+    bool _done;
+    bool _stop;
+    int _errnum;
+    uint64_t _total;
+    std::thread _thread;
+
+    void reader();
+
+    ImageStream(const ImageStream&);
+    ImageStream& operator=(const ImageStream&);
+};
+
+// Keeps snapshots of recently used images, along with their checksums, for
+// as long as the file on disk is unchanged
+class ImageCache
+{
+public:
+    ImageCache(uint32_t capacity = DefaultCapacity) : _capacity(capacity), _uses(0) {}
+    virtual ~ImageCache() {}
+
+    // Anything still using an image that is dropped keeps it alive
+    std::shared_ptr<ImageSource> get(const std::string& path, bool& hit);
+    std::shared_ptr<ImageSource> get(const std::string& path);
+
+    static const uint32_t DefaultCapacity = 8;
+
+private:
+    struct Entry
+    {
+        std::shared_ptr<ImageSource> image;
+        uint64_t dev;
+        uint64_t ino;
+        uint64_t size;
+        uint64_t mtime;
+        uint64_t used;
+    };
+
+    uint32_t _capacity;
+    uint64_t _uses;
+    std::mutex _mutex;
+    std::map<std::string, Entry> _entries;
+
+    ImageCache(const ImageCache&);
+    ImageCache& operator=(const ImageCache&);
+};
+
+#endif // _IMAGESOURCE_H
@@ -0,0 +1,128 @@
+///////////////////////////////////////////////////////////////////////////////
+// BOSSA
+//
+// Copyright (c) 2011-2018, ShumaTech
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the <organization> nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+#include "Journal.h"
+#include "Checksum.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#if defined(__WIN32__)
+#include <direct.h>
+#define mkdir(path, mode) _mkdir(path)
+#endif
+
+Journal::Journal(const std::string& port,
+                 ImageSource& image,
+                 uint32_t foffset,
+                 const std::vector<uint32_t>& uniqueId) :
+    _completed(0)
+{
+    char text[32];
+    const char* home;
+
+    // The image is already in memory, so its CRC costs next to nothing
+    snprintf(text, sizeof(text), "%08x %x %x", ~Checksum::crc32(image.data(), image.size()), image.size(),
+             foffset);
+    _key = text;
+
+    home = getenv("HOME");
+    if (!home)
+        home = getenv("USERPROFILE");
+    _path = home ? std::string(home) + "/.bossac-journal" : std::string(".bossac-journal");
+    mkdir(_path.c_str(), 0755);
+
+    // Keep the port name to characters that are safe in a file name
+    _path += "/";
+    for (size_t pos = port.find_first_not_of("/\\.:"); pos < port.size(); pos++)
+        _path += isalnum((unsigned char) port[pos]) || port[pos] == '.' || port[pos] == '-' ? port[pos] : '_';
+    _path += "-";
+    for (uint32_t word = 0; word < uniqueId.size(); word++)
+    {
+        snprintf(text, sizeof(text), "%08x", uniqueId[word]);
+        _path += text;
+    }
+
+    load();
+}
+
+void
+Journal::load()
+{
+    FILE* file;
+    char line[256];
+    unsigned long completed;
+
+    file = fopen(_path.c_str(), "r");
+    if (!file)
+        return;
+
+    if (fgets(line, sizeof(line), file) &&
+        _key == std::string(line, strcspn(line, "\n")) &&
+        fscanf(file, "%lu", &completed) == 1)
+        _completed = completed;
+
+    fclose(file);
+}
+
+void
+Journal::update(uint32_t completed)
+{
+    char suffix[32];
+    FILE* file;
+
+    _completed = completed;
+
+    snprintf(suffix, sizeof(suffix), ".%d.tmp", (int) getpid());
+    std::string temp = _path + suffix;
+
+    // Write a new copy and rename it over the old one so that an
+    // interruption never leaves a partial journal behind
+    file = fopen(temp.c_str(), "w");
+    if (!file)
+        return;
+
+    fprintf(file, "%s\n%u\n", _key.c_str(), _completed);
+    if (fclose(file) != 0)
+        return;
+
+    remove(_path.c_str());
+    rename(temp.c_str(), _path.c_str());
+}
+
+void
+Journal::finish()
+{
+    _completed = 0;
+    remove(_path.c_str());
+}
@@ -31,27 +31,50 @@
 
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <sys/types.h>
+#include <dirent.h>
 
 #include <string>
+#include <algorithm>
 
-LinuxPortFactory::LinuxPortFactory()
+#define SYSFS_TTY   "/sys/class/tty/"
+
+// USB vendors that ship SAM-BA or Arduino style bootloaders.  By their
+// convention a bootloader has bit 15 of the product id clear and the
+// sketch that it loads has it set.
+static const uint16_t BootloaderVendors[] =
+{
+    0x03eb,     // Atmel/Microchip
+    0x2341,     // Arduino
+    0x2a03,     // Arduino.org
+    0x239a,     // Adafruit
+    0x1b4f,     // SparkFun
+    0x2886,     // Seeed
+};
+
+static const uint16_t SambaVid = 0x03eb;
+static const uint16_t SambaPid = 0x6124;
+
+LinuxPortFactory::LinuxPortFactory() : _next(0), _legacy(false)
 {
-    _dir = opendir("/dev");
 }
 
 LinuxPortFactory::~LinuxPortFactory()
 {
-    if (_dir)
-        closedir(_dir);
 }
 
 SerialPort::Ptr
 LinuxPortFactory::create(const std::string& name)
 {
+    LinuxPortInfo port;
     bool isUsb = false;
 
-    if (name.find("ttyUSB") != std::string::npos ||
-        name.find("ttyACM") != std::string::npos)
+    if (info(name, port))
+        isUsb = port.isUsb;
+    else if (name.find("ttyUSB") != std::string::npos ||
+             name.find("ttyACM") != std::string::npos)
         isUsb = true;
 
     return create(name, isUsb);
@@ -63,36 +86,156 @@ LinuxPortFactory::create(const std::string& name, bool isUsb)
     return SerialPort::Ptr(new PosixSerialPort(name, isUsb));
 }
 
-std::string
-LinuxPortFactory::begin()
+bool
+LinuxPortFactory::readAttr(const std::string& path, std::string& value)
 {
-    if (!_dir)
-        return end();
+    char buffer[128];
+    FILE* file = fopen(path.c_str(), "r");
 
-    rewinddir(_dir);
+    if (!file)
+        return false;
 
-    return next();
+    if (!fgets(buffer, sizeof(buffer), file))
+        buffer[0] = '\0';
+    fclose(file);
+
+    value = buffer;
+    while (!value.empty() && (value[value.size() - 1] == '\n' || value[value.size() - 1] == ' '))
+        value.erase(value.size() - 1);
+
+    return true;
 }
 
-std::string
-LinuxPortFactory::next()
+int
+LinuxPortFactory::rank(uint16_t vid, uint16_t pid)
+{
+    if (vid == SambaVid && pid == SambaPid)
+        return 4;
+
+    for (uint32_t vendor = 0; vendor < sizeof(BootloaderVendors) / sizeof(BootloaderVendors[0]); vendor++)
+    {
+        if (vid == BootloaderVendors[vendor])
+            return (pid & 0x8000) ? 2 : 3;
+    }
+
+    return 1;
+}
+
+bool
+LinuxPortFactory::info(const std::string& name, LinuxPortInfo& info)
 {
+    std::string base = name.substr(name.rfind('/') + 1);
+    char device[PATH_MAX];
+    std::string path;
+    std::string value;
+
+    // Ports without a device, such as ptys and consoles, are not serial ports
+    if (!realpath((SYSFS_TTY + base + "/device").c_str(), device))
+        return false;
+
+    info = LinuxPortInfo();
+    info.name = base;
+
+    // Walk up from the tty to the USB device, passing the interface on
+    // the way
+    path = device;
+    while (path.size() > strlen("/sys/devices"))
+    {
+        if (info.interface < 0 && readAttr(path + "/bInterfaceNumber", value))
+            info.interface = strtol(value.c_str(), NULL, 16);
+
+        if (readAttr(path + "/idVendor", value))
+        {
+            info.isUsb = true;
+            info.vid = strtol(value.c_str(), NULL, 16);
+            if (readAttr(path + "/idProduct", value))
+                info.pid = strtol(value.c_str(), NULL, 16);
+            readAttr(path + "/serial", info.serial);
+            info.rank = rank(info.vid, info.pid);
+            break;
+        }
+
+        path.erase(path.rfind('/'));
+    }
+
+    return true;
+}
+
+static bool
+betterPort(const LinuxPortInfo& a, const LinuxPortInfo& b)
+{
+    if (a.rank != b.rank)
+        return a.rank > b.rank;
+    if (a.name.size() != b.name.size())
+        return a.name.size() < b.name.size();
+    return a.name < b.name;
+}
+
+void
+LinuxPortFactory::scan()
+{
+    DIR* dir;
     struct dirent* entry;
+    LinuxPortInfo port;
 
-    if (!_dir)
-        return end();
+    _ports.clear();
+    _next = 0;
+
+    dir = opendir(SYSFS_TTY);
+    if (dir)
+    {
+        while ((entry = readdir(dir)))
+        {
+            if (entry->d_name[0] == '.' || !info(entry->d_name, port))
+                continue;
+
+            // Legacy ports are slow to fail when nothing is there
+            if (port.isUsb || _legacy)
+                _ports.push_back(port);
+        }
+        closedir(dir);
+    }
 
-    while ((entry = readdir(_dir)))
+    // Without sysfs fall back to guessing from the names in /dev
+    if (!dir && (dir = opendir("/dev")))
     {
-        if (strncmp("ttyUSB", entry->d_name, sizeof("ttyUSB") - 1) == 0)
-            return std::string(entry->d_name);
-        else if (strncmp("ttyACM", entry->d_name, sizeof("ttyACM") - 1) == 0)
-            return std::string(entry->d_name);
-        else if (strncmp("ttyS", entry->d_name, sizeof("ttyS") - 1) == 0)
-            return std::string(entry->d_name);
+        while ((entry = readdir(dir)))
+        {
+            port = LinuxPortInfo();
+            port.name = entry->d_name;
+            if (strncmp("ttyUSB", entry->d_name, sizeof("ttyUSB") - 1) == 0 ||
+                strncmp("ttyACM", entry->d_name, sizeof("ttyACM") - 1) == 0)
+            {
+                port.isUsb = true;
+                port.rank = 1;
+                _ports.push_back(port);
+            }
+            else if (strncmp("ttyS", entry->d_name, sizeof("ttyS") - 1) == 0 && _legacy)
+            {
+                _ports.push_back(port);
+            }
+        }
+        closedir(dir);
     }
 
-    return end();
+    std::sort(_ports.begin(), _ports.end(), betterPort);
+}
+
+std::string
+LinuxPortFactory::begin()
+{
+    scan();
+
+    return next();
+}
+
+std::string
+LinuxPortFactory::next()
+{
+    if (_next >= _ports.size())
+        return end();
+
+    return _ports[_next++].name;
 }
 
 std::string
@@ -104,6 +247,10 @@ LinuxPortFactory::end()
 std::string
 LinuxPortFactory::def()
 {
-    return std::string("/dev/ttyACM0");
-}
+    scan();
+
+    if (_ports.empty())
+        return std::string("/dev/ttyACM0");
 
+    return std::string("/dev/") + _ports[0].name;
+}
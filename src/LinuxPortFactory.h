@@ -32,11 +32,25 @@
 class LinuxPortFactory;
 #include "PortFactory.h"
 
-#include <sys/types.h>
-#include <dirent.h>
+#include <stdint.h>
 
 #include <string>
+#include <vector>
 
+// What sysfs knows about a serial port
+class LinuxPortInfo
+{
+public:
+    LinuxPortInfo() : isUsb(false), vid(0), pid(0), interface(-1), rank(0) {}
+
+    std::string name;
+    bool isUsb;
+    uint16_t vid;
+    uint16_t pid;
+    std::string serial;
+    int interface;
+    int rank;
+};
 
 class LinuxPortFactory : public PortFactoryBase
 {
@@ -44,6 +58,7 @@ public:
     LinuxPortFactory();
     virtual ~LinuxPortFactory();
 
+    // Ports are listed best first, with known bootloaders at the top
     virtual std::string begin();
     virtual std::string end();
     virtual std::string next();
@@ -52,9 +67,19 @@ public:
     virtual SerialPort::Ptr create(const std::string& name);
     virtual SerialPort::Ptr create(const std::string& name, bool isUsb);
 
+    // List serial ports that are not on USB as well
+    void setLegacy(bool legacy) { _legacy = legacy; }
+
+    bool info(const std::string& name, LinuxPortInfo& info);
+
 private:
-    std::string _empty;
-    DIR* _dir;
+    std::vector<LinuxPortInfo> _ports;
+    uint32_t _next;
+    bool _legacy;
+
+    void scan();
+    static bool readAttr(const std::string& path, std::string& value);
+    static int rank(uint16_t vid, uint16_t pid);
 };
 
 #endif // _LINUXPORTFACTORY_H
@@ -0,0 +1,71 @@
+///////////////////////////////////////////////////////////////////////////////
+// BOSSA
+//
+// Copyright (c) 2011-2018, ShumaTech
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the <organization> nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+#include "Lz4Applet.h"
+
+Lz4Applet::Lz4Applet(Samba& samba, uint32_t addr)
+    : Applet(samba,
+             addr,
+             applet.code,
+             sizeof(applet.code),
+             addr + applet.start,
+             addr + applet.stack,
+             addr + applet.reset)
+{
+}
+
+Lz4Applet::~Lz4Applet()
+{
+}
+
+void
+Lz4Applet::setSrcAddr(uint32_t srcAddr)
+{
+    load();
+    _samba.writeWord(_addr + applet.src_addr, srcAddr);
+}
+
+void
+Lz4Applet::setSrcSize(uint32_t srcSize)
+{
+    load();
+    _samba.writeWord(_addr + applet.src_size, srcSize);
+}
+
+void
+Lz4Applet::setDstAddr(uint32_t dstAddr)
+{
+    load();
+    _samba.writeWord(_addr + applet.dst_addr, dstAddr);
+}
+
+uint32_t
+Lz4Applet::getDstSize()
+{
+    return _samba.readWord(_addr + applet.dst_size);
+}
@@ -0,0 +1,114 @@
+    .global start
+    .global stack
+    .global reset
+    .global src_addr
+    .global src_size
+    .global dst_addr
+    .global dst_size
+
+    .syntax unified
+    .text
+    .thumb
+    .align 2
+
+start:
+    @ Decode one LZ4 block from src_addr into dst_addr
+    push    {r4, r5, r6}
+    ldr     r0, src_addr
+    ldr     r1, src_size
+    adds    r1, r0
+    ldr     r2, dst_addr
+
+sequence:
+    @ Token holds the literal length in the high nibble
+    ldrb    r3, [r0]
+    adds    r0, #1
+    lsrs    r4, r3, #4
+    cmp     r4, #15
+    bne     literals
+
+literal_len:
+    ldrb    r6, [r0]
+    adds    r0, #1
+    adds    r4, r4, r6
+    cmp     r6, #255
+    beq     literal_len
+
+literals:
+    cmp     r4, #0
+    beq     offset
+
+literal_copy:
+    ldrb    r6, [r0]
+    adds    r0, #1
+    strb    r6, [r2]
+    adds    r2, #1
+    subs    r4, #1
+    bne     literal_copy
+
+offset:
+    @ The last sequence has no match
+    cmp     r0, r1
+    bhs     done
+    ldrb    r4, [r0]
+    ldrb    r6, [r0, #1]
+    adds    r0, #2
+    lsls    r6, r6, #8
+    orrs    r4, r6
+    subs    r5, r2, r4
+
+    @ Match length minus four is in the low nibble
+    movs    r4, #15
+    ands    r4, r3
+    cmp     r4, #15
+    bne     match
+
+match_len:
+    ldrb    r6, [r0]
+    adds    r0, #1
+    adds    r4, r4, r6
+    cmp     r6, #255
+    beq     match_len
+
+match:
+    adds    r4, #4
+
+match_copy:
+    ldrb    r6, [r5]
+    adds    r5, #1
+    strb    r6, [r2]
+    adds    r2, #1
+    subs    r4, #1
+    bne     match_copy
+    b       sequence
+
+done:
+    ldr     r3, dst_addr
+    subs    r2, r2, r3
+    adr     r0, dst_size
+    str     r2, [r0]
+    pop     {r4, r5, r6}
+
+    @ Fix for SAM-BA stack bug
+    ldr     r0, reset
+    cmp     r0, #0
+    bne     return
+    ldr     r0, stack
+    mov     sp, r0
+
+return:
+    bx      lr
+
+    .align  2
+stack:
+    .word   0
+reset:
+    .word   0
+src_addr:
+    .word   0
+src_size:
+    .word   0
+dst_addr:
+    .word   0
+dst_size:
+    .word   0
@@ -0,0 +1,32 @@
+// WARNING!!! DO NOT EDIT - FILE GENERATED BY APPLETGEN
+#include "Lz4Arm.h"
+#include "Lz4Applet.h"
+
+Lz4Arm Lz4Applet::applet = {
+// dst_addr
+0x00000088,
+// dst_size
+0x0000008c,
+// reset
+0x0000007c,
+// src_addr
+0x00000080,
+// src_size
+0x00000084,
+// stack
+0x00000078,
+// start
+0x00000000,
+// code
+{
+0x70, 0xb4, 0x1f, 0x48, 0x1f, 0x49, 0x09, 0x18, 0x1f, 0x4a, 0x03, 0x78, 0x01, 0x30, 0x1c, 0x09,
+0x0f, 0x2c, 0x04, 0xd1, 0x06, 0x78, 0x01, 0x30, 0xa4, 0x19, 0xff, 0x2e, 0xfa, 0xd0, 0x00, 0x2c,
+0x05, 0xd0, 0x06, 0x78, 0x01, 0x30, 0x16, 0x70, 0x01, 0x32, 0x01, 0x3c, 0xf9, 0xd1, 0x88, 0x42,
+0x16, 0xd2, 0x04, 0x78, 0x46, 0x78, 0x02, 0x30, 0x36, 0x02, 0x34, 0x43, 0x15, 0x1b, 0x0f, 0x24,
+0x1c, 0x40, 0x0f, 0x2c, 0x04, 0xd1, 0x06, 0x78, 0x01, 0x30, 0xa4, 0x19, 0xff, 0x2e, 0xfa, 0xd0,
+0x04, 0x34, 0x2e, 0x78, 0x01, 0x35, 0x16, 0x70, 0x01, 0x32, 0x01, 0x3c, 0xf9, 0xd1, 0xd4, 0xe7,
+0x09, 0x4b, 0xd2, 0x1a, 0x09, 0xa0, 0x02, 0x60, 0x70, 0xbc, 0x04, 0x48, 0x00, 0x28, 0x01, 0xd1,
+0x01, 0x48, 0x85, 0x46, 0x70, 0x47, 0xc0, 0x46, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+}
+};
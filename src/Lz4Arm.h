@@ -0,0 +1,19 @@
+// WARNING!!! DO NOT EDIT - FILE GENERATED BY APPLETGEN
+#ifndef _LZ4ARM_H
+#define _LZ4ARM_H
+
+#include <stdint.h>
+
+typedef struct
+{
+    uint32_t dst_addr;
+    uint32_t dst_size;
+    uint32_t reset;
+    uint32_t src_addr;
+    uint32_t src_size;
+    uint32_t stack;
+    uint32_t start;
+    uint8_t code[144];
+} Lz4Arm;
+
+#endif // _LZ4ARM_H
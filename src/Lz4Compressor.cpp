@@ -0,0 +1,175 @@
+///////////////////////////////////////////////////////////////////////////////
+// BOSSA
+//
+// Copyright (c) 2011-2018, ShumaTech
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the <organization> nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+#include "Lz4Compressor.h"
+
+#include <string.h>
+#include <algorithm>
+
+// The format requires the last five bytes to be literals and the last
+// match to start at least twelve bytes before the end of the block
+#define MIN_MATCH       4
+#define LAST_LITERALS   5
+#define MATCH_LIMIT     12
+#define MAX_OFFSET      65535
+
+static inline uint32_t
+read32(const uint8_t* data)
+{
+    uint32_t value;
+
+    memcpy(&value, data, sizeof(value));
+
+    return value;
+}
+
+Lz4Compressor::Lz4Compressor() : _table(1 << HashBits)
+{
+}
+
+void
+Lz4Compressor::putLength(std::vector<uint8_t>& block, uint32_t length)
+{
+    for (; length >= 255; length -= 255)
+        block.push_back(255);
+    block.push_back(length);
+}
+
+void
+Lz4Compressor::compress(const uint8_t* data, uint32_t size, std::vector<uint8_t>& block)
+{
+    uint32_t limit = size > MATCH_LIMIT ? size - MATCH_LIMIT : 0;
+    uint32_t anchor = 0;
+    uint32_t pos = 0;
+
+    block.clear();
+    block.reserve(size + size / 255 + 16);
+    std::fill(_table.begin(), _table.end(), -1);
+
+    while (pos < limit)
+    {
+        uint32_t seq = read32(&data[pos]);
+        uint32_t hash = (seq * 2654435761U) >> (32 - HashBits);
+        int32_t ref = _table[hash];
+
+        _table[hash] = pos;
+
+        if (ref < 0 || pos - ref > MAX_OFFSET || read32(&data[ref]) != seq)
+        {
+            pos++;
+            continue;
+        }
+
+        uint32_t length = MIN_MATCH;
+        while (pos + length < size - LAST_LITERALS && data[ref + length] == data[pos + length])
+            length++;
+
+        uint32_t literals = pos - anchor;
+        uint32_t offset = pos - ref;
+
+        block.push_back((literals < 15 ? literals : 15) << 4 |
+                        (length - MIN_MATCH < 15 ? length - MIN_MATCH : 15));
+        if (literals >= 15)
+            putLength(block, literals - 15);
+        block.insert(block.end(), &data[anchor], &data[pos]);
+        block.push_back(offset & 0xff);
+        block.push_back(offset >> 8);
+        if (length - MIN_MATCH >= 15)
+            putLength(block, length - MIN_MATCH - 15);
+
+        pos += length;
+        anchor = pos;
+    }
+
+    // The block ends with a sequence holding only literals
+    uint32_t literals = size - anchor;
+
+    block.push_back((literals < 15 ? literals : 15) << 4);
+    if (literals >= 15)
+        putLength(block, literals - 15);
+    block.insert(block.end(), &data[anchor], &data[size]);
+}
+
+static bool
+getLength(const uint8_t* block, uint32_t blockSize, uint32_t& in, uint32_t& length)
+{
+    uint8_t byte;
+
+    do
+    {
+        if (in >= blockSize)
+            return false;
+        byte = block[in++];
+        length += byte;
+    } while (byte == 255);
+
+    return true;
+}
+
+bool
+Lz4Compressor::decompress(const uint8_t* block, uint32_t blockSize, uint8_t* data, uint32_t size)
+{
+    uint32_t in = 0;
+    uint32_t out = 0;
+
+    while (in < blockSize)
+    {
+        uint8_t token = block[in++];
+        uint32_t literals = token >> 4;
+        uint32_t match = token & 0xf;
+        uint32_t offset;
+
+        if (literals == 15 && !getLength(block, blockSize, in, literals))
+            return false;
+        if (literals > blockSize - in || literals > size - out)
+            return false;
+        memcpy(data + out, block + in, literals);
+        in += literals;
+        out += literals;
+
+        // The last sequence has literals only
+        if (in == blockSize)
+            break;
+
+        if (blockSize - in < 2)
+            return false;
+        offset = block[in] | (block[in + 1] << 8);
+        in += 2;
+        if (match == 15 && !getLength(block, blockSize, in, match))
+            return false;
+        match += MIN_MATCH;
+        if (offset == 0 || offset > out || match > size - out)
+            return false;
+
+        // Matches may overlap what they copy, so go a byte at a time
+        for (uint32_t i = 0; i < match; i++, out++)
+            data[out] = data[out - offset];
+    }
+
+    return out == size;
+}
@@ -0,0 +1,56 @@
+///////////////////////////////////////////////////////////////////////////////
+// BOSSA
+//
+// Copyright (c) 2011-2018, ShumaTech
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the <organization> nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+#ifndef _LZ4COMPRESSOR_H
+#define _LZ4COMPRESSOR_H
+
+#include <stdint.h>
+#include <vector>
+
+// Greedy compressor producing raw LZ4 blocks for the Lz4Applet decoder
+class Lz4Compressor
+{
+public:
+    Lz4Compressor();
+    virtual ~Lz4Compressor() {}
+
+    void compress(const uint8_t* data, uint32_t size, std::vector<uint8_t>& block);
+
+    // Decode a block on the host as the applet would, returning false
+    // unless it decodes to exactly size bytes without overrunning either
+    static bool decompress(const uint8_t* block, uint32_t blockSize, uint8_t* data, uint32_t size);
+
+private:
+    static const int HashBits = 12;
+
+    std::vector<int32_t> _table;
+
+    void putLength(std::vector<uint8_t>& block, uint32_t length);
+};
+
+#endif // _LZ4COMPRESSOR_H
@@ -0,0 +1,235 @@
+///////////////////////////////////////////////////////////////////////////////
+// BOSSA
+//
+// Copyright (c) 2011-2018, ShumaTech
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the <organization> nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+#include "Manifest.h"
+#include "FileError.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <fstream>
+#include <sstream>
+
+Manifest::Manifest(const char* filename, ImageCache* cache) :
+    _filename(filename)
+{
+    parse(cache);
+}
+
+void
+Manifest::error(uint32_t line, const char* reason)
+{
+    char text[32];
+
+    snprintf(text, sizeof(text), ":%u: ", line);
+    throw ManifestError(_filename + text + reason);
+}
+
+bool
+Manifest::parseBool(const std::string& arg, int& value)
+{
+    if (arg.empty() || arg == "1")
+        value = 1;
+    else if (arg == "0")
+        value = 0;
+    else
+        return false;
+
+    return true;
+}
+
+void
+Manifest::parse(ImageCache* cache)
+{
+    std::ifstream file(_filename.c_str());
+    std::vector<ImagePart> parts;
+    std::string dir;
+    std::string text;
+    uint32_t line = 0;
+    size_t slash;
+
+    if (!file)
+        throw FileOpenError(errno);
+
+    // Images are found next to the manifest unless their path is absolute
+    slash = _filename.find_last_of("/\\");
+    if (slash != std::string::npos)
+        dir = _filename.substr(0, slash + 1);
+
+    while (std::getline(file, text))
+    {
+        std::string keyword;
+        std::string arg;
+        std::string extra;
+
+        line++;
+        text = text.substr(0, text.find('#'));
+
+        std::istringstream words(text);
+        if (!(words >> keyword))
+            continue;
+        words >> arg;
+        if (keyword == "image")
+            words >> extra;
+        if (words >> text)
+            error(line, "too many arguments");
+
+        if (keyword == "image")
+        {
+            std::shared_ptr<ImageSource> image;
+            std::string path;
+            uint32_t offset = 0;
+
+            if (arg.empty())
+                error(line, "image needs a file");
+
+            path = (arg[0] == '/' || arg[0] == '\\' || dir.empty()) ? arg : dir + arg;
+#if defined(__WIN32__)
+            if (arg.size() > 1 && arg[1] == ':')
+                path = arg;
+#endif
+
+            if (!extra.empty())
+            {
+                char* end;
+
+                errno = 0;
+                offset = strtoul(extra.c_str(), &end, 0);
+                if (errno || *end)
+                    error(line, "invalid image offset");
+            }
+
+            try
+            {
+                image = cache ? cache->get(path) : std::make_shared<ImageSource>(path.c_str());
+            }
+            catch (std::exception& e)
+            {
+                error(line, (path + ": " + e.what()).c_str());
+            }
+
+            if (image->addressed() && !extra.empty())
+                error(line, "an addressed image cannot take an offset");
+
+            parts.push_back(ImagePart(image, offset));
+            continue;
+        }
+
+        if (keyword == "erase" || keyword == "verify" || keyword == "security" || keyword == "reset")
+        {
+            if (!arg.empty())
+                error(line, "too many arguments");
+
+            if (keyword == "erase")
+                _config.erase = true;
+            else if (keyword == "verify")
+                _config.verify = true;
+            else if (keyword == "security")
+                _config.security = true;
+            else
+                _config.reset = true;
+        }
+        else if (keyword == "boot")
+        {
+            _config.boot = true;
+            if (!parseBool(arg, _config.bootArg))
+                error(line, "boot takes 0 or 1");
+        }
+        else if (keyword == "bod")
+        {
+            _config.bod = true;
+            if (!parseBool(arg, _config.bodArg))
+                error(line, "bod takes 0 or 1");
+        }
+        else if (keyword == "bor")
+        {
+            _config.bor = true;
+            if (!parseBool(arg, _config.borArg))
+                error(line, "bor takes 0 or 1");
+        }
+        else if (keyword == "lock")
+        {
+            _config.lock = true;
+            _config.lockArg = arg;
+        }
+        else if (keyword == "unlock")
+        {
+            _config.unlock = true;
+            _config.unlockArg = arg;
+        }
+        else
+        {
+            error(line, ("unknown keyword " + keyword).c_str());
+        }
+    }
+
+    if (file.bad())
+        throw FileIoError(errno);
+
+    if (parts.empty())
+        error(line, "no images listed");
+
+    _image = std::make_shared<ImageSource>(_filename, parts);
+}
+
+void
+Manifest::apply(BossaConfig& config)
+{
+    config.write = true;
+    config.erase |= _config.erase;
+    config.verify |= _config.verify;
+    config.security |= _config.security;
+    config.reset |= _config.reset;
+
+    if (_config.boot)
+    {
+        config.boot = true;
+        config.bootArg = _config.bootArg;
+    }
+    if (_config.bod)
+    {
+        config.bod = true;
+        config.bodArg = _config.bodArg;
+    }
+    if (_config.bor)
+    {
+        config.bor = true;
+        config.borArg = _config.borArg;
+    }
+    if (_config.lock)
+    {
+        config.lock = true;
+        config.lockArg = _config.lockArg;
+    }
+    if (_config.unlock)
+    {
+        config.unlock = true;
+        config.unlockArg = _config.unlockArg;
+    }
+}
@@ -0,0 +1,94 @@
+///////////////////////////////////////////////////////////////////////////////
+// BOSSA
+//
+// Copyright (c) 2011-2018, ShumaTech
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the <organization> nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+#ifndef _MANIFEST_H
+#define _MANIFEST_H
+
+#include <stdint.h>
+
+#include <exception>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ImageSource.h"
+#include "Session.h"
+
+class ManifestError : public std::exception
+{
+public:
+    ManifestError(const std::string& reason) : exception(), _reason(reason) {}
+    virtual ~ManifestError() throw() {}
+    virtual const char* what() const throw() { return _reason.c_str(); }
+
+private:
+    std::string _reason;
+};
+
+// A text file that lists the images to write, with the offset of each
+// binary, and the option bits, locks and reset to apply after them.  All
+// of it runs in one session, so the flash is erased and verified once for
+// the combined image.
+//
+//     # Comments run to the end of the line
+//     image bootloader.bin            # binary at the start of flash
+//     image app.hex                   # addressed images take no offset
+//     image config.bin 0x3f000        # binary at an offset into flash
+//     erase                           # erase all flash first
+//     verify
+//     boot 1
+//     bod 1
+//     bor 1
+//     lock 0,1
+//     unlock
+//     security
+//     reset
+//
+// Relative image paths are taken from the directory of the manifest.
+class Manifest
+{
+public:
+    Manifest(const char* filename, ImageCache* cache = NULL);
+    virtual ~Manifest() {}
+
+    // Set the options of the manifest in the config
+    void apply(BossaConfig& config);
+
+    std::shared_ptr<ImageSource> image() { return _image; }
+
+private:
+    std::string _filename;
+    std::shared_ptr<ImageSource> _image;
+    BossaConfig _config;
+
+    void parse(ImageCache* cache);
+    void error(uint32_t line, const char* reason);
+    bool parseBool(const std::string& arg, int& value);
+};
+
+#endif // _MANIFEST_H
@@ -0,0 +1,315 @@
+///////////////////////////////////////////////////////////////////////////////
+// BOSSA
+//
+// Copyright (c) 2011-2018, ShumaTech
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the <organization> nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+#include "PatchFile.h"
+#include "FileError.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#if defined(__WIN32__)
+#include <io.h>
+#include <sys/locking.h>
+#else
+#include <sys/file.h>
+#endif
+
+#include <fstream>
+#include <sstream>
+
+PatchFile::PatchFile(const char* filename) :
+    _filename(filename)
+{
+    parse();
+}
+
+void
+PatchFile::error(uint32_t line, const char* reason)
+{
+    char text[32];
+
+    snprintf(text, sizeof(text), ":%u: ", line);
+    throw PatchFileError(_filename + text + reason);
+}
+
+static int
+hexDigit(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+void
+PatchFile::parse()
+{
+    std::ifstream file(_filename.c_str());
+    std::string text;
+    uint32_t line = 0;
+
+    if (!file)
+        throw FileOpenError(errno);
+
+    while (std::getline(file, text))
+    {
+        std::vector<ImagePatch> patches;
+        std::string word;
+
+        line++;
+        text = text.substr(0, text.find('#'));
+
+        std::istringstream words(text);
+        while (words >> word)
+        {
+            size_t colon = word.find(':');
+            std::string hex;
+            std::string data;
+            uint32_t offset;
+            char* end;
+
+            if (colon == std::string::npos)
+                error(line, "a record is OFFSET:HEX");
+
+            errno = 0;
+            offset = strtoul(word.substr(0, colon).c_str(), &end, 0);
+            if (errno || *end || colon == 0)
+                error(line, "invalid record offset");
+
+            hex = word.substr(colon + 1);
+            if (hex.empty() || hex.size() % 2 != 0)
+                error(line, "a record needs whole bytes of hex");
+
+            for (size_t pos = 0; pos < hex.size(); pos += 2)
+            {
+                int high = hexDigit(hex[pos]);
+                int low = hexDigit(hex[pos + 1]);
+
+                if (high < 0 || low < 0)
+                    error(line, "invalid hex in record");
+                data += (char) (high << 4 | low);
+            }
+
+            if ((uint64_t) offset + data.size() > 0x100000000ULL)
+                error(line, "record runs past the 4GB address space");
+
+            patches.push_back(ImagePatch(offset, data));
+        }
+
+        if (!patches.empty())
+            _units.push_back(patches);
+    }
+
+    if (file.bad())
+        throw FileIoError(errno);
+
+    if (_units.empty())
+        error(line, "no units listed");
+}
+
+// Only one process at a time reads and moves on the count of used lines.
+// The count itself is renamed into place, so the lock is kept on a file
+// of its own that never changes.
+int
+PatchFile::lock()
+{
+    std::string path = _filename + ".lock";
+    int fd;
+
+    fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0)
+        throw FileOpenError(errno);
+
+#if defined(__WIN32__)
+    while (_locking(fd, _LK_LOCK, 1) != 0)
+    {
+        if (errno != EDEADLOCK)
+        {
+            close(fd);
+            throw FileIoError(errno);
+        }
+    }
+#else
+    while (flock(fd, LOCK_EX) != 0)
+    {
+        if (errno != EINTR)
+        {
+            close(fd);
+            throw FileIoError(errno);
+        }
+    }
+#endif
+
+    return fd;
+}
+
+void
+PatchFile::unlock(int fd)
+{
+#if defined(__WIN32__)
+    lseek(fd, 0, SEEK_SET);
+    _locking(fd, _LK_UNLCK, 1);
+#endif
+    close(fd);
+}
+
+uint32_t
+PatchFile::used()
+{
+    std::string path = _filename + ".next";
+    unsigned long used = 0;
+    FILE* file;
+
+    file = fopen(path.c_str(), "r");
+    if (!file)
+    {
+        if (errno == ENOENT)
+            return 0;
+        throw FileOpenError(errno);
+    }
+
+    // A count that cannot be read would hand lines out again
+    if (fscanf(file, "%lu", &used) != 1)
+    {
+        fclose(file);
+        throw PatchFileError(path + ": unreadable count of used lines");
+    }
+
+    fclose(file);
+    return used;
+}
+
+void
+PatchFile::setUsed(uint32_t used)
+{
+    std::string path = _filename + ".next";
+    char suffix[32];
+    FILE* file;
+
+    snprintf(suffix, sizeof(suffix), ".%d.tmp", (int) getpid());
+    std::string temp = path + suffix;
+
+    // Write a new copy and rename it over the old one so that the count
+    // is never lost part way, and make sure it is on disk before the line
+    // is used
+    file = fopen(temp.c_str(), "w");
+    if (!file)
+        throw FileOpenError(errno);
+
+    if (fprintf(file, "%u\n", used) < 0 || fflush(file) != 0 || fsync(fileno(file)) != 0)
+    {
+        int errnum = errno;
+
+        fclose(file);
+        remove(temp.c_str());
+        throw FileIoError(errnum);
+    }
+
+    if (fclose(file) != 0)
+    {
+        int errnum = errno;
+
+        remove(temp.c_str());
+        throw FileIoError(errnum);
+    }
+
+#if defined(__WIN32__)
+    remove(path.c_str());
+#endif
+    if (rename(temp.c_str(), path.c_str()) != 0)
+    {
+        int errnum = errno;
+
+        remove(temp.c_str());
+        throw FileIoError(errnum);
+    }
+}
+
+bool
+PatchFile::next(std::vector<ImagePatch>& patches, uint32_t& unit)
+{
+    std::lock_guard<std::mutex> guard(_mutex);
+    int fd = lock();
+    uint32_t next;
+
+    try
+    {
+        next = used();
+        if (next < _units.size())
+            setUsed(next + 1);
+    }
+    catch (...)
+    {
+        unlock(fd);
+        throw;
+    }
+
+    unlock(fd);
+
+    if (next >= _units.size())
+        return false;
+
+    patches = _units[next];
+    unit = next + 1;
+
+    return true;
+}
+
+bool
+PatchFile::peek(std::vector<ImagePatch>& patches, uint32_t& unit)
+{
+    std::lock_guard<std::mutex> guard(_mutex);
+    int fd = lock();
+    uint32_t next;
+
+    try
+    {
+        next = used();
+    }
+    catch (...)
+    {
+        unlock(fd);
+        throw;
+    }
+
+    unlock(fd);
+
+    if (next >= _units.size())
+        return false;
+
+    patches = _units[next];
+    unit = next + 1;
+
+    return true;
+}
@@ -0,0 +1,95 @@
+///////////////////////////////////////////////////////////////////////////////
+// BOSSA
+//
+// Copyright (c) 2011-2018, ShumaTech
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the <organization> nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+#ifndef _PATCHFILE_H
+#define _PATCHFILE_H
+
+#include <stdint.h>
+
+#include <exception>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "ImageSource.h"
+
+class PatchFileError : public std::exception
+{
+public:
+    PatchFileError(const std::string& reason) : exception(), _reason(reason) {}
+    virtual ~PatchFileError() throw() {}
+    virtual const char* what() const throw() { return _reason.c_str(); }
+
+private:
+    std::string _reason;
+};
+
+// A text file of the records to patch over the image for each unit, such
+// as its serial number, MAC address and keys.  Each line is one unit, in
+// the order they are programmed, with one or more records of an offset
+// from the start of flash and the bytes to put there in hex.
+//
+//     # Comments run to the end of the line
+//     0x3fc0:00000001 0x3fc4:0004a3000001
+//     0x3fc0:00000002 0x3fc4:0004a3000002
+//
+// A line is only ever handed out once, even to a unit that then fails, so
+// that no two boards can end up with the same record.  The number of lines
+// handed out is kept beside the file in FILE.next, under a lock on
+// FILE.lock, so that separate runs and processes carry on from each other.
+class PatchFile
+{
+public:
+    PatchFile(const char* filename);
+    virtual ~PatchFile() {}
+
+    const std::string& name() { return _filename; }
+    uint32_t units() { return _units.size(); }
+
+    // Take the records of the next unit, numbered from 1.  The line is
+    // marked as used on disk before this returns.  Returns false once
+    // every line has been used.
+    bool next(std::vector<ImagePatch>& patches, uint32_t& unit);
+
+    // The records that next would give out, without taking them
+    bool peek(std::vector<ImagePatch>& patches, uint32_t& unit);
+
+private:
+    std::string _filename;
+    std::vector<std::vector<ImagePatch>> _units;
+    std::mutex _mutex;
+
+    void error(uint32_t line, const char* reason);
+    void parse();
+    int lock();
+    void unlock(int fd);
+    uint32_t used();
+    void setUsed(uint32_t used);
+};
+
+#endif // _PATCHFILE_H
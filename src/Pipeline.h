@@ -0,0 +1,251 @@
+///////////////////////////////////////////////////////////////////////////////
+// BOSSA
+//
+// Copyright (c) 2011-2018, ShumaTech
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the <organization> nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+#ifndef _PIPELINE_H
+#define _PIPELINE_H
+
+#include <stdint.h>
+
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+#if defined(__linux__)
+#include "Fiber.h"
+#endif
+
+// A single thread shared by every pipeline, running the producers queued
+// on it one after another so that a session does not start a thread of its
+// own for each extent
+class PipelineWorker
+{
+public:
+    static PipelineWorker& shared()
+    {
+        static PipelineWorker worker;
+        return worker;
+    }
+
+    virtual ~PipelineWorker()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stop = true;
+        }
+        _ready.notify_all();
+        if (_thread.joinable())
+            _thread.join();
+    }
+
+    void post(std::function<void()> task)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        if (!_thread.joinable())
+            _thread = std::thread(&PipelineWorker::run, this);
+        _tasks.push_back(task);
+        _ready.notify_one();
+    }
+
+private:
+    std::deque<std::function<void()>> _tasks;
+    std::mutex _mutex;
+    std::condition_variable _ready;
+    bool _stop;
+    std::thread _thread;
+
+    PipelineWorker() : _stop(false) {}
+
+    void run()
+    {
+        while (true)
+        {
+            std::function<void()> task;
+
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+
+                _ready.wait(lock, [this]() { return _stop || !_tasks.empty(); });
+                if (_tasks.empty())
+                    return;
+                task = std::move(_tasks.front());
+                _tasks.pop_front();
+            }
+
+            task();
+        }
+    }
+
+    PipelineWorker(const PipelineWorker&);
+    PipelineWorker& operator=(const PipelineWorker&);
+};
+
+// Runs a producer on the shared worker so that it makes items ahead of the
+// consumer, holding at most depth of them at once.  The producer returns
+// false when it has no more items, and anything it throws is thrown again
+// from next() once the items before it have been taken.
+//
+// A fiber shares its thread with other sessions on the event loop and must
+// not block waiting for the worker, so there the items are made as they
+// are asked for instead.
+template <class T>
+class Pipeline
+{
+public:
+    Pipeline(std::function<bool(T&)> produce, uint32_t depth = DefaultDepth) :
+        _produce(produce), _depth(depth), _done(false), _stop(false), _running(false)
+    {
+#if defined(__linux__)
+        _inline = Fiber::current() != NULL;
+#else
+        _inline = false;
+#endif
+        if (!_inline)
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            schedule();
+        }
+    }
+
+    virtual ~Pipeline()
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+
+        _stop = true;
+        _idle.wait(lock, [this]() { return !_running; });
+    }
+
+    // Wait for the next item and return false once there are no more
+    bool next(T& item)
+    {
+        if (_inline)
+        {
+            if (_done)
+                return false;
+            if (!_produce(item))
+                _done = true;
+            return !_done;
+        }
+
+        std::unique_lock<std::mutex> lock(_mutex);
+
+        _ready.wait(lock, [this]() { return _done || !_items.empty(); });
+
+        if (_items.empty())
+        {
+            if (_error)
+                std::rethrow_exception(_error);
+            return false;
+        }
+
+        std::swap(item, _items.front());
+        _items.pop_front();
+        schedule();
+
+        return true;
+    }
+
+    static const uint32_t DefaultDepth = 4;
+
+private:
+    std::function<bool(T&)> _produce;
+    uint32_t _depth;
+    std::deque<T> _items;
+    std::mutex _mutex;
+    std::condition_variable _ready;
+    std::condition_variable _idle;
+    std::exception_ptr _error;
+    bool _done;
+    bool _stop;
+    bool _running;
+    bool _inline;
+
+    // Queue the producer on the worker if there is room for more items and
+    // it is not queued already.  Called with the mutex held.
+    void schedule()
+    {
+        if (_running || _done || _stop || _items.size() >= _depth)
+            return;
+
+        _running = true;
+        PipelineWorker::shared().post([this]() { fill(); });
+    }
+
+    void fill()
+    {
+        while (true)
+        {
+            T item;
+            bool more;
+
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+
+                // Give the worker to the other pipelines until there is room
+                if (_stop || _items.size() >= _depth)
+                {
+                    _running = false;
+                    _idle.notify_all();
+                    return;
+                }
+            }
+
+            try
+            {
+                more = _produce(item);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _error = std::current_exception();
+                more = false;
+            }
+
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (more)
+                _items.push_back(std::move(item));
+            else
+                _done = true;
+            _ready.notify_one();
+            if (!more)
+            {
+                _running = false;
+                _idle.notify_all();
+                return;
+            }
+        }
+    }
+
+    Pipeline(const Pipeline&);
+    Pipeline& operator=(const Pipeline&);
+};
+
+#endif // _PIPELINE_H
@@ -0,0 +1,499 @@
+///////////////////////////////////////////////////////////////////////////////
+// BOSSA
+//
+// Copyright (c) 2011-2018, ShumaTech
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the <organization> nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+#include "Plan.h"
+#include "Flasher.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include <algorithm>
+
+using std::min;
+
+// Round trips of the common command sequences: a word written or read,
+// one of the applets set up and run, a VM program sent and run, and the
+// device identified with the applets loaded on connecting
+#define COMMAND_TRIPS       1
+#define APPLET_TRIPS        5
+#define VM_TRIPS            3
+#define CONNECT_TRIPS       24
+
+// RS-232 data goes over XMODEM, which waits for an ACK on every block
+#define XMODEM_BLOCK        128
+
+#define USB_RATE            1000
+#define USB_ROUND_TRIP      1000
+#define SERIAL_ROUND_TRIP   4000
+
+// A typical device of each family, the largest of it, by the identifiers
+// Device knows it by.  Device sets up its flash, SRAM and buffers just as
+// it would for a connected part.  The timings are rough typical figures
+// from the data sheets, good enough to compare images and fixtures but
+// worth checking against a real run.
+struct PlanFamily
+{
+    const char* name;
+    Device::Family family;
+    uint32_t chipId;
+    uint32_t extChipId;
+    uint32_t deviceId;
+    PlanTarget::Controller controller;
+    bool extended;
+    uint32_t pageTime;
+    uint32_t unitEraseTime;
+    uint32_t chipEraseRate;
+    uint32_t crcRate;
+};
+
+static const PlanFamily Families[] =
+{
+    { "sam7s",  Device::FAMILY_SAM7S,  0x270b0a40, 0,          0,          PlanTarget::Efc,  false, 6000, 0,     2000, 2000 },
+    { "sam7se", Device::FAMILY_SAM7SE, 0x272a0a40, 0,          0,          PlanTarget::Efc,  false, 6000, 0,     2000, 2000 },
+    { "sam7x",  Device::FAMILY_SAM7X,  0x275c0a40, 0,          0,          PlanTarget::Efc,  false, 6000, 0,     2000, 2000 },
+    { "sam7xc", Device::FAMILY_SAM7XC, 0x271c0a40, 0,          0,          PlanTarget::Efc,  false, 6000, 0,     2000, 2000 },
+    { "sam7l",  Device::FAMILY_SAM7L,  0x27330740, 0,          0,          PlanTarget::Eefc, false, 3000, 10000, 500,  2000 },
+    { "sam3n",  Device::FAMILY_SAM3N,  0x29540960, 0,          0,          PlanTarget::Eefc, false, 1500, 10000, 1000, 4000 },
+    { "sam3s",  Device::FAMILY_SAM3S,  0x29ab0a60, 0,          0,          PlanTarget::Eefc, false, 1500, 10000, 1000, 4000 },
+    { "sam3u",  Device::FAMILY_SAM3U,  0x28100960, 0,          0,          PlanTarget::Eefc, false, 1500, 10000, 1000, 4000 },
+    { "sam3x",  Device::FAMILY_SAM3X,  0x284e0a60, 0,          0,          PlanTarget::Eefc, false, 1500, 10000, 1000, 4000 },
+    { "sam3a",  Device::FAMILY_SAM3A,  0x283e0a60, 0,          0,          PlanTarget::Eefc, false, 1500, 10000, 1000, 4000 },
+    { "sam4s",  Device::FAMILY_SAM4S,  0x288c0ce0, 0,          0,          PlanTarget::Eefc, false, 1500, 10000, 1000, 6000 },
+    { "sam4e",  Device::FAMILY_SAM4E,  0x23cc0ce0, 0x00120200, 0,          PlanTarget::Eefc, false, 1500, 10000, 1000, 6000 },
+    { "sam9xe", Device::FAMILY_SAM9XE, 0x329aa3a0, 0,          0,          PlanTarget::Eefc, false, 3000, 10000, 500,  10000 },
+    { "samd21", Device::FAMILY_SAMD21, 0,          0,          0x10010000, PlanTarget::Nvm,  true,  2500, 6000,  0,    3000 },
+    { "samr21", Device::FAMILY_SAMR21, 0,          0,          0x10010019, PlanTarget::Nvm,  true,  2500, 6000,  0,    3000 },
+    { "saml21", Device::FAMILY_SAML21, 0,          0,          0x10810019, PlanTarget::Nvm,  true,  2500, 6000,  0,    3000 },
+    { "samd51", Device::FAMILY_SAMD51, 0,          0,          0x60060004, PlanTarget::Nvm,  true,  2500, 25000, 0,    8000 },
+    { "same51", Device::FAMILY_SAME51, 0,          0,          0x61810004, PlanTarget::Nvm,  true,  2500, 25000, 0,    8000 },
+    { "same53", Device::FAMILY_SAME53, 0,          0,          0x61830004, PlanTarget::Nvm,  true,  2500, 25000, 0,    8000 },
+    { "same54", Device::FAMILY_SAME54, 0,          0,          0x61840000, PlanTarget::Nvm,  true,  2500, 25000, 0,    8000 },
+    { "same70", Device::FAMILY_SAME70, 0x21020e00, 0,          0,          PlanTarget::Eefc, false, 1500, 10000, 250,  20000 },
+    { "sams70", Device::FAMILY_SAMS70, 0x21120e00, 0,          0,          PlanTarget::Eefc, false, 1500, 10000, 250,  20000 },
+    { "samv70", Device::FAMILY_SAMV70, 0x21320c00, 0,          0,          PlanTarget::Eefc, false, 1500, 10000, 250,  20000 },
+    { "samv71", Device::FAMILY_SAMV71, 0x21220e00, 0,          0,          PlanTarget::Eefc, false, 1500, 10000, 250,  20000 },
+};
+
+#define NUM_FAMILIES (sizeof(Families) / sizeof(Families[0]))
+
+PlanTarget::PlanTarget() :
+    controller(Efc), address(0), totalSize(0), pageSize(0), unitSize(0), planes(1), bufferWindow(0),
+    stagingSize(0), decodeRate(0), canWriteBuffer(false), canChecksumBuffer(false), canChipErase(false),
+    writeBufferSize(0), checksumBufferSize(0), pageTime(0), unitEraseTime(0), chipEraseRate(0), crcRate(0)
+{
+}
+
+PlanTarget::PlanTarget(Samba& samba, Device& device)
+{
+    Device::FlashPtr& flash = device.getFlash();
+
+    name = flash->name();
+    address = flash->address();
+    totalSize = flash->totalSize();
+    pageSize = flash->pageSize();
+    unitSize = flash->pagesPerErase() * pageSize;
+    planes = flash->numPlanes();
+    bufferWindow = flash->bufferWindow();
+    stagingSize = flash->stagingSize();
+    decodeRate = flash->decodeRate();
+
+    canWriteBuffer = samba.canWriteBuffer();
+    canChecksumBuffer = samba.canChecksumBuffer();
+    canChipErase = samba.canChipErase();
+    writeBufferSize = samba.writeBufferSize();
+    checksumBufferSize = samba.checksumBufferSize();
+
+    if (!timings(device.getFamily()))
+        throw DeviceUnsupportedError();
+}
+
+bool
+PlanTarget::timings(Device::Family family)
+{
+    for (uint32_t index = 0; index < NUM_FAMILIES; index++)
+    {
+        const PlanFamily& entry = Families[index];
+
+        if (entry.family != family)
+            continue;
+
+        this->family = entry.name;
+        controller = entry.controller;
+        pageTime = entry.pageTime;
+        unitEraseTime = entry.unitEraseTime;
+        chipEraseRate = entry.chipEraseRate;
+        crcRate = entry.crcRate;
+        return true;
+    }
+
+    return false;
+}
+
+bool
+PlanTarget::find(const std::string& family, Samba& samba, Device& device, PlanTarget& target)
+{
+    for (uint32_t index = 0; index < NUM_FAMILIES; index++)
+    {
+        const PlanFamily& entry = Families[index];
+
+        if (strcasecmp(family.c_str(), entry.name) != 0)
+            continue;
+
+        device.create(entry.chipId, entry.extChipId, entry.deviceId);
+        target = PlanTarget(samba, device);
+
+        // The usual bootloaders of the Cortex-M0+ and M4 parts are the
+        // Arduino ones, which program, checksum and erase by themselves
+        target.canWriteBuffer = entry.extended;
+        target.canChecksumBuffer = entry.extended;
+        target.canChipErase = entry.extended;
+
+        return true;
+    }
+
+    return false;
+}
+
+std::string
+PlanTarget::families()
+{
+    std::string names;
+
+    for (uint32_t index = 0; index < NUM_FAMILIES; index++)
+    {
+        if (index)
+            names += " ";
+        names += Families[index].name;
+    }
+
+    return names;
+}
+
+PlanLink::PlanLink() : name("usb"), usb(true), rate(USB_RATE), roundTrip(USB_ROUND_TRIP)
+{
+}
+
+PlanLink::PlanLink(Samba& samba) : name("usb"), usb(samba.isUsb()), rate(samba.linkRate()), roundTrip(USB_ROUND_TRIP)
+{
+    if (!usb)
+    {
+        name = "RS-232";
+        roundTrip = SERIAL_ROUND_TRIP;
+    }
+}
+
+bool
+PlanLink::find(const std::string& profile, PlanLink& link)
+{
+    char* end;
+    unsigned long baud;
+
+    link = PlanLink();
+    if (strcasecmp(profile.c_str(), "usb") == 0)
+        return true;
+
+    // A serial link carries ten bits per byte
+    baud = strtoul(profile.c_str(), &end, 10);
+    if (*end != '\0' || baud < 1200 || baud > 10000000)
+        return false;
+
+    link.name = "RS-232 at " + profile + " baud";
+    link.usb = false;
+    link.rate = baud >= 10000 ? baud / 10000 : 1;
+    link.roundTrip = SERIAL_ROUND_TRIP;
+    return true;
+}
+
+Plan::Plan(Samba& samba, Device& device, const PlanTarget& target, const PlanLink& link,
+           FlasherObserver& observer) :
+    _target(target), _link(link), _flasher(samba, device, observer), _erased(Flasher::NoErase), _checkPages(0)
+{
+    PlanStep step("connect");
+
+    step.trips = CONNECT_TRIPS;
+    step.note = "identify the device and load the applets";
+    add(step);
+}
+
+uint32_t
+Plan::loadTrips(uint32_t size)
+{
+    if (_link.usb)
+        return COMMAND_TRIPS;
+
+    return COMMAND_TRIPS + (size + XMODEM_BLOCK - 1) / XMODEM_BLOCK;
+}
+
+uint32_t
+Plan::checksumTrips(uint32_t size)
+{
+    if (_target.canChecksumBuffer && size <= _target.checksumBufferSize)
+        return COMMAND_TRIPS;
+
+    return APPLET_TRIPS;
+}
+
+void
+Plan::time(PlanStep& step)
+{
+    step.linkTime = (uint64_t) step.trips * _link.roundTrip + (uint64_t) step.sent * 1000 / _link.rate;
+}
+
+void
+Plan::add(PlanStep& step)
+{
+    time(step);
+
+    // Runs of skipped windows read better as one
+    if (!_steps.empty() && step.op == "skip" && _steps.back().op == "skip" &&
+        _steps.back().offset + _steps.back().size == step.offset)
+    {
+        _steps.back().size += step.size;
+        _steps.back().pages += step.pages;
+        return;
+    }
+
+    _steps.push_back(step);
+}
+
+void
+Plan::erase(uint32_t foffset)
+{
+    PlanStep step("erase", foffset, _target.totalSize - foffset);
+    uint32_t units = (_target.totalSize - foffset) / _target.unitSize;
+
+    if (foffset % _target.unitSize != 0 || (_target.controller == PlanTarget::Efc && foffset != 0))
+        throw FlashEraseError();
+
+    // EFC and EEFC erase the whole chip from offset 0, EEFC and NVM erase
+    // unit by unit otherwise, unless the bootloader does it
+    if (_target.controller == PlanTarget::Efc ||
+        (_target.controller == PlanTarget::Eefc && foffset == 0))
+    {
+        step.trips = 2 * COMMAND_TRIPS * _target.planes;
+        step.flashTime = (uint64_t) step.size * 1000 / _target.chipEraseRate;
+        step.note = "chip erase";
+    }
+    else
+    {
+        step.trips = _target.canChipErase ? COMMAND_TRIPS :
+            units * (_target.controller == PlanTarget::Nvm ? VM_TRIPS : 2 * COMMAND_TRIPS);
+        step.flashTime = (uint64_t) units * _target.unitEraseTime;
+        step.note = std::to_string(units) + " erase units";
+    }
+
+    add(step);
+    _erased = foffset;
+}
+
+void
+Plan::checksum(uint32_t offset, uint32_t size)
+{
+    PlanStep step("checksum", offset, size);
+
+    step.trips = checksumTrips(size);
+    step.flashTime = (uint64_t) size * 1000 / _target.crcRate;
+    add(step);
+
+    _checkPages = std::max(_checkPages, (size + _target.pageSize - 1) / _target.pageSize);
+}
+
+// What it costs to find one bad page in a checksum of this many pages.
+// Flasher halves the window until it is down to the page, checksumming
+// both halves at each step when the bad page is in the first, and then
+// reads the page back.
+PlanStep
+Plan::bisect(uint32_t pages)
+{
+    PlanStep step("bisect");
+    uint32_t pageSize = _target.pageSize;
+
+    for (; pages > 1; pages /= 2)
+    {
+        step.trips += checksumTrips(pages / 2 * pageSize) + checksumTrips((pages - pages / 2) * pageSize);
+        step.flashTime += (uint64_t) pages * pageSize * 1000 / _target.crcRate;
+        step.pages += 2;
+    }
+
+    step.sent = pageSize;
+    step.trips += loadTrips(pageSize);
+    time(step);
+
+    return step;
+}
+
+void
+Plan::write(ImageSource& image, uint32_t foffset, bool verify)
+{
+    uint32_t numPages;
+    std::vector<ImageExtent> extents = _flasher.extents(image, foffset, numPages);
+    uint32_t pageSize = _target.pageSize;
+    bool buffered = _target.canWriteBuffer;
+    uint32_t bufferSize = _flasher.transferSize(buffered ? _target.writeBufferSize : _target.bufferWindow);
+
+    for (uint32_t index = 0; index < extents.size(); index++)
+    {
+        const ImageExtent& extent = extents[index];
+        bool patched = _flasher.patched(extent);
+        std::function<bool(FlasherWindow&)> produce = _flasher.prepare(extent, 0, bufferSize, buffered, false, false);
+        FlasherWindow window;
+
+        while (produce(window))
+        {
+            PlanStep step("write", extent.offset + window.offset, window.writeSize);
+            step.pages = (window.writeSize + pageSize - 1) / pageSize;
+
+            if (Flasher::skipWindow(extent, window, _erased))
+            {
+                step.op = "skip";
+                add(step);
+                if (verify)
+                    checksum(step.offset, window.size);
+                continue;
+            }
+
+            // The same choice as Flasher::sendWindow, on the planned link
+            step.sent = window.writeSize;
+            step.trips = loadTrips(window.writeSize);
+            if (window.block && Flasher::compressPays(window.writeSize, window.blockSize, _target.stagingSize,
+                                                      _link.rate, _target.decodeRate))
+            {
+                step.sent = window.blockSize;
+                step.trips = loadTrips(window.blockSize) + APPLET_TRIPS;
+                step.flashTime += (uint64_t) window.writeSize * 1000 / _target.decodeRate;
+                step.note = "compressed";
+            }
+
+            step.trips += buffered ? COMMAND_TRIPS : step.pages * VM_TRIPS;
+            step.flashTime += (uint64_t) step.pages * _target.pageTime;
+
+            // Pages of an NVM flash that was not erased are erased a unit at
+            // a time as they are written
+            if (_erased == Flasher::NoErase && _target.controller == PlanTarget::Nvm)
+            {
+                uint32_t units = (window.writeSize + _target.unitSize - 1) / _target.unitSize;
+
+                step.trips += buffered ? 0 : units * VM_TRIPS;
+                step.flashTime += (uint64_t) units * _target.unitEraseTime;
+            }
+
+            // This is the slow case a plan is for, blank flash sent and
+            // programmed only because nothing erased it first
+            if (window.blank)
+                step.note = "blank but not erased";
+            if (patched)
+                step.note += step.note.empty() ? "patched" : ", patched";
+
+            add(step);
+            if (verify)
+                checksum(step.offset, window.size);
+        }
+    }
+
+    _erased = Flasher::NoErase;
+}
+
+void
+Plan::verify(ImageSource& image, uint32_t foffset)
+{
+    uint32_t numPages;
+    std::vector<ImageExtent> extents = _flasher.extents(image, foffset, numPages);
+    uint32_t pageSize = _target.pageSize;
+    uint32_t windowPages;
+
+    if (_target.canChecksumBuffer)
+        windowPages = _target.checksumBufferSize / pageSize;
+    else
+        windowPages = _target.bufferWindow / pageSize;
+    if (windowPages == 0)
+        windowPages = 1;
+
+    for (uint32_t index = 0; index < extents.size(); index++)
+    {
+        const ImageExtent& extent = extents[index];
+
+        for (uint32_t offset = 0; offset < extent.size; offset += windowPages * pageSize)
+            checksum(extent.offset + offset, min(windowPages * pageSize, extent.size - offset));
+    }
+}
+
+void
+Plan::print()
+{
+    uint32_t written = 0;
+    uint32_t skipped = 0;
+    uint64_t sent = 0;
+    uint64_t trips = 0;
+    uint64_t linkTime = 0;
+    uint64_t flashTime = 0;
+
+    printf("Device       : %s (%s)\n", _target.name.c_str(), _target.family.c_str());
+    printf("Flash        : %uKB at 0x%x, %u byte pages, %u byte erase units\n",
+           _target.totalSize / 1024, _target.address, _target.pageSize, _target.unitSize);
+    printf("Link         : %s, %u bytes/ms, %.1f ms round trip\n",
+           _link.name.c_str(), _link.rate, _link.roundTrip / 1000.0);
+    printf("Bootloader   : %s\n", _target.canWriteBuffer ? "writes, checksums and erases by itself" :
+           "driven by the applets");
+    printf("\n%-9s %-10s %8s %6s %8s %6s %9s\n", "Operation", "Offset", "Bytes", "Pages", "Sent", "Trips", "Time (ms)");
+
+    for (uint32_t index = 0; index < _steps.size(); index++)
+    {
+        const PlanStep& step = _steps[index];
+
+        printf("%-9s 0x%08x %8u %6u %8u %6u %9.1f%s%s\n", step.op.c_str(), step.offset, step.size, step.pages,
+               step.sent, step.trips, (step.linkTime + step.flashTime) / 1000.0, step.note.empty() ? "" : "  ",
+               step.note.c_str());
+
+        if (step.op == "write")
+            written += step.pages;
+        else if (step.op == "skip")
+            skipped += step.pages;
+        sent += step.sent;
+        trips += step.trips;
+        linkTime += step.linkTime;
+        flashTime += step.flashTime;
+    }
+
+    printf("\n");
+    printf("Pages written: %u\n", written);
+    printf("Pages skipped: %u\n", skipped);
+    printf("Bytes sent   : %llu\n", (unsigned long long) sent);
+    printf("Round trips  : %llu\n", (unsigned long long) trips);
+    printf("Predicted    : %.3f seconds (link %.3f, flash %.3f)\n",
+           (linkTime + flashTime) / 1e6, linkTime / 1e6, flashTime / 1e6);
+
+    if (_checkPages > 0)
+    {
+        PlanStep step = bisect(_checkPages);
+
+        printf("Bad page     : %.1f ms more to find each, %u checksums and a page read\n",
+               (step.linkTime + step.flashTime) / 1000.0, step.pages);
+    }
+}
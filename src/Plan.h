@@ -0,0 +1,170 @@
+///////////////////////////////////////////////////////////////////////////////
+// BOSSA
+//
+// Copyright (c) 2011-2018, ShumaTech
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the <organization> nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+#ifndef _PLAN_H
+#define _PLAN_H
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "Samba.h"
+#include "Device.h"
+#include "Flasher.h"
+#include "ImageSource.h"
+
+// What a plan needs to know about a flash and the bootloader driving it
+class PlanTarget
+{
+public:
+    PlanTarget();
+
+    // The device that is connected
+    PlanTarget(Samba& samba, Device& device);
+
+    // Set the device up as a typical part of the family, as its usual
+    // bootloader drives it, for planning without one.  Nothing talks to
+    // the device.  Returns false for a family it does not know.
+    static bool find(const std::string& family, Samba& samba, Device& device, PlanTarget& target);
+
+    // The names that find knows, separated by spaces
+    static std::string families();
+
+    enum Controller
+    {
+        Efc,
+        Eefc,
+        Nvm,
+    };
+
+    std::string name;
+    std::string family;
+    Controller controller;
+    uint32_t address;
+    uint32_t totalSize;
+    uint32_t pageSize;
+    uint32_t unitSize;
+    uint32_t planes;
+    uint32_t bufferWindow;
+    uint32_t stagingSize;
+    uint32_t decodeRate;
+
+    bool canWriteBuffer;
+    bool canChecksumBuffer;
+    bool canChipErase;
+    uint32_t writeBufferSize;
+    uint32_t checksumBufferSize;
+
+    // Rough timings of the flash in microseconds and the speeds of a chip
+    // erase and of the CRC applet in bytes per millisecond
+    uint32_t pageTime;
+    uint32_t unitEraseTime;
+    uint32_t chipEraseRate;
+    uint32_t crcRate;
+
+private:
+    bool timings(Device::Family family);
+};
+
+// How quickly commands and data get to the bootloader
+class PlanLink
+{
+public:
+    PlanLink();
+
+    // The link to the connected device
+    PlanLink(Samba& samba);
+
+    // "usb", or the baud rate of an RS-232 link.  Returns false for a
+    // profile it does not understand.
+    static bool find(const std::string& profile, PlanLink& link);
+
+    std::string name;
+    bool usb;
+    uint32_t rate;
+    uint32_t roundTrip;
+};
+
+// One operation of a plan, with what it sends and how long it should take
+class PlanStep
+{
+public:
+    PlanStep(const char* op, uint32_t offset = 0, uint32_t size = 0) :
+        op(op), offset(offset), size(size), pages(0), sent(0), trips(0), linkTime(0), flashTime(0) {}
+
+    std::string op;
+    uint32_t offset;
+    uint32_t size;
+    uint32_t pages;
+    uint32_t sent;
+    uint32_t trips;
+    uint64_t linkTime;
+    uint64_t flashTime;
+    std::string note;
+};
+
+// Works out the operations that an erase, write and verify would run on a
+// target, without touching a device, and predicts how long they take.  The
+// windows come from Flasher, with its patches, padding, blank skipping and
+// compression, so a plan shows the same sequence that a real run would.
+class Plan
+{
+public:
+    Plan(Samba& samba, Device& device, const PlanTarget& target, const PlanLink& link,
+         FlasherObserver& observer);
+    virtual ~Plan() {}
+
+    // Lay the records of one unit over the image, as Flasher would
+    void setPatches(const std::vector<ImagePatch>& patches) { _flasher.setPatches(patches); }
+
+    void erase(uint32_t foffset);
+    void write(ImageSource& image, uint32_t foffset, bool verify);
+    void verify(ImageSource& image, uint32_t foffset);
+
+    void print();
+
+    const std::vector<PlanStep>& steps() { return _steps; }
+
+private:
+    PlanTarget _target;
+    PlanLink _link;
+    Flasher _flasher;
+    std::vector<PlanStep> _steps;
+    uint32_t _erased;
+    uint32_t _checkPages;
+
+    uint32_t loadTrips(uint32_t size);
+    uint32_t checksumTrips(uint32_t size);
+    void time(PlanStep& step);
+    void add(PlanStep& step);
+    void checksum(uint32_t offset, uint32_t size);
+    PlanStep bisect(uint32_t pages);
+};
+
+#endif // _PLAN_H
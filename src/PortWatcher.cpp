@@ -0,0 +1,100 @@
+///////////////////////////////////////////////////////////////////////////////
+// BOSSA
+//
+// Copyright (c) 2011-2018, ShumaTech
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the <organization> nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+#include <errno.h>
+#include <unistd.h>
+#include <fnmatch.h>
+#include <sys/inotify.h>
+
+#include <system_error>
+
+#include "PortWatcher.h"
+
+PortWatcher::PortWatcher(EventLoop& loop, Callback callback) :
+    _loop(loop), _callback(callback)
+{
+    _fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (_fd < 0)
+        throw std::system_error(errno, std::system_category(), "inotify_init1");
+
+    _loop.watch(_fd, EventLoop::Readable, [this]() { onReadable(); });
+}
+
+PortWatcher::~PortWatcher()
+{
+    _loop.unwatch(_fd);
+    ::close(_fd);
+}
+
+void
+PortWatcher::watch(const std::string& pattern)
+{
+    std::string dir = pattern.substr(0, pattern.rfind('/'));
+    int wd;
+
+    if (dir.empty())
+        dir = "/";
+
+    // Device nodes are made and removed directly in their directory
+    wd = inotify_add_watch(_fd, dir.c_str(), IN_CREATE | IN_DELETE | IN_MOVED_TO | IN_MOVED_FROM);
+    if (wd < 0)
+        throw std::system_error(errno, std::system_category(), dir);
+
+    _dirs[wd] = dir;
+    _patterns.push_back(pattern);
+}
+
+void
+PortWatcher::onReadable()
+{
+    char buffer[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+    ssize_t size;
+
+    while ((size = ::read(_fd, buffer, sizeof(buffer))) > 0)
+    {
+        for (char* pos = buffer; pos < buffer + size; )
+        {
+            struct inotify_event* event = (struct inotify_event*) pos;
+            std::map<int, std::string>::iterator dir = _dirs.find(event->wd);
+
+            pos += sizeof(struct inotify_event) + event->len;
+            if (dir == _dirs.end() || event->len == 0)
+                continue;
+
+            std::string port = dir->second + "/" + event->name;
+            for (uint32_t pattern = 0; pattern < _patterns.size(); pattern++)
+            {
+                if (fnmatch(_patterns[pattern].c_str(), port.c_str(), FNM_PATHNAME) == 0)
+                {
+                    _callback(port, (event->mask & (IN_CREATE | IN_MOVED_TO)) != 0);
+                    break;
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,64 @@
+///////////////////////////////////////////////////////////////////////////////
+// BOSSA
+//
+// Copyright (c) 2011-2018, ShumaTech
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the <organization> nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+#ifndef _PORTWATCHER_H
+#define _PORTWATCHER_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <functional>
+
+#include "EventLoop.h"
+
+// Reports serial ports appearing and disappearing as they happen
+class PortWatcher
+{
+public:
+    typedef std::function<void(const std::string& port, bool added)> Callback;
+
+    PortWatcher(EventLoop& loop, Callback callback);
+    virtual ~PortWatcher();
+
+    // Watch for ports matching a wildcard pattern such as /dev/ttyACM*
+    void watch(const std::string& pattern);
+
+private:
+    EventLoop& _loop;
+    Callback _callback;
+    int _fd;
+    std::map<int, std::string> _dirs;
+    std::vector<std::string> _patterns;
+
+    void onReadable();
+
+    PortWatcher(const PortWatcher&);
+    PortWatcher& operator=(const PortWatcher&);
+};
+
+#endif // _PORTWATCHER_H
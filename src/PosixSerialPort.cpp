@@ -39,6 +39,10 @@
 
 #include <string>
 
+#if defined(__linux__)
+#include "EventLoop.h"
+#endif
+
 #ifndef B460800
 #define B460800 460800
 #endif
@@ -49,13 +53,15 @@
 PosixSerialPort::PosixSerialPort(const std::string& name, bool isUsb) :
     SerialPort(name), _devfd(-1), _isUsb(isUsb), _timeout(0),
     _autoFlush(false)
+#if defined(__linux__)
+    , _loop(NULL), _readTimer(0)
+#endif
 {
 }
 
 PosixSerialPort::~PosixSerialPort()
 {
-    if (_devfd >= 0)
-        ::close(_devfd);
+    close();
 }
 
 bool
@@ -205,6 +211,16 @@ PosixSerialPort::open(int baud,
 void
 PosixSerialPort::close()
 {
+#if defined(__linux__)
+    if (_loop && _devfd >= 0)
+    {
+        _loop->unwatch(_devfd);
+        if (_readDone)
+            finishRead(-1);
+        if (_writeDone)
+            finishWrite(-1);
+    }
+#endif
     if (_devfd >= 0)
         ::close(_devfd);
     _devfd = -1;
@@ -254,14 +270,44 @@ PosixSerialPort::read(uint8_t* buffer, int len)
 int
 PosixSerialPort::write(const uint8_t* buffer, int len)
 {
+    fd_set fds;
+    struct timeval tv;
+    int numwritten = 0;
+    int retval;
+
     if (_devfd == -1)
         return -1;
 
-    int res = ::write(_devfd, buffer, len);
+    // The port is opened non-blocking, so wait for room whenever the
+    // driver queue is full rather than giving up part way
+    while (numwritten < len)
+    {
+        retval = ::write(_devfd, buffer + numwritten, len - numwritten);
+        if (retval > 0)
+        {
+            numwritten += retval;
+            continue;
+        }
+        if (retval < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+            return -1;
+
+        FD_ZERO(&fds);
+        FD_SET(_devfd, &fds);
+
+        tv.tv_sec  = _timeout / 1000;
+        tv.tv_usec = (_timeout % 1000) * 1000;
+
+        retval = select(_devfd + 1, NULL, &fds, NULL, &tv);
+        if (retval < 0 && errno != EINTR)
+            return -1;
+        else if (retval == 0)
+            break;
+    }
+
     // Used on macos to avoid upload errors
     if (_autoFlush)
         flush();
-    return res;
+    return numwritten;
 }
 
 int
@@ -330,3 +376,118 @@ PosixSerialPort::setAutoFlush(bool autoflush)
 {
     _autoFlush = autoflush;
 }
+
+#if defined(__linux__)
+bool
+PosixSerialPort::attach(EventLoop& loop)
+{
+    _loop = &loop;
+    return true;
+}
+
+void
+PosixSerialPort::readAsync(uint8_t* data, int size, Completion done)
+{
+    if (!_loop || _devfd == -1 || size == 0)
+    {
+        done(read(data, size));
+        return;
+    }
+
+    _readData = data;
+    _readSize = size;
+    _readCount = 0;
+    _readDone = done;
+
+    // Same as a blocking read, the timeout restarts with every chunk
+    _loop->watch(_devfd, EventLoop::Readable, [this]() { onReadable(); });
+    _readTimer = _loop->timer(_timeout, [this]() { onReadTimeout(); });
+}
+
+void
+PosixSerialPort::onReadable()
+{
+    int retval = ::read(_devfd, _readData + _readCount, _readSize - _readCount);
+
+    if (retval < 0)
+    {
+        if (errno != EAGAIN && errno != EINTR)
+            finishRead(-1);
+        return;
+    }
+
+    _readCount += retval;
+    if (_readCount == _readSize)
+    {
+        finishRead(_readCount);
+        return;
+    }
+
+    _loop->cancel(_readTimer);
+    _readTimer = _loop->timer(_timeout, [this]() { onReadTimeout(); });
+}
+
+void
+PosixSerialPort::onReadTimeout()
+{
+    _readTimer = 0;
+    finishRead(_readCount);
+}
+
+void
+PosixSerialPort::finishRead(int result)
+{
+    Completion done = _readDone;
+
+    _loop->unwatch(_devfd, EventLoop::Readable);
+    if (_readTimer)
+        _loop->cancel(_readTimer);
+    _readTimer = 0;
+    _readDone = nullptr;
+    done(result);
+}
+
+void
+PosixSerialPort::writeAsync(const uint8_t* data, int size, Completion done)
+{
+    if (!_loop || _devfd == -1)
+    {
+        done(write(data, size));
+        return;
+    }
+
+    _writeData = data;
+    _writeSize = size;
+    _writeCount = 0;
+    _writeDone = done;
+
+    _loop->watch(_devfd, EventLoop::Writable, [this]() { onWritable(); });
+}
+
+void
+PosixSerialPort::onWritable()
+{
+    int retval = ::write(_devfd, _writeData + _writeCount, _writeSize - _writeCount);
+
+    if (retval < 0)
+    {
+        if (errno != EAGAIN && errno != EINTR)
+            finishWrite(-1);
+        return;
+    }
+
+    _writeCount += retval;
+    if (_writeCount == _writeSize)
+        finishWrite(_writeCount);
+}
+
+void
+PosixSerialPort::finishWrite(int result)
+{
+    Completion done = _writeDone;
+
+    _loop->unwatch(_devfd, EventLoop::Writable);
+    _writeDone = nullptr;
+    done(result);
+}
+#endif
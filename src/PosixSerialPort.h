@@ -50,6 +50,12 @@ public:
     int get();
     int put(int c);
 
+#if defined(__linux__)
+    bool attach(EventLoop& loop);
+    void readAsync(uint8_t* data, int size, Completion done);
+    void writeAsync(const uint8_t* data, int size, Completion done);
+#endif
+
     bool timeout(int millisecs);
     void flush();
     void setDTR(bool dtr);
@@ -61,6 +67,25 @@ private:
     bool _isUsb;
     int _timeout;
     bool _autoFlush;
+
+#if defined(__linux__)
+    EventLoop* _loop;
+    uint8_t* _readData;
+    int _readSize;
+    int _readCount;
+    uint32_t _readTimer;
+    Completion _readDone;
+    const uint8_t* _writeData;
+    int _writeSize;
+    int _writeCount;
+    Completion _writeDone;
+
+    void onReadable();
+    void onReadTimeout();
+    void onWritable();
+    void finishRead(int result);
+    void finishWrite(int result);
+#endif
 };
 
 #endif // _POSIXSERIALPORT_H
@@ -0,0 +1,421 @@
+///////////////////////////////////////////////////////////////////////////////
+// BOSSA
+//
+// Copyright (c) 2011-2018, ShumaTech
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the <organization> nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+#include "PreparedImage.h"
+#include "Flasher.h"
+#include "Checksum.h"
+#include "Lz4Compressor.h"
+#include "FileError.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <atomic>
+
+#if defined(__WIN32__)
+#include <direct.h>
+#define mkdir(path, mode) _mkdir(path)
+#else
+#include <sys/mman.h>
+#endif
+
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
+
+// A prepared image is a header, a table of windows, the journal CRCs of
+// all the windows and then the padded and compressed data that they point
+// to.  Everything is a native word, as the file never leaves the host.
+#define PREPARED_MAGIC      0x4d495042
+#define PREPARED_VERSION    2
+#define PREPARED_NONE       0xffffffff
+
+enum
+{
+    HeaderMagic,
+    HeaderVersion,
+    HeaderSize,
+    HeaderDigest,
+    HeaderPageSize = HeaderDigest + PreparedKey::DigestSize / 4,
+    HeaderUnitSize,
+    HeaderWindowSize,
+    HeaderFlags,
+    HeaderWindows,
+    HeaderCheckpoints,
+    HeaderWords
+};
+
+enum
+{
+    WindowOffset,
+    WindowSize,
+    WindowWriteSize,
+    WindowBlank,
+    WindowPadded,
+    WindowBlock,
+    WindowBlockSize,
+    WindowFirstCheckpoint,
+    WindowCheckpoints,
+    WindowCheck,
+    WindowWords
+};
+
+#define FLAG_PAD            0x1
+#define FLAG_COMPRESS       0x2
+
+PreparedKey::PreparedKey(const uint8_t* data, uint32_t size, uint32_t pageSize, uint32_t unitSize,
+                         uint32_t windowSize, bool pad, bool compress) :
+    size(size), pageSize(pageSize), unitSize(unitSize), windowSize(windowSize), pad(pad), compress(compress)
+{
+    Checksum::sha256(data, size, digest);
+}
+
+std::string
+PreparedKey::name() const
+{
+    std::string name;
+    char text[64];
+
+    for (uint32_t i = 0; i < DigestSize; i++)
+    {
+        snprintf(text, sizeof(text), "%02x", digest[i]);
+        name += text;
+    }
+    snprintf(text, sizeof(text), "-%x-%x-%x-%x-%x.prep", size, pageSize, unitSize,
+             windowSize, (pad ? FLAG_PAD : 0) | (compress ? FLAG_COMPRESS : 0));
+    return name + text;
+}
+
+PreparedImage::PreparedImage(const std::string& path, const PreparedKey& key) :
+    _data(NULL), _size(0), _mapped(false), _numWindows(0)
+{
+    struct stat st;
+    int fd;
+
+    fd = open(path.c_str(), O_RDONLY | O_BINARY);
+    if (fd < 0)
+        throw FileOpenError(errno);
+
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size > 0xffffffffLL)
+    {
+        int errnum = errno;
+        close(fd);
+        throw FileIoError(errnum);
+    }
+    _size = st.st_size;
+
+#if !defined(__WIN32__)
+    if (_size > 0)
+    {
+        void* map = mmap(NULL, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED)
+        {
+            _data = (const uint8_t*) map;
+            _mapped = true;
+        }
+    }
+#endif
+
+    if (!_mapped)
+    {
+        ssize_t got = 0;
+
+        _contents.resize(_size);
+        for (uint32_t done = 0; done < _size; done += got)
+        {
+            got = ::read(fd, &_contents[done], _size - done);
+            if (got <= 0)
+            {
+                int errnum = errno;
+                close(fd);
+                throw FileIoError(got < 0 ? errnum : 0);
+            }
+        }
+        _data = (const uint8_t*) _contents.data();
+    }
+    close(fd);
+
+    try
+    {
+        check(key);
+    }
+    catch (...)
+    {
+#if !defined(__WIN32__)
+        if (_mapped)
+            munmap((void*) _data, _size);
+#endif
+        throw;
+    }
+}
+
+PreparedImage::~PreparedImage()
+{
+#if !defined(__WIN32__)
+    if (_mapped)
+        munmap((void*) _data, _size);
+#endif
+}
+
+void
+PreparedImage::check(const PreparedKey& key)
+{
+    const uint32_t* header = (const uint32_t*) _data;
+    const uint32_t* table;
+    uint64_t payload;
+    uint32_t checkpoints = 0;
+
+    if (_size < HeaderWords * 4 ||
+        header[HeaderMagic] != PREPARED_MAGIC ||
+        header[HeaderVersion] != PREPARED_VERSION ||
+        header[HeaderSize] != key.size ||
+        memcmp(&header[HeaderDigest], key.digest, PreparedKey::DigestSize) != 0 ||
+        header[HeaderPageSize] != key.pageSize ||
+        header[HeaderUnitSize] != key.unitSize ||
+        header[HeaderWindowSize] != key.windowSize ||
+        header[HeaderFlags] != ((key.pad ? FLAG_PAD : 0) | (key.compress ? FLAG_COMPRESS : 0)))
+        throw PreparedImageError();
+
+    _numWindows = header[HeaderWindows];
+    payload = (uint64_t) (HeaderWords + (uint64_t) _numWindows * WindowWords) * 4 +
+        (uint64_t) header[HeaderCheckpoints] * 8;
+    if (payload > _size)
+        throw PreparedImageError();
+
+    // Every window must lie within the extent and point within the file,
+    // so that using one never reads past either
+    table = header + HeaderWords;
+    for (uint32_t index = 0; index < _numWindows; index++)
+    {
+        const uint32_t* window = table + index * WindowWords;
+
+        if ((uint64_t) window[WindowOffset] + window[WindowSize] > key.size ||
+            window[WindowSize] > window[WindowWriteSize] ||
+            window[WindowFirstCheckpoint] != checkpoints ||
+            (window[WindowPadded] != PREPARED_NONE &&
+             payload + window[WindowPadded] + window[WindowWriteSize] > _size) ||
+            (window[WindowPadded] == PREPARED_NONE && window[WindowSize] != window[WindowWriteSize]) ||
+            (window[WindowBlock] != PREPARED_NONE &&
+             payload + window[WindowBlock] + window[WindowBlockSize] > _size))
+            throw PreparedImageError();
+
+        checkpoints += window[WindowCheckpoints];
+    }
+
+    if (checkpoints != header[HeaderCheckpoints])
+        throw PreparedImageError();
+}
+
+bool
+PreparedImage::window(uint32_t index, const uint8_t* data, FlasherWindow& window) const
+{
+    const uint32_t* header = (const uint32_t*) _data;
+    const uint32_t* record = header + HeaderWords + index * WindowWords;
+    const uint32_t* checkpoints = header + HeaderWords + _numWindows * WindowWords;
+    const uint8_t* payload = (const uint8_t*) (checkpoints + header[HeaderCheckpoints] * 2);
+
+    std::vector<uint8_t> decoded;
+    const uint8_t* block = NULL;
+    const uint8_t* written;
+
+    window = FlasherWindow();
+    window.offset = record[WindowOffset];
+
+    // The file may have been damaged since it was checked, so make sure of
+    // the data and the block before anything is sent to the device
+    written = record[WindowPadded] != PREPARED_NONE ? payload + record[WindowPadded] : data + window.offset;
+    if (Checksum::crc32(written, record[WindowWriteSize]) != record[WindowCheck])
+        return false;
+    if (record[WindowBlock] != PREPARED_NONE)
+    {
+        block = payload + record[WindowBlock];
+        decoded.resize(record[WindowWriteSize]);
+        if (!Lz4Compressor::decompress(block, record[WindowBlockSize], &decoded[0], decoded.size()) ||
+            Checksum::crc32(&decoded[0], decoded.size()) != record[WindowCheck])
+            return false;
+    }
+
+    window.size = record[WindowSize];
+    window.writeSize = record[WindowWriteSize];
+    window.blank = record[WindowBlank] != 0;
+
+    window.data = written;
+
+    if (block)
+    {
+        window.block = block;
+        window.blockSize = record[WindowBlockSize];
+    }
+
+    checkpoints += record[WindowFirstCheckpoint] * 2;
+    for (uint32_t point = 0; point < record[WindowCheckpoints]; point++)
+        window.checkpoints.push_back(std::make_pair(checkpoints[point * 2], (uint16_t) checkpoints[point * 2 + 1]));
+
+    return true;
+}
+
+void
+PreparedBuilder::add(const FlasherWindow& window)
+{
+    uint32_t record[WindowWords];
+
+    record[WindowOffset] = window.offset;
+    record[WindowSize] = window.size;
+    record[WindowWriteSize] = window.writeSize;
+    record[WindowBlank] = window.blank;
+    record[WindowPadded] = PREPARED_NONE;
+    record[WindowBlock] = PREPARED_NONE;
+    record[WindowBlockSize] = 0;
+    record[WindowFirstCheckpoint] = _checkpoints.size() / 2;
+    record[WindowCheckpoints] = window.checkpoints.size();
+    record[WindowCheck] = Checksum::crc32(window.data, window.writeSize);
+
+    // Only the padded tail and the compressed blocks need keeping, the
+    // rest of the data is the image itself
+    if (!window.padded.empty())
+    {
+        record[WindowPadded] = _payload.size();
+        _payload.append((const char*) window.data, window.writeSize);
+    }
+    if (window.block)
+    {
+        record[WindowBlock] = _payload.size();
+        record[WindowBlockSize] = window.blockSize;
+        _payload.append((const char*) window.block, window.blockSize);
+    }
+
+    _windows.insert(_windows.end(), record, record + WindowWords);
+    for (uint32_t point = 0; point < window.checkpoints.size(); point++)
+    {
+        _checkpoints.push_back(window.checkpoints[point].first);
+        _checkpoints.push_back(window.checkpoints[point].second);
+    }
+}
+
+void
+PreparedBuilder::save(const std::string& path)
+{
+    static std::atomic<uint32_t> saves(0);
+    uint32_t header[HeaderWords];
+    char suffix[32];
+    std::string temp;
+    FILE* file;
+    bool ok;
+
+    header[HeaderMagic] = PREPARED_MAGIC;
+    header[HeaderVersion] = PREPARED_VERSION;
+    header[HeaderSize] = _key.size;
+    memcpy(&header[HeaderDigest], _key.digest, PreparedKey::DigestSize);
+    header[HeaderPageSize] = _key.pageSize;
+    header[HeaderUnitSize] = _key.unitSize;
+    header[HeaderWindowSize] = _key.windowSize;
+    header[HeaderFlags] = (_key.pad ? FLAG_PAD : 0) | (_key.compress ? FLAG_COMPRESS : 0);
+    header[HeaderWindows] = _windows.size() / WindowWords;
+    header[HeaderCheckpoints] = _checkpoints.size() / 2;
+
+    // Runs and threads writing the same image each write a file of their
+    // own and the last one in wins
+    snprintf(suffix, sizeof(suffix), ".%d.%u.tmp", (int) getpid(), saves++);
+    temp = path + suffix;
+
+    file = fopen(temp.c_str(), "wb");
+    if (!file)
+        throw FileOpenError(errno);
+
+    ok = fwrite(header, sizeof(header), 1, file) == 1;
+    if (ok && !_windows.empty())
+        ok = fwrite(&_windows[0], _windows.size() * 4, 1, file) == 1;
+    if (ok && !_checkpoints.empty())
+        ok = fwrite(&_checkpoints[0], _checkpoints.size() * 4, 1, file) == 1;
+    if (ok && !_payload.empty())
+        ok = fwrite(_payload.data(), _payload.size(), 1, file) == 1;
+
+    if (fclose(file) != 0 || !ok)
+    {
+        int errnum = errno;
+        remove(temp.c_str());
+        throw FileIoError(errnum);
+    }
+
+    if (rename(temp.c_str(), path.c_str()) != 0)
+    {
+        int errnum = errno;
+        remove(temp.c_str());
+        throw FileIoError(errnum);
+    }
+}
+
+PreparedCache::PreparedCache(const std::string& dir) : _dir(dir)
+{
+    mkdir(_dir.c_str(), 0755);
+}
+
+std::shared_ptr<PreparedImage>
+PreparedCache::find(const PreparedKey& key)
+{
+    std::string path = _dir + "/" + key.name();
+
+    try
+    {
+        return std::shared_ptr<PreparedImage>(new PreparedImage(path, key));
+    }
+    catch (PreparedImageError&)
+    {
+        // Left over from another version or cut short, so prepare it again
+        remove(path.c_str());
+    }
+    catch (FileError&)
+    {
+    }
+
+    return std::shared_ptr<PreparedImage>();
+}
+
+void
+PreparedCache::store(const PreparedKey& key, PreparedBuilder& builder)
+{
+    // The write goes ahead whether or not the cache can keep the result
+    try
+    {
+        builder.save(_dir + "/" + key.name());
+    }
+    catch (FileError&)
+    {
+    }
+}
+
+void
+PreparedCache::discard(const PreparedKey& key)
+{
+    remove((_dir + "/" + key.name()).c_str());
+}
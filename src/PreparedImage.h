@@ -0,0 +1,136 @@
+///////////////////////////////////////////////////////////////////////////////
+// BOSSA
+//
+// Copyright (c) 2011-2018, ShumaTech
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the <organization> nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+#ifndef _PREPAREDIMAGE_H
+#define _PREPAREDIMAGE_H
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <exception>
+
+class FlasherWindow;
+
+class PreparedImageError : public std::exception
+{
+public:
+    PreparedImageError() : std::exception() {}
+    virtual const char* what() const throw() { return "Prepared image is invalid"; }
+};
+
+// What a prepared image is looked up by: a SHA-256 digest of the extent
+// and the flash geometry and transfer windows that it was prepared for
+class PreparedKey
+{
+public:
+    PreparedKey(const uint8_t* data, uint32_t size, uint32_t pageSize, uint32_t unitSize,
+                uint32_t windowSize, bool pad, bool compress);
+
+    // The file name of the prepared image in a cache
+    std::string name() const;
+
+    static const uint32_t DigestSize = 32;
+
+    uint32_t size;
+    uint8_t digest[DigestSize];
+    uint32_t pageSize;
+    uint32_t unitSize;
+    uint32_t windowSize;
+    bool pad;
+    bool compress;
+};
+
+// An extent already split into windows, with its padding, blank windows,
+// journal CRCs and compressed blocks worked out.  The file is mapped and
+// the windows point straight into it, so nothing is copied to use it.
+class PreparedImage
+{
+public:
+    PreparedImage(const std::string& path, const PreparedKey& key);
+    virtual ~PreparedImage();
+
+    uint32_t windows() const { return _numWindows; }
+
+    // Fill in a window of the extent with its data from the image, or
+    // from the file where it was padded.  Returns false if the data or its
+    // compressed block no longer match the CRC recorded for the window, in
+    // which case only the window offset is filled in.
+    bool window(uint32_t index, const uint8_t* data, FlasherWindow& window) const;
+
+private:
+    const uint8_t* _data;
+    uint32_t _size;
+    bool _mapped;
+    std::string _contents;
+    uint32_t _numWindows;
+
+    void check(const PreparedKey& key);
+
+    PreparedImage(const PreparedImage&);
+    PreparedImage& operator=(const PreparedImage&);
+};
+
+// Collects the windows of an extent as they are prepared for a write so
+// that the next write of the same extent can use them
+class PreparedBuilder
+{
+public:
+    PreparedBuilder(const PreparedKey& key) : _key(key) {}
+    virtual ~PreparedBuilder() {}
+
+    void add(const FlasherWindow& window);
+    void save(const std::string& path);
+
+private:
+    PreparedKey _key;
+    std::vector<uint32_t> _windows;
+    std::vector<uint32_t> _checkpoints;
+    std::string _payload;
+};
+
+// A directory of prepared images shared by every run that writes them,
+// holding one file for each extent and flash geometry
+class PreparedCache
+{
+public:
+    PreparedCache(const std::string& dir);
+    virtual ~PreparedCache() {}
+
+    // The prepared image for the key, or none if it has not been prepared
+    std::shared_ptr<PreparedImage> find(const PreparedKey& key);
+    void store(const PreparedKey& key, PreparedBuilder& builder);
+    // Drop a prepared image found to be damaged
+    void discard(const PreparedKey& key);
+
+private:
+    std::string _dir;
+};
+
+#endif // _PREPAREDIMAGE_H
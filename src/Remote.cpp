@@ -0,0 +1,80 @@
+///////////////////////////////////////////////////////////////////////////////
+// BOSSA
+//
+// Copyright (c) 2011-2018, ShumaTech
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the <organization> nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "Remote.h"
+
+std::string
+Remote::defaultSocket()
+{
+    const char* runtime = getenv("XDG_RUNTIME_DIR");
+
+    if (runtime && *runtime)
+        return std::string(runtime) + "/bossad.socket";
+
+#if defined(__WIN32__)
+    return std::string("bossad.socket");
+#else
+    char path[64];
+
+    snprintf(path, sizeof(path), "/tmp/bossad-%u.socket", (unsigned) getuid());
+    return std::string(path);
+#endif
+}
+
+std::string
+Remote::frame(Frame type, const std::string& payload)
+{
+    char header[24];
+
+    snprintf(header, sizeof(header), "%c %zu\n", (char) type, payload.size());
+    return header + payload;
+}
+
+bool
+Remote::parse(std::string& buffer, Frame& type, std::string& payload)
+{
+    size_t end = buffer.find('\n');
+    size_t size;
+
+    if (end == std::string::npos || end < 2)
+        return false;
+
+    size = strtoul(buffer.c_str() + 2, NULL, 10);
+    if (buffer.size() < end + 1 + size)
+        return false;
+
+    type = (Frame) buffer[0];
+    payload = buffer.substr(end + 1, size);
+    buffer.erase(0, end + 1 + size);
+
+    return true;
+}
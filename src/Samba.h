@@ -87,7 +87,12 @@ public:
     bool canChecksumBuffer() { return _canChecksumBuffer; }
     uint16_t checksumBuffer(uint32_t start_addr, uint32_t size);
     uint32_t checksumBufferSize() { return 4096; }
-    uint16_t checksumCalc(uint8_t c, uint16_t crc);
+    static uint16_t checksumCalc(uint8_t c, uint16_t crc);
+    static uint16_t checksumCalc(const uint8_t* data, uint32_t size, uint16_t crc = 0);
+
+    // Rough throughput of the link in bytes per millisecond
+    uint32_t linkRate();
+    bool isUsb() { return _isUsb; }
 
 private:
     bool _canChipErase;
@@ -96,6 +101,7 @@ private:
     int _readBufferSize;
     bool _debug;
     bool _isUsb;
+    int _bps;
     SerialPort::Ptr _port;
 
     bool init();
@@ -31,8 +31,11 @@
 
 #include <string>
 #include <memory>
+#include <functional>
 #include <stdint.h>
 
+class EventLoop;
+
 class SerialPort
 {
 public:
@@ -66,6 +69,14 @@ public:
     virtual int get() = 0;
     virtual int put(int c) = 0;
 
+    // Transfers that finish on an event loop instead of blocking.  The
+    // completion gets the same result as read or write.  Ports that are
+    // not attached to a loop finish the transfer before returning.
+    typedef std::function<void(int result)> Completion;
+    virtual bool attach(EventLoop& loop) { return false; }
+    virtual void readAsync(uint8_t* data, int size, Completion done) { done(read(data, size)); }
+    virtual void writeAsync(const uint8_t* data, int size, Completion done) { done(write(data, size)); }
+
     virtual bool timeout(int millisecs) = 0;
     virtual void flush() = 0;
     virtual void setDTR(bool dtr) = 0;
@@ -0,0 +1,823 @@
+///////////////////////////////////////////////////////////////////////////////
+// BOSSA
+//
+// Copyright (c) 2011-2018, ShumaTech
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the <organization> nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+#include <string>
+#include <exception>
+#include <stdio.h>
+#include <unistd.h>
+#include <memory>
+#include <algorithm>
+
+#if !defined(__WIN32__)
+#include <glob.h>
+#endif
+
+#include "Session.h"
+#include "PortFactory.h"
+#include "Device.h"
+#include "Journal.h"
+#include "ContentMap.h"
+#include "PreparedImage.h"
+#include "PatchFile.h"
+
+#if defined(__linux__)
+#include "Fiber.h"
+#include "FiberSerialPort.h"
+#include "PortWatcher.h"
+#endif
+
+using namespace std;
+
+BossaConfig::BossaConfig()
+{
+    erase = false;
+    write = false;
+    read = false;
+    verify = false;
+    offset = false;
+    port = false;
+    boot = false;
+    bod = false;
+    bor = false;
+    lock = false;
+    unlock = false;
+    security = false;
+    info = false;
+    debug = false;
+    usbPort = false;
+    arduinoErase = false;
+    resume = false;
+    resetWait = false;
+    diff = false;
+    manifest = false;
+    verifyLog = false;
+    cache = false;
+    plan = false;
+    patch = false;
+    family = false;
+    link = false;
+    station = false;
+    remote = false;
+    help = false;
+    version = false;
+
+    readArg = 0;
+    offsetArg = 0;
+    bootArg = 1;
+    bodArg = 1;
+    borArg = 1;
+    usbPortArg=1;
+    resetWaitArg = 5000;
+
+    reset = false;
+}
+
+void
+BossaConfig::options(std::vector<Option>& opts)
+{
+    Option table[] =
+    {
+        {
+          'e', "erase", &erase,
+          { ArgNone },
+          "erase the entire flash starting at the offset"
+        },
+        {
+          'w', "write", &write,
+          { ArgNone },
+          "write FILE to the flash; accelerated when\n"
+          "combined with erase option; Intel HEX, ELF\n"
+          "and UF2 files are written at their addresses,\n"
+          "anything else is taken as a binary; a FILE\n"
+          "of - is a binary streamed from stdin"
+        },
+        {
+          'r', "read", &read,
+          { ArgOptional, ArgInt, "SIZE", { &readArg } },
+          "read SIZE from flash and store in FILE;\n"
+          "read entire flash if SIZE not specified"
+        },
+        {
+          'v', "verify", &verify,
+          { ArgNone },
+          "verify FILE matches flash contents"
+        },
+        {
+          'o', "offset", &offset,
+          { ArgRequired, ArgInt, "OFFSET", { &offsetArg } },
+          "start erase/write/read/verify operation at flash OFFSET;\n"
+          "OFFSET must be aligned to a flash page boundary"
+        },
+        {
+          'p', "port", &port,
+          { ArgRequired, ArgStringList, "PORT", { &portArg } },
+          "use serial PORT to communicate to device;\n"
+          "default behavior is to use the first serial port,\n"
+          "preferring known bootloaders;\n"
+          "program several devices at once by repeating\n"
+          "the option or giving a comma-separated list\n"
+          "or wildcard pattern"
+        },
+        {
+          'b', "boot", &boot,
+          { ArgOptional, ArgInt, "BOOL", { &bootArg } },
+          "boot from ROM if BOOL is 0;\n"
+          "boot from FLASH if BOOL is 1 [default];\n"
+          "option is ignored on unsupported devices"
+        },
+        {
+          'c', "bod", &bod,
+          { ArgOptional, ArgInt, "BOOL", { &bodArg } },
+          "no brownout detection if BOOL is 0;\n"
+          "brownout detection is on if BOOL is 1 [default]"
+        },
+        {
+          't', "bor", &bor,
+          { ArgOptional, ArgInt, "BOOL", { &borArg } },
+          "no brownout reset if BOOL is 0;\n"
+          "brownout reset is on if BOOL is 1 [default]"
+        },
+        {
+          'l', "lock", &lock,
+          { ArgOptional, ArgString, "REGION", { &lockArg } },
+          "lock the flash REGION as a comma-separated list;\n"
+          "lock all if not given [default]"
+        },
+        {
+          'u', "unlock", &unlock,
+          { ArgOptional, ArgString, "REGION", { &unlockArg } },
+          "unlock the flash REGION as a comma-separated list;\n"
+          "unlock all if not given [default]"
+        },
+        {
+          's', "security", &security,
+          { ArgNone },
+          "set the flash security flag"
+        },
+        {
+          'i', "info", &info,
+          { ArgNone },
+          "display device information"
+        },
+        {
+          'd', "debug", &debug,
+          { ArgNone },
+          "print debug messages"
+        },
+        {
+          'U', "usb-port", &usbPort,
+          { ArgOptional, ArgInt, "BOOL", { &usbPortArg } },
+          "force serial port detection to USB if BOOL is 1 [default]\n"
+          "or to RS-232 if BOOL is 0"
+        },
+        {
+          'R', "reset", &reset,
+          { ArgNone },
+          "reset CPU (if supported)"
+        },
+        {
+          'a', "arduino-erase", &arduinoErase,
+          { ArgNone },
+          "erase and reset via Arduino 1200 baud hack"
+        },
+        {
+          0, "reset-wait", &resetWait,
+          { ArgRequired, ArgInt, "MSEC", { &resetWaitArg } },
+          "wait up to MSEC for the bootloader to come back\n"
+          "after an Arduino reset [default 5000]"
+        },
+        {
+          0, "resume", &resume,
+          { ArgNone },
+          "journal the write and resume one that was\n"
+          "interrupted from its last verified erase unit"
+        },
+        {
+          0, "diff", &diff,
+          { ArgNone },
+          "write the file reusing any blocks of it that\n"
+          "are already in flash, even if they have moved"
+        },
+        {
+          0, "verify-log", &verifyLog,
+          { ArgRequired, ArgString, "FILE", { &verifyLogArg } },
+          "write every mismatch of a failed verify to FILE\n"
+          "as JSON"
+        },
+        {
+          0, "cache", &cache,
+          { ArgRequired, ArgString, "DIR", { &cacheArg } },
+          "keep images prepared for the flash in DIR so\n"
+          "that writing them again is quicker"
+        },
+        {
+          0, "patch", &patch,
+          { ArgRequired, ArgString, "FILE", { &patchArg } },
+          "lay the records on the next line of FILE over\n"
+          "the image, a line for each device programmed,\n"
+          "counting the lines used in FILE.next"
+        },
+        {
+          0, "plan", &plan,
+          { ArgNone },
+          "show the steps of the erase, write and verify\n"
+          "and how long they should take, without running\n"
+          "them"
+        },
+        {
+          0, "family", &family,
+          { ArgRequired, ArgString, "NAME", { &familyArg } },
+          "plan for a typical device of family NAME, such\n"
+          "as samd21 or same70, with no device connected"
+        },
+        {
+          0, "link", &link,
+          { ArgRequired, ArgString, "PROFILE", { &linkArg } },
+          "plan for a link of PROFILE, usb or the baud\n"
+          "rate of an RS-232 port"
+        },
+        {
+          0, "manifest", &manifest,
+          { ArgNone },
+          "FILE is a manifest of images, offsets and the\n"
+          "options to set, all written in one session"
+        },
+        {
+          0, "station", &station,
+          { ArgNone },
+          "keep running and program each device as it is\n"
+          "plugged in on a port matching PORT; the default\n"
+          "is any ttyACM or ttyUSB port"
+        },
+        {
+          0, "remote", &remote,
+          { ArgOptional, ArgString, "SOCKET", { &remoteArg } },
+          "run the job on the bossad daemon listening on\n"
+          "SOCKET instead of in this process"
+        },
+        {
+          'h', "help", &help,
+          { ArgNone },
+          "display this help text"
+        },
+        {
+          'V', "version", &version,
+          { ArgNone },
+          "display version info"
+        },
+    };
+
+    opts.assign(table, table + sizeof(table) / sizeof(table[0]));
+}
+
+void
+timer_start(struct timeval& start)
+{
+    gettimeofday(&start, NULL);
+}
+
+float
+timer_stop(struct timeval& start)
+{
+    struct timeval end;
+    gettimeofday(&end, NULL);
+    return (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1000000.0;
+}
+
+// A session running on a fiber has its port wait on the fiber's event loop
+static SerialPort::Ptr
+createPort(const BossaConfig& config, PortFactory& portFactory, const std::string& name)
+{
+    SerialPort::Ptr port;
+
+    if (config.usbPort)
+        port = portFactory.create(name, config.usbPortArg != 0);
+    else
+        port = portFactory.create(name);
+
+#if defined(__linux__)
+    if (Fiber::current())
+        port = SerialPort::Ptr(new FiberSerialPort(Fiber::current()->loop(), std::move(port)));
+#endif
+
+    return port;
+}
+
+#if defined(__linux__)
+// How long a touched port has to drop off the bus before it is taken to
+// have stayed put, as the ports of USB to serial bridges do
+#define RESET_GONE      1000
+
+// How often a port that has come back is tried until udev lets us open it
+#define RESET_READY     10
+#endif
+
+// Touch the port at 1200 baud so that the sketch resets into its bootloader
+// and return the port that the bootloader answers on, or an empty string if
+// it did not come back in time
+static std::string
+arduinoReset(const BossaConfig& config, const std::string& portName, SessionObserver& observer)
+{
+    PortFactory portFactory;
+    SerialPort::Ptr port = portFactory.create(portName, config.usbPortArg != 0);
+
+#if defined(__linux__)
+    Fiber* fiber = Fiber::current();
+    std::unique_ptr<EventLoop> ownLoop;
+    EventLoop* loop;
+    LinuxPortInfo before;
+    std::vector<uint32_t> timers;
+    std::string found;
+    bool waiting = true;
+    bool gone = false;
+
+    // A session on a fiber waits on its loop, otherwise it runs one
+    if (fiber)
+    {
+        loop = &fiber->loop();
+    }
+    else
+    {
+        ownLoop.reset(new EventLoop());
+        loop = ownLoop.get();
+    }
+
+    // The USB serial number finds the board whatever name it comes back as
+    if (!portFactory.info(portName, before) || !before.isUsb)
+        before.serial.clear();
+
+    std::function<void()> done = [&]()
+    {
+        if (!waiting)
+            return;
+        waiting = false;
+        if (fiber)
+            fiber->resume();
+        else
+            loop->stop();
+    };
+
+    std::function<void(const std::string&)> ready = [&](const std::string& name)
+    {
+        if (!waiting)
+            return;
+
+        if (access(name.c_str(), R_OK | W_OK) == 0)
+        {
+            found = name;
+            done();
+        }
+        else
+        {
+            timers.push_back(loop->timer(RESET_READY, [&, name]() { ready(name); }));
+        }
+    };
+
+    // Watch before the touch so that a quick return is not missed
+    PortWatcher watcher(*loop, [&](const std::string& name, bool added)
+    {
+        LinuxPortInfo info;
+
+        if (!added)
+        {
+            if (name == portName)
+                gone = true;
+            return;
+        }
+
+        if (before.serial.empty())
+        {
+            if (name != portName)
+                return;
+        }
+        else if (!portFactory.info(name, info) || info.vid != before.vid || info.serial != before.serial)
+        {
+            return;
+        }
+
+        ready(name);
+    });
+    watcher.watch(portName);
+    watcher.watch("/dev/ttyACM*");
+    watcher.watch("/dev/ttyUSB*");
+#endif
+
+    observer.onStatus("Arduino 1200 baud reset\n");
+    if(!port->open(1200))
+    {
+        observer.onError("Failed to open port at 1200bps\n");
+        return std::string();
+    }
+
+    port->setRTS(true);
+    port->setDTR(false);
+    port->close();
+
+#if defined(__linux__)
+    timers.push_back(loop->timer(RESET_GONE, [&]()
+    {
+        if (!gone)
+        {
+            found = portName;
+            done();
+        }
+    }));
+    timers.push_back(loop->timer(config.resetWaitArg, done));
+
+    if (fiber)
+        Fiber::yield();
+    else
+        loop->run();
+
+    for (uint32_t timer = 0; timer < timers.size(); timer++)
+        loop->cancel(timers[timer]);
+
+    if (found.empty())
+        observer.onError("No bootloader appeared within %d ms of the reset\n", config.resetWaitArg);
+
+    return found;
+#else
+    // wait for chip to reboot and USB port to re-appear
+    sleep(1);
+
+    return portName;
+#endif
+}
+
+// Show where the flash differs from the image, keeping all of it in the
+// report file if there is one
+static int
+verifyFailed(const BossaConfig& config, Flasher& flasher, SessionObserver& observer,
+             uint32_t pageErrors, uint32_t totalErrors)
+{
+    observer.onStatus("\nVerify failed\nPage errors: %d\nByte errors: %d\n", pageErrors, totalErrors);
+    flasher.mismatches().summary(observer);
+
+    if (config.verifyLog)
+    {
+        try
+        {
+            flasher.mismatches().write(config.verifyLogArg);
+            observer.onStatus("Mismatches written to %s\n", config.verifyLogArg.c_str());
+        }
+        catch (std::exception& e)
+        {
+            observer.onError("Unable to write %s: %s\n", config.verifyLogArg.c_str(), e.what());
+        }
+    }
+
+    return 2;
+}
+
+int
+runSession(const BossaConfig& config, const std::string& portName, ImageFuture imageFuture, const char* filename,
+           SessionObserver& observer, bool gang, PatchFile* patches)
+{
+    struct timeval start;
+
+    try
+    {
+        Samba samba;
+        PortFactory portFactory;
+
+        if (config.debug)
+            samba.setDebug(true);
+
+        // The bootloader can come back on another port after a reset
+        std::string bootPort(portName);
+
+        if (config.arduinoErase)
+        {
+            // The bootloader erases the flash on an Arduino reset, so make
+            // sure that the image loads before doing one
+            if (imageFuture.valid())
+                imageFuture.get();
+
+            bootPort = arduinoReset(config, portName, observer);
+            if (bootPort.empty())
+                return 1;
+
+            if (config.debug)
+                observer.onStatus("Arduino reset done, bootloader on %s\n", bootPort.c_str());
+        }
+
+        if (bootPort.empty())
+        {
+            observer.onError("No serial ports available\n");
+            return 1;
+        }
+
+        if (!samba.connect(createPort(config, portFactory, bootPort)))
+        {
+            observer.onError("No device found on %s\n", bootPort.c_str());
+            return 1;
+        }
+        observer.onConnect(samba);
+
+        Device device(samba);
+        device.create();
+
+        Device::FlashPtr& flash = device.getFlash();
+
+        ImageSource* image = imageFuture.valid() ? imageFuture.get().get() : NULL;
+        if (image && image->addressed() && (config.diff || config.resume))
+        {
+            observer.onError("The diff and resume options need a binary image, not %s\n", image->formatName());
+            return 1;
+        }
+
+        if (config.plan)
+        {
+            PlanLink link(samba);
+
+            if (config.link)
+                PlanLink::find(config.linkArg, link);
+            return runPlan(config, samba, device, PlanTarget(samba, device), link, image, observer, patches);
+        }
+
+        Flasher flasher(samba, device, observer);
+
+        if (config.info)
+        {
+            FlasherInfo info;
+            flasher.info(info);
+            info.print();
+        }
+
+        if (config.unlock)
+            flasher.lock(config.unlockArg, false);
+
+        std::unique_ptr<ContentMap> contentMap;
+        if (config.write && config.diff && !flash->getUniqueId().empty())
+        {
+            contentMap.reset(new ContentMap(flash->getUniqueId()));
+
+            // The bootloader erased the flash behind our back
+            if (config.arduinoErase)
+            {
+                contentMap->forget(0, flash->totalSize());
+                contentMap->save();
+            }
+            flasher.setContentMap(contentMap.get());
+        }
+
+        std::unique_ptr<PreparedCache> preparedCache;
+        if (config.cache && config.write && image)
+        {
+            preparedCache.reset(new PreparedCache(config.cacheArg));
+            flasher.setPreparedCache(preparedCache.get());
+        }
+
+        // A unit takes its records before anything is erased and keeps them
+        // even if it fails, so that they are never given out twice
+        if (patches)
+        {
+            std::vector<ImagePatch> unitPatches;
+            uint32_t unit;
+
+            if (!patches->next(unitPatches, unit))
+            {
+                observer.onError("Every unit in %s has been used\n", patches->name().c_str());
+                return 1;
+            }
+            observer.onStatus("Unit %u of %u in %s\n", unit, patches->units(), patches->name().c_str());
+            flasher.setPatches(unitPatches);
+        }
+
+        // Only a resumable write keeps a journal, which costs a checksum
+        // and a file update for every erase unit
+        std::unique_ptr<Journal> journal;
+        uint32_t resumeOffset = 0;
+
+        if (config.resume && config.write && !gang && !patches && image && !image->addressed())
+        {
+            journal.reset(new Journal(portName, *image, config.offsetArg, flash->getUniqueId()));
+            resumeOffset = flasher.resume(*image, *journal, config.offsetArg);
+        }
+
+        if (config.erase)
+        {
+            timer_start(start);
+            flasher.erase(config.offsetArg + resumeOffset);
+            observer.onStatus("\nDone in %5.3f seconds\n", timer_stop(start));
+        }
+
+        // Without an image the file is a stream on stdin
+        if (config.write && !image)
+        {
+            uint32_t pageErrors;
+            uint32_t totalErrors;
+
+            timer_start(start);
+            if (!flasher.writeStream(STDIN_FILENO, pageErrors, totalErrors, config.offsetArg, config.verify))
+            {
+                return verifyFailed(config, flasher, observer, pageErrors, totalErrors);
+            }
+
+            observer.onStatus("%sDone in %5.3f seconds\n", config.verify ? "Verify successful\n" : "",
+                              timer_stop(start));
+        }
+        else if (config.write && config.diff)
+        {
+            timer_start(start);
+            flasher.writeDiff(*image, config.offsetArg);
+            observer.onStatus("\nDone in %5.3f seconds\n", timer_stop(start));
+        }
+        else if (config.write && config.verify)
+        {
+            uint32_t pageErrors;
+            uint32_t totalErrors;
+
+            timer_start(start);
+            if (!flasher.writeVerify(*image, pageErrors, totalErrors, config.offsetArg, journal.get()))
+            {
+                return verifyFailed(config, flasher, observer, pageErrors, totalErrors);
+            }
+
+            observer.onStatus("\nVerify successful\nDone in %5.3f seconds\n", timer_stop(start));
+        }
+        else if (config.write)
+        {
+            timer_start(start);
+            flasher.write(*image, config.offsetArg, journal.get());
+            observer.onStatus("\nDone in %5.3f seconds\n", timer_stop(start));
+        }
+
+        if (config.verify && (!config.write || config.diff))
+        {
+            uint32_t pageErrors;
+            uint32_t totalErrors;
+
+            timer_start(start);
+            if (!flasher.verify(*image, pageErrors, totalErrors, config.offsetArg))
+            {
+                return verifyFailed(config, flasher, observer, pageErrors, totalErrors);
+            }
+
+            observer.onStatus("\nVerify successful\nDone in %5.3f seconds\n", timer_stop(start));
+        }
+
+        if (config.read)
+        {
+            timer_start(start);
+            flasher.read(filename, config.readArg, config.offsetArg);
+            observer.onStatus("\nDone in %5.3f seconds\n", timer_stop(start));
+        }
+
+        if (config.boot)
+        {
+            observer.onStatus("Set boot flash %s\n", config.bootArg ? "true" : "false");
+            flash->setBootFlash(config.bootArg);
+        }
+
+        if (config.bod)
+        {
+            observer.onStatus("Set brownout detect %s\n", config.bodArg ? "true" : "false");
+            flash->setBod(config.bodArg);
+        }
+
+        if (config.bor)
+        {
+            observer.onStatus("Set brownout reset %s\n", config.borArg ? "true" : "false");
+            flash->setBor(config.borArg);
+        }
+
+        if (config.security)
+        {
+            observer.onStatus("Set security\n");
+            flash->setSecurity();
+        }
+
+        if (config.lock)
+            flasher.lock(config.lockArg, true);
+
+        flash->writeOptions();
+
+        if (config.reset)
+            device.reset();
+    }
+    catch (exception& e)
+    {
+        observer.onError("\n%s\n", e.what());
+        return 1;
+    }
+    catch(...)
+    {
+        observer.onError("\nUnhandled exception\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+int
+runPlan(const BossaConfig& config, Samba& samba, Device& device, const PlanTarget& target, const PlanLink& link,
+        ImageSource* image, SessionObserver& observer, PatchFile* patches)
+{
+    try
+    {
+        Plan plan(samba, device, target, link, observer);
+
+        if (patches)
+        {
+            std::vector<ImagePatch> unitPatches;
+            uint32_t unit;
+
+            if (!patches->peek(unitPatches, unit))
+            {
+                observer.onError("Every unit in %s has been used\n", patches->name().c_str());
+                return 1;
+            }
+            observer.onStatus("Unit %u of %u in %s\n", unit, patches->units(), patches->name().c_str());
+            plan.setPatches(unitPatches);
+        }
+
+        if (config.erase)
+            plan.erase(config.offsetArg);
+        if (config.write)
+            plan.write(*image, config.offsetArg, config.verify);
+        else if (config.verify)
+            plan.verify(*image, config.offsetArg);
+
+        plan.print();
+    }
+    catch (exception& e)
+    {
+        observer.onError("\n%s\n", e.what());
+        return 1;
+    }
+
+    return 0;
+}
+
+// Split the port arguments on commas and expand any wildcards
+bool
+expandPorts(const char* program, const vector<string>& args, vector<string>& ports, bool expand)
+{
+    for (uint32_t arg = 0; arg < args.size(); arg++)
+    {
+        size_t pos = 0;
+        size_t delim;
+        string name;
+
+        do
+        {
+            delim = args[arg].find(',', pos);
+            name = args[arg].substr(pos, delim - pos);
+            pos = delim + 1;
+
+            if (name.empty())
+                continue;
+
+#if !defined(__WIN32__)
+            if (expand && name.find_first_of("*?[") != string::npos)
+            {
+                glob_t matches;
+
+                if (glob(name.c_str(), 0, NULL, &matches) != 0)
+                {
+                    fprintf(stderr, "%s: no ports match %s\n", program, name.c_str());
+                    globfree(&matches);
+                    return false;
+                }
+                for (size_t match = 0; match < matches.gl_pathc; match++)
+                    ports.push_back(matches.gl_pathv[match]);
+                globfree(&matches);
+                continue;
+            }
+#endif
+            ports.push_back(name);
+        } while (delim != string::npos);
+    }
+
+    // The same device twice would fight over the port
+    sort(ports.begin(), ports.end());
+    ports.erase(unique(ports.begin(), ports.end()), ports.end());
+
+    return true;
+}
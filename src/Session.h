@@ -0,0 +1,138 @@
+///////////////////////////////////////////////////////////////////////////////
+// BOSSA
+//
+// Copyright (c) 2011-2018, ShumaTech
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the <organization> nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+#ifndef _SESSION_H
+#define _SESSION_H
+
+#include <sys/time.h>
+
+#include <string>
+#include <vector>
+
+#include "CmdOpts.h"
+#include "Samba.h"
+#include "Flasher.h"
+#include "ImageSource.h"
+#include "Plan.h"
+
+class PatchFile;
+
+class BossaConfig
+{
+public:
+    BossaConfig();
+    virtual ~BossaConfig() {}
+
+    // The command line options, filling in this config as they are parsed
+    void options(std::vector<Option>& opts);
+
+    bool erase;
+    bool write;
+    bool read;
+    bool verify;
+    bool offset;
+    bool reset;
+    bool port;
+    bool boot;
+    bool bor;
+    bool bod;
+    bool lock;
+    bool unlock;
+    bool security;
+    bool info;
+    bool debug;
+    bool usbPort;
+    bool arduinoErase;
+    bool resetWait;
+    bool resume;
+    bool diff;
+    bool manifest;
+    bool verifyLog;
+    bool cache;
+    bool plan;
+    bool patch;
+    bool family;
+    bool link;
+    bool station;
+    bool remote;
+    bool help;
+    bool version;
+
+    int readArg;
+    int offsetArg;
+    std::vector<std::string> portArg;
+    int bootArg;
+    int bodArg;
+    int borArg;
+    std::string lockArg;
+    std::string unlockArg;
+    std::string remoteArg;
+    std::string verifyLogArg;
+    std::string cacheArg;
+    std::string familyArg;
+    std::string linkArg;
+    std::string patchArg;
+    int usbPortArg;
+    int resetWaitArg;
+};
+
+// Where one programming session reports to
+class SessionObserver : public FlasherObserver
+{
+public:
+    SessionObserver() {}
+    virtual ~SessionObserver() {}
+
+    virtual void onError(const char *message, ...) = 0;
+
+    // Called once the device on the port has answered
+    virtual void onConnect(Samba& samba) {}
+};
+
+// Run everything in the config against the device on one port and return
+// the exit status.  The image is only waited for once the device has been
+// connected.  Sessions that are part of a gang do not journal.  With a
+// patch file the device takes the records of the next unit in it.
+int runSession(const BossaConfig& config, const std::string& portName, ImageFuture imageFuture, const char* filename,
+               SessionObserver& observer, bool gang, PatchFile* patches = NULL);
+
+// Print the plan of the erase, write and verify in the config for the
+// target and link, without running any of it, and return the exit status.
+// With a patch file the plan lays over the records of the next unit.
+int runPlan(const BossaConfig& config, Samba& samba, Device& device, const PlanTarget& target, const PlanLink& link,
+            ImageSource* image, SessionObserver& observer, PatchFile* patches = NULL);
+
+// Split port arguments on commas and expand any wildcards, reporting
+// problems against the program name
+bool expandPorts(const char* program, const std::vector<std::string>& args, std::vector<std::string>& ports,
+                 bool expand = true);
+
+void timer_start(struct timeval& start);
+float timer_stop(struct timeval& start);
+
+#endif // _SESSION_H
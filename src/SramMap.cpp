@@ -0,0 +1,126 @@
+///////////////////////////////////////////////////////////////////////////////
+// BOSSA
+//
+// Copyright (c) 2011-2018, ShumaTech
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the <organization> nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+#include "SramMap.h"
+
+SramMap&
+SramMap::reserve(uint32_t start, uint32_t size)
+{
+    Area area = { start, size };
+
+    _reserved.push_back(area);
+
+    return *this;
+}
+
+void
+SramMap::largestFree(uint32_t& start, uint32_t& size) const
+{
+    uint32_t end = _start + _size;
+    uint32_t addr = _start;
+
+    start = _start;
+    size = 0;
+
+    // Walk up from the bottom of SRAM, each time jumping past the lowest
+    // reserved area that is still ahead
+    while (addr < end)
+    {
+        uint32_t next = end;
+        uint32_t skip = end;
+
+        for (uint32_t i = 0; i < _reserved.size(); i++)
+        {
+            const Area& area = _reserved[i];
+
+            if (area.start + area.size <= addr)
+                continue;
+            if (area.start <= addr)
+            {
+                next = addr;
+                skip = area.start + area.size;
+                break;
+            }
+            if (area.start < next)
+            {
+                next = area.start;
+                skip = area.start + area.size;
+            }
+        }
+
+        if (next - addr > size)
+        {
+            start = addr;
+            size = next - addr;
+        }
+
+        addr = skip;
+    }
+}
+
+SramPlan::SramPlan(const SramMap& map)
+{
+    uint32_t start;
+    uint32_t size;
+
+    map.largestFree(start, size);
+
+    // Cortex-M0+ cannot do unaligned word accesses
+    _bottom = (start + 3) & ~3;
+    _top = (start + size) & ~7;
+    if (_top < _bottom)
+        _top = _bottom;
+}
+
+uint32_t
+SramPlan::alloc(uint32_t size)
+{
+    uint32_t addr = _bottom;
+
+    size = (size + 3) & ~3;
+    if (size > free())
+        throw SramPlanError();
+
+    _bottom += size;
+
+    return addr;
+}
+
+uint32_t
+SramPlan::allocStack(uint32_t size)
+{
+    uint32_t stack = _top;
+
+    size = (size + 7) & ~7;
+    if (size > free())
+        throw SramPlanError();
+
+    _top -= size;
+
+    return stack;
+}
@@ -0,0 +1,88 @@
+///////////////////////////////////////////////////////////////////////////////
+// BOSSA
+//
+// Copyright (c) 2011-2018, ShumaTech
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the <organization> nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+#ifndef _SRAMMAP_H
+#define _SRAMMAP_H
+
+#include <stdint.h>
+#include <vector>
+#include <exception>
+
+class SramPlanError : public std::exception
+{
+public:
+    SramPlanError() : exception() {};
+    const char* what() const throw() { return "Not enough SRAM for the applets and buffers"; }
+};
+
+// Describes the SRAM of a device along with the areas the bootloader
+// keeps for itself.  The areas are given as start address and size.
+class SramMap
+{
+public:
+    SramMap(uint32_t start, uint32_t size) : _start(start), _size(size) {}
+    virtual ~SramMap() {}
+
+    SramMap& reserve(uint32_t start, uint32_t size);
+
+    uint32_t start() const { return _start; }
+    uint32_t size() const { return _size; }
+
+    // Find the largest area not reserved by the bootloader
+    void largestFree(uint32_t& start, uint32_t& size) const;
+
+private:
+    struct Area
+    {
+        uint32_t start;
+        uint32_t size;
+    };
+
+    uint32_t _start;
+    uint32_t _size;
+    std::vector<Area> _reserved;
+};
+
+// Hands out the free SRAM of a map.  Applets and buffers are placed from
+// the bottom of the largest free area and the stack from the top.
+class SramPlan
+{
+public:
+    SramPlan(const SramMap& map);
+    virtual ~SramPlan() {}
+
+    uint32_t alloc(uint32_t size);
+    uint32_t allocStack(uint32_t size);
+    uint32_t free() const { return _top - _bottom; }
+
+private:
+    uint32_t _bottom;
+    uint32_t _top;
+};
+
+#endif // _SRAMMAP_H
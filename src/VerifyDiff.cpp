@@ -0,0 +1,244 @@
+///////////////////////////////////////////////////////////////////////////////
+// BOSSA
+//
+// Copyright (c) 2011-2018, ShumaTech
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the <organization> nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+#include "VerifyDiff.h"
+#include "Flasher.h"
+#include "FileError.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include <algorithm>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+VerifyDiff::VerifyDiff(uint32_t maxRanges, uint32_t maxBytes) :
+    _maxRanges(maxRanges), _maxBytes(maxBytes)
+{
+    clear();
+}
+
+void
+VerifyDiff::clear()
+{
+    _ranges.clear();
+    _bytes = 0;
+    _lost = 0;
+    _bitsCleared = 0;
+    _bitsSet = 0;
+    memset(_bitErrors, 0, sizeof(_bitErrors));
+}
+
+uint32_t
+VerifyDiff::scanBytewise(const uint8_t* expected, const uint8_t* actual, uint32_t start, uint32_t size)
+{
+    while (start < size && expected[start] == actual[start])
+        start++;
+
+    return start;
+}
+
+uint32_t
+VerifyDiff::scan(const uint8_t* expected, const uint8_t* actual, uint32_t start, uint32_t size)
+{
+#if defined(__SSE2__)
+    // Test 64 bytes at a time and only look for the byte once a block
+    // differs
+    for (; start + 64 <= size; start += 64)
+    {
+        const __m128i* e = (const __m128i*) (expected + start);
+        const __m128i* a = (const __m128i*) (actual + start);
+        __m128i diff;
+
+        diff = _mm_or_si128(_mm_xor_si128(_mm_loadu_si128(e), _mm_loadu_si128(a)),
+                            _mm_xor_si128(_mm_loadu_si128(e + 1), _mm_loadu_si128(a + 1)));
+        diff = _mm_or_si128(diff, _mm_xor_si128(_mm_loadu_si128(e + 2), _mm_loadu_si128(a + 2)));
+        diff = _mm_or_si128(diff, _mm_xor_si128(_mm_loadu_si128(e + 3), _mm_loadu_si128(a + 3)));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(diff, _mm_setzero_si128())) != 0xffff)
+            break;
+    }
+
+    for (; start + 16 <= size; start += 16)
+    {
+        __m128i e = _mm_loadu_si128((const __m128i*) (expected + start));
+        __m128i a = _mm_loadu_si128((const __m128i*) (actual + start));
+        int same = _mm_movemask_epi8(_mm_cmpeq_epi8(e, a));
+
+        if (same != 0xffff)
+            return start + __builtin_ctz(~same);
+    }
+#else
+    for (; start + 8 <= size; start += 8)
+    {
+        uint64_t e;
+        uint64_t a;
+
+        memcpy(&e, expected + start, sizeof(e));
+        memcpy(&a, actual + start, sizeof(a));
+        if (e != a)
+            break;
+    }
+#endif
+
+    return scanBytewise(expected, actual, start, size);
+}
+
+uint32_t
+VerifyDiff::compare(uint32_t address, const uint8_t* expected, const uint8_t* actual, uint32_t size)
+{
+    uint32_t errors = 0;
+    uint32_t offset = 0;
+
+    while ((offset = scan(expected, actual, offset, size)) < size)
+    {
+        uint32_t end = offset + 1;
+
+        while (end < size && expected[end] != actual[end])
+            end++;
+
+        record(address + offset, expected + offset, actual + offset, end - offset);
+        errors += end - offset;
+        offset = end;
+    }
+
+    return errors;
+}
+
+void
+VerifyDiff::record(uint32_t address, const uint8_t* expected, const uint8_t* actual, uint32_t size)
+{
+    MismatchRange* range = NULL;
+
+    _bytes += size;
+    for (uint32_t i = 0; i < size; i++)
+    {
+        uint8_t diff = expected[i] ^ actual[i];
+
+        _bitsCleared += __builtin_popcount(diff & expected[i]);
+        _bitsSet += __builtin_popcount(diff & actual[i]);
+        for (uint32_t bit = 0; bit < 8; bit++)
+            _bitErrors[bit] += (diff >> bit) & 1;
+    }
+
+    // A run that carries on from the last one, such as across a page, is
+    // the same range
+    if (!_ranges.empty() && _ranges.back().address + _ranges.back().size == address)
+        range = &_ranges.back();
+    else if (_ranges.size() < _maxRanges)
+    {
+        _ranges.push_back(MismatchRange(address));
+        range = &_ranges.back();
+    }
+
+    if (!range)
+    {
+        _lost += size;
+        return;
+    }
+
+    uint32_t keep = std::min(size, _maxBytes - std::min(_maxBytes, range->size));
+    range->expected.insert(range->expected.end(), expected, expected + keep);
+    range->actual.insert(range->actual.end(), actual, actual + keep);
+    range->size += size;
+}
+
+void
+VerifyDiff::summary(FlasherObserver& observer, uint32_t maxRanges) const
+{
+    observer.onStatus("Mismatches  : %u bytes in %zu ranges%s\n", _bytes, _ranges.size(),
+                      _lost ? " (more not kept)" : "");
+    observer.onStatus("Bit errors  : %u cleared, %u set, by bit 0-7:", _bitsCleared, _bitsSet);
+    for (uint32_t bit = 0; bit < 8; bit++)
+        observer.onStatus(" %u", _bitErrors[bit]);
+    observer.onStatus("\n");
+
+    for (uint32_t index = 0; index < _ranges.size() && index < maxRanges; index++)
+    {
+        const MismatchRange& range = _ranges[index];
+        std::string expected;
+        std::string actual;
+        char text[4];
+
+        for (uint32_t i = 0; i < range.expected.size() && i < 8; i++)
+        {
+            snprintf(text, sizeof(text), " %02x", range.expected[i]);
+            expected += text;
+            snprintf(text, sizeof(text), " %02x", range.actual[i]);
+            actual += text;
+        }
+
+        observer.onStatus("  0x%08x %6u bytes: expected%s%s, read%s%s\n", range.address, range.size,
+                          expected.c_str(), range.size > 8 ? " ..." : "",
+                          actual.c_str(), range.size > 8 ? " ..." : "");
+    }
+    if (_ranges.size() > maxRanges)
+        observer.onStatus("  ... %zu more ranges\n", _ranges.size() - maxRanges);
+}
+
+static void
+writeHex(FILE* file, const std::vector<uint8_t>& data)
+{
+    fputc('"', file);
+    for (uint32_t i = 0; i < data.size(); i++)
+        fprintf(file, "%02x", data[i]);
+    fputc('"', file);
+}
+
+void
+VerifyDiff::write(const std::string& filename) const
+{
+    FILE* file = fopen(filename.c_str(), "w");
+
+    if (!file)
+        throw FileOpenError(errno);
+
+    fprintf(file, "{\n  \"bytes\": %u,\n  \"unrecorded\": %u,\n", _bytes, _lost);
+    fprintf(file, "  \"bitsCleared\": %u,\n  \"bitsSet\": %u,\n  \"bitErrors\": [", _bitsCleared, _bitsSet);
+    for (uint32_t bit = 0; bit < 8; bit++)
+        fprintf(file, "%s%u", bit ? ", " : "", _bitErrors[bit]);
+    fprintf(file, "],\n  \"ranges\": [");
+
+    for (uint32_t index = 0; index < _ranges.size(); index++)
+    {
+        const MismatchRange& range = _ranges[index];
+
+        fprintf(file, "%s\n    { \"address\": %u, \"size\": %u, \"expected\": ", index ? "," : "",
+                range.address, range.size);
+        writeHex(file, range.expected);
+        fprintf(file, ", \"actual\": ");
+        writeHex(file, range.actual);
+        fprintf(file, " }");
+    }
+    fprintf(file, "%s]\n}\n", _ranges.empty() ? "" : "\n  ");
+
+    if (fclose(file) != 0)
+        throw FileIoError(errno);
+}
@@ -0,0 +1,100 @@
+///////////////////////////////////////////////////////////////////////////////
+// BOSSA
+//
+// Copyright (c) 2011-2018, ShumaTech
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the <organization> nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+#ifndef _VERIFYDIFF_H
+#define _VERIFYDIFF_H
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+class FlasherObserver;
+
+// A run of flash bytes that differ from the image.  Only the first bytes of
+// a long run are kept.
+class MismatchRange
+{
+public:
+    MismatchRange(uint32_t address) : address(address), size(0) {}
+
+    uint32_t address;
+    uint32_t size;
+    std::vector<uint8_t> expected;
+    std::vector<uint8_t> actual;
+};
+
+// Collects the differences between an image and what was read back from
+// flash.  Matching bytes, which are nearly all of them, are skipped a
+// vector at a time.
+class VerifyDiff
+{
+public:
+    VerifyDiff(uint32_t maxRanges = DefaultMaxRanges, uint32_t maxBytes = DefaultMaxBytes);
+    virtual ~VerifyDiff() {}
+
+    void clear();
+
+    // Compare a run read back from the address and return the number of
+    // bytes that differ
+    uint32_t compare(uint32_t address, const uint8_t* expected, const uint8_t* actual, uint32_t size);
+
+    const std::vector<MismatchRange>& ranges() const { return _ranges; }
+    uint32_t bytes() const { return _bytes; }
+
+    // Bits that read back as 0 where the image has 1, and the other way
+    uint32_t bitsCleared() const { return _bitsCleared; }
+    uint32_t bitsSet() const { return _bitsSet; }
+
+    // Report the first ranges and the bit statistics
+    void summary(FlasherObserver& observer, uint32_t maxRanges = 8) const;
+
+    // Write everything as JSON for failure analysis
+    void write(const std::string& filename) const;
+
+    static const uint32_t DefaultMaxRanges = 4096;
+    static const uint32_t DefaultMaxBytes = 64;
+
+    // The offset of the first byte from start that differs, or size
+    static uint32_t scan(const uint8_t* expected, const uint8_t* actual, uint32_t start, uint32_t size);
+    static uint32_t scanBytewise(const uint8_t* expected, const uint8_t* actual, uint32_t start, uint32_t size);
+
+private:
+    uint32_t _maxRanges;
+    uint32_t _maxBytes;
+    std::vector<MismatchRange> _ranges;
+    uint32_t _bytes;
+    uint32_t _lost;
+    uint32_t _bitsCleared;
+    uint32_t _bitsSet;
+    uint32_t _bitErrors[8];
+
+    void record(uint32_t address, const uint8_t* expected, const uint8_t* actual, uint32_t size);
+};
+
+#endif // _VERIFYDIFF_H
@@ -0,0 +1,217 @@
+///////////////////////////////////////////////////////////////////////////////
+// BOSSA
+//
+// Copyright (c) 2011-2018, ShumaTech
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the <organization> nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+#include "VmApplet.h"
+
+#include <assert.h>
+
+void
+VmProgram::op(uint32_t code, bool half)
+{
+    _code.push_back(half ? code | OpHalf : code);
+}
+
+VmProgram&
+VmProgram::read(uint32_t addr, bool half)
+{
+    op(OpRead, half);
+    _code.push_back(addr);
+    return *this;
+}
+
+VmProgram&
+VmProgram::write(uint32_t addr, uint32_t value, bool half)
+{
+    op(OpWrite, half);
+    _code.push_back(addr);
+    _code.push_back(value);
+    return *this;
+}
+
+VmProgram&
+VmProgram::writeAcc(uint32_t addr, bool half)
+{
+    op(OpWriteAcc, half);
+    _code.push_back(addr);
+    return *this;
+}
+
+VmProgram&
+VmProgram::orAcc(uint32_t value)
+{
+    op(OpOr, false);
+    _code.push_back(value);
+    return *this;
+}
+
+VmProgram&
+VmProgram::andAcc(uint32_t value)
+{
+    op(OpAnd, false);
+    _code.push_back(value);
+    return *this;
+}
+
+VmProgram&
+VmProgram::poll(uint32_t addr, uint32_t mask, uint32_t value,
+                uint32_t failMask, uint32_t failStatus, bool half)
+{
+    op(OpPoll, half);
+    _code.push_back(addr);
+    _code.push_back(mask);
+    _code.push_back(value);
+    _code.push_back(failMask);
+    _code.push_back(failStatus);
+    return *this;
+}
+
+VmProgram&
+VmProgram::check(uint32_t addr, uint32_t failMask, uint32_t failStatus, bool half)
+{
+    return poll(addr, 0, 0, failMask, failStatus, half);
+}
+
+VmProgram&
+VmProgram::copy(uint32_t dst, uint32_t src, uint32_t words)
+{
+    op(OpCopy, false);
+    _code.push_back(dst);
+    _code.push_back(src);
+    _code.push_back(words);
+    return *this;
+}
+
+VmProgram&
+VmProgram::halt(uint32_t status)
+{
+    op(OpHalt, false);
+    _code.push_back(status);
+    return *this;
+}
+
+uint32_t
+VmProgram::branch(uint32_t mask, uint32_t value)
+{
+    op(OpBranch, false);
+    _code.push_back(mask);
+    _code.push_back(value);
+    _code.push_back(0);
+    return _code.size() - 1;
+}
+
+VmProgram&
+VmProgram::target(uint32_t branch)
+{
+    // The offset is relative to the end of the branch so that programs
+    // can still be appended to one another
+    assert(branch < _code.size());
+    _code[branch] = (_code.size() - branch - 1) * sizeof(uint32_t);
+    return *this;
+}
+
+VmProgram&
+VmProgram::append(const VmProgram& program)
+{
+    _code.insert(_code.end(), program._code.begin(), program._code.end());
+    return *this;
+}
+
+VmApplet::VmApplet(Samba& samba, uint32_t addr, uint32_t program, uint32_t programSize)
+    : Applet(samba,
+             addr,
+             applet.code,
+             sizeof(applet.code),
+             addr + applet.start,
+             addr + applet.stack,
+             addr + applet.reset),
+      _program(program), _programSize(programSize)
+{
+}
+
+void
+VmApplet::load()
+{
+    if (_uploaded)
+        return;
+
+    Applet::load();
+    _samba.writeWord(_addr + applet.program, _program);
+}
+
+VmApplet::~VmApplet()
+{
+}
+
+uint32_t
+VmApplet::execute(const VmProgram& program)
+{
+    const std::vector<uint32_t>& code = program.code();
+    std::vector<uint8_t> image;
+
+    assert(program.size() <= capacity());
+
+    // Terminate with END plus the operand word the interpreter prefetches
+    image.reserve(program.size() + 2 * sizeof(uint32_t));
+    for (uint32_t i = 0; i <= code.size() + 1; i++)
+    {
+        uint32_t word = i < code.size() ? code[i] : 0;
+        image.push_back(word & 0xff);
+        image.push_back((word >> 8) & 0xff);
+        image.push_back((word >> 16) & 0xff);
+        image.push_back(word >> 24);
+    }
+
+    // Successive programs usually differ only in a few addresses so just
+    // send the words that changed since the last upload
+    uint32_t first = 0;
+    uint32_t last = image.size();
+    if (image.size() == _loaded.size())
+    {
+        while (first < last && image[first] == _loaded[first])
+            first++;
+        while (last > first && image[last - 1] == _loaded[last - 1])
+            last--;
+        first &= ~3;
+        last = (last + 3) & ~3;
+    }
+    if (first < last)
+    {
+        _samba.write(_program + first, &image[first], last - first);
+        _loaded = image;
+    }
+
+    runv();
+
+    return _samba.readWord(_addr + applet.status);
+}
+
+uint32_t
+VmApplet::getResult()
+{
+    return _samba.readWord(_addr + applet.result);
+}
@@ -0,0 +1,126 @@
+///////////////////////////////////////////////////////////////////////////////
+// BOSSA
+//
+// Copyright (c) 2011-2018, ShumaTech
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the <organization> nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+#ifndef _VMAPPLET_H
+#define _VMAPPLET_H
+
+#include <vector>
+
+#include "Applet.h"
+#include "VmArm.h"
+
+// Program for the register sequence interpreter.  Each operation is an
+// opcode word followed by its operands.  The interpreter keeps a single
+// accumulator which READ and POLL load and WRITEACC stores, so that
+// read-modify-write sequences never leave the device.
+class VmProgram
+{
+public:
+    VmProgram() {}
+    virtual ~VmProgram() {}
+
+    VmProgram& read(uint32_t addr, bool half = false);
+    VmProgram& write(uint32_t addr, uint32_t value, bool half = false);
+    VmProgram& writeAcc(uint32_t addr, bool half = false);
+    VmProgram& orAcc(uint32_t value);
+    VmProgram& andAcc(uint32_t value);
+
+    // Wait until (reg & mask) == value.  The program stops with the fail
+    // status as soon as any of the fail bits are set.
+    VmProgram& poll(uint32_t addr, uint32_t mask, uint32_t value,
+                    uint32_t failMask = 0, uint32_t failStatus = 0, bool half = false);
+    // Stop with the fail status if any of the fail bits are set
+    VmProgram& check(uint32_t addr, uint32_t failMask, uint32_t failStatus, bool half = false);
+    VmProgram& copy(uint32_t dst, uint32_t src, uint32_t words);
+    // Stop with the given status
+    VmProgram& halt(uint32_t status);
+    VmProgram& append(const VmProgram& program);
+
+    // Jump forward when (accumulator & mask) == value.  The jump lands
+    // where target() is later called with the returned handle.
+    uint32_t branch(uint32_t mask, uint32_t value);
+    VmProgram& target(uint32_t branch);
+
+    void clear() { _code.clear(); }
+    bool empty() const { return _code.empty(); }
+    uint32_t size() const { return _code.size() * sizeof(uint32_t); }
+    const std::vector<uint32_t>& code() const { return _code; }
+
+private:
+    enum
+    {
+        OpEnd = 0,
+        OpRead,
+        OpWrite,
+        OpWriteAcc,
+        OpOr,
+        OpAnd,
+        OpPoll,
+        OpCopy,
+        OpBranch,
+        OpHalt,
+        OpHalf = 0x100
+    };
+
+    void op(uint32_t code, bool half);
+
+    std::vector<uint32_t> _code;
+};
+
+class VmApplet : public Applet
+{
+public:
+    enum
+    {
+        StatusOk = 0,
+        StatusTimeout = 1,
+        StatusUser = 2 // First status available to fail checks
+    };
+
+    VmApplet(Samba& samba, uint32_t addr, uint32_t program, uint32_t programSize);
+    virtual ~VmApplet();
+
+    virtual void load();
+
+    // Largest program that can be executed, in bytes
+    uint32_t capacity() { return _programSize - 2 * sizeof(uint32_t); }
+
+    // Upload and run the program, returning its status word
+    uint32_t execute(const VmProgram& program);
+    // Accumulator at the end of the last program
+    uint32_t getResult();
+
+private:
+    static VmArm applet;
+
+    uint32_t _program;
+    uint32_t _programSize;
+    std::vector<uint8_t> _loaded;
+};
+
+#endif // _VMAPPLET_H
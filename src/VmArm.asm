@@ -0,0 +1,176 @@
+    .global start
+    .global stack
+    .global reset
+    .global program
+    .global status
+    .global result
+
+    .syntax unified
+    .text
+    .thumb
+    .align 2
+
+    @ Opcodes, bit 8 of the opcode word selects halfword access
+    .equ    OP_END, 0
+    .equ    OP_READ, 1
+    .equ    OP_WRITE, 2
+    .equ    OP_WRITEACC, 3
+    .equ    OP_OR, 4
+    .equ    OP_AND, 5
+    .equ    OP_POLL, 6
+    .equ    OP_COPY, 7
+    .equ    OP_BRANCH, 8
+    .equ    OP_HALT, 9
+
+    .equ    STATUS_OK, 0
+    .equ    STATUS_TIMEOUT, 1
+
+start:
+    push    {r4, r5, r6, r7}
+    ldr     r4, program
+    movs    r5, #0
+
+next:
+    @ r0 = opcode, r7 = halfword flag, r1 = first operand
+    ldmia   r4!, {r0, r1}
+    lsrs    r7, r0, #8
+    lsls    r0, r0, #24
+    lsrs    r0, r0, #24
+    cmp     r0, #OP_READ
+    beq     read
+    cmp     r0, #OP_WRITE
+    beq     write
+    cmp     r0, #OP_WRITEACC
+    beq     writeacc
+    cmp     r0, #OP_OR
+    beq     or
+    cmp     r0, #OP_AND
+    beq     and
+    cmp     r0, #OP_POLL
+    beq     poll
+    cmp     r0, #OP_COPY
+    beq     copy
+    cmp     r0, #OP_BRANCH
+    beq     branch
+    cmp     r0, #OP_HALT
+    beq     stop
+    movs    r0, #STATUS_OK
+    b       halt
+
+branch:
+    @ Skip forward over the given number of bytes when
+    @ (accumulator & mask) == value
+    ldmia   r4!, {r2, r3}
+    movs    r6, r5
+    ands    r6, r1
+    cmp     r6, r2
+    bne     next
+    adds    r4, r4, r3
+    b       next
+
+stop:
+    movs    r0, r1
+    b       halt
+
+read:
+    cmp     r7, #0
+    bne     read16
+    ldr     r5, [r1]
+    b       next
+read16:
+    ldrh    r5, [r1]
+    b       next
+
+write:
+    ldmia   r4!, {r2}
+    b       store
+writeacc:
+    movs    r2, r5
+store:
+    cmp     r7, #0
+    bne     store16
+    str     r2, [r1]
+    b       next
+store16:
+    strh    r2, [r1]
+    b       next
+
+or:
+    orrs    r5, r1
+    b       next
+
+and:
+    ands    r5, r1
+    b       next
+
+poll:
+    @ Wait for (value & mask) == expected, halting with the fail status
+    @ as soon as any fail bit is set.  The value is left in the accumulator.
+    ldmia   r4!, {r2, r3}
+    ldr     r0, limit
+poll_load:
+    cmp     r7, #0
+    bne     poll16
+    ldr     r5, [r1]
+    b       poll_test
+poll16:
+    ldrh    r5, [r1]
+poll_test:
+    ldr     r6, [r4]
+    ands    r6, r5
+    bne     poll_fail
+    movs    r6, r5
+    ands    r6, r2
+    cmp     r6, r3
+    beq     poll_done
+    subs    r0, #1
+    bne     poll_load
+    movs    r0, #STATUS_TIMEOUT
+    b       halt
+poll_fail:
+    ldr     r0, [r4, #4]
+    b       halt
+poll_done:
+    adds    r4, #8
+    b       next
+
+copy:
+    ldmia   r4!, {r2, r3}
+    cmp     r3, #0
+    beq     next
+copy_word:
+    ldmia   r2!, {r6}
+    stmia   r1!, {r6}
+    subs    r3, #1
+    bne     copy_word
+    b       next
+
+halt:
+    adr     r1, status
+    str     r0, [r1]
+    str     r5, [r1, #4]
+    pop     {r4, r5, r6, r7}
+
+    @ Fix for SAM-BA stack bug
+    ldr     r0, reset
+    cmp     r0, #0
+    bne     return
+    ldr     r0, stack
+    mov     sp, r0
+
+return:
+    bx      lr
+
+    .align  2
+limit:
+    .word   0x800000
+stack:
+    .word   0
+reset:
+    .word   0
+program:
+    .word   0
+status:
+    .word   0
+result:
+    .word   0
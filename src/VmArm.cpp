@@ -0,0 +1,35 @@
+// WARNING!!! DO NOT EDIT - FILE GENERATED BY APPLETGEN
+#include "VmArm.h"
+#include "VmApplet.h"
+
+VmArm VmApplet::applet = {
+// program
+0x000000cc,
+// reset
+0x000000c8,
+// result
+0x000000d4,
+// stack
+0x000000c4,
+// start
+0x00000000,
+// status
+0x000000d0,
+// code
+{
+0xf0, 0xb4, 0x32, 0x4c, 0x00, 0x25, 0x03, 0xcc, 0x07, 0x0a, 0x00, 0x06, 0x00, 0x0e, 0x01, 0x28,
+0x1a, 0xd0, 0x02, 0x28, 0x1e, 0xd0, 0x03, 0x28, 0x1e, 0xd0, 0x04, 0x28, 0x23, 0xd0, 0x05, 0x28,
+0x23, 0xd0, 0x06, 0x28, 0x23, 0xd0, 0x07, 0x28, 0x37, 0xd0, 0x08, 0x28, 0x03, 0xd0, 0x09, 0x28,
+0x08, 0xd0, 0x00, 0x20, 0x39, 0xe0, 0x0c, 0xcc, 0x2e, 0x00, 0x0e, 0x40, 0x96, 0x42, 0xe2, 0xd1,
+0xe4, 0x18, 0xe0, 0xe7, 0x08, 0x00, 0x30, 0xe0, 0x00, 0x2f, 0x01, 0xd1, 0x0d, 0x68, 0xda, 0xe7,
+0x0d, 0x88, 0xd8, 0xe7, 0x04, 0xcc, 0x00, 0xe0, 0x2a, 0x00, 0x00, 0x2f, 0x01, 0xd1, 0x0a, 0x60,
+0xd1, 0xe7, 0x0a, 0x80, 0xcf, 0xe7, 0x0d, 0x43, 0xcd, 0xe7, 0x0d, 0x40, 0xcb, 0xe7, 0x0c, 0xcc,
+0x13, 0x48, 0x00, 0x2f, 0x01, 0xd1, 0x0d, 0x68, 0x00, 0xe0, 0x0d, 0x88, 0x26, 0x68, 0x2e, 0x40,
+0x07, 0xd1, 0x2e, 0x00, 0x16, 0x40, 0x9e, 0x42, 0x05, 0xd0, 0x01, 0x38, 0xf1, 0xd1, 0x01, 0x20,
+0x0b, 0xe0, 0x60, 0x68, 0x09, 0xe0, 0x08, 0x34, 0xb5, 0xe7, 0x0c, 0xcc, 0x00, 0x2b, 0xb2, 0xd0,
+0x40, 0xca, 0x40, 0xc1, 0x01, 0x3b, 0xfb, 0xd1, 0xad, 0xe7, 0x09, 0xa1, 0x08, 0x60, 0x4d, 0x60,
+0xf0, 0xbc, 0x05, 0x48, 0x00, 0x28, 0x01, 0xd1, 0x02, 0x48, 0x85, 0x46, 0x70, 0x47, 0xc0, 0x46,
+0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+}
+};
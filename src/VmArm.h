@@ -0,0 +1,18 @@
+// WARNING!!! DO NOT EDIT - FILE GENERATED BY APPLETGEN
+#ifndef _VMARM_H
+#define _VMARM_H
+
+#include <stdint.h>
+
+typedef struct
+{
+    uint32_t program;
+    uint32_t reset;
+    uint32_t result;
+    uint32_t stack;
+    uint32_t start;
+    uint32_t status;
+    uint8_t code[216];
+} VmArm;
+
+#endif // _VMARM_H
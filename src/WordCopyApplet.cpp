@@ -46,17 +46,20 @@ WordCopyApplet::~WordCopyApplet()
 void
 WordCopyApplet::setDstAddr(uint32_t dstAddr)
 {
+    load();
     _samba.writeWord(_addr + applet.dst_addr, dstAddr);
 }
 
 void
 WordCopyApplet::setSrcAddr(uint32_t srcAddr)
 {
+    load();
     _samba.writeWord(_addr + applet.src_addr, srcAddr);
 }
 
 void
 WordCopyApplet::setWords(uint32_t words)
 {
+    load();
     _samba.writeWord(_addr + applet.words, words);
 }
@@ -0,0 +1,196 @@
+///////////////////////////////////////////////////////////////////////////////
+// BOSSA
+//
+// Copyright (c) 2011-2018, ShumaTech
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the <organization> nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <vector>
+
+#include "Checksum.h"
+#include "VerifyDiff.h"
+
+// Times the host-side kernels and checks that each one agrees with the
+// bytewise version before it is trusted with a number
+
+static double
+now()
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+template <class T>
+static bool
+check(const char* name, T (*kernel)(const uint8_t*, uint32_t, T), T (*reference)(const uint8_t*, uint32_t, T),
+      const std::vector<uint8_t>& data, T init)
+{
+    // Every alignment and every length up to a few folds exercises the tails
+    for (uint32_t start = 0; start < 16; start++)
+    {
+        for (uint32_t size = 0; size < 300 && start + size <= data.size(); size++)
+        {
+            if (kernel(&data[start], size, init) != reference(&data[start], size, init))
+            {
+                printf("%-16s FAILED at offset %u size %u\n", name, start, size);
+                return false;
+            }
+        }
+    }
+
+    if (kernel(&data[0], data.size(), init) != reference(&data[0], data.size(), init))
+    {
+        printf("%-16s FAILED on %zu bytes\n", name, data.size());
+        return false;
+    }
+
+    return true;
+}
+
+template <class T>
+static void
+time(const char* name, T (*kernel)(const uint8_t*, uint32_t, T), const std::vector<uint8_t>& data, T init)
+{
+    uint32_t rounds = 0;
+    double start = now();
+    double elapsed;
+    volatile T crc = init;
+
+    do
+    {
+        crc = kernel(&data[0], data.size(), crc);
+        rounds++;
+        elapsed = now() - start;
+    }
+    while (elapsed < 0.5);
+
+    printf("%-16s %9.1f MB/s\n", name, (double) data.size() * rounds / elapsed / 1e6);
+}
+
+static bool
+checkScan(const std::vector<uint8_t>& data)
+{
+    std::vector<uint8_t> copy(data);
+
+    // A single differing byte at every position within a few vectors of
+    // every alignment
+    for (uint32_t start = 0; start < 16; start++)
+    {
+        for (uint32_t diff = start; diff < start + 200; diff++)
+        {
+            copy[diff] ^= 0x10;
+            for (uint32_t size = diff - start; size < 210; size += 7)
+            {
+                if (VerifyDiff::scan(&data[0], &copy[0], start, size) !=
+                    VerifyDiff::scanBytewise(&data[0], &copy[0], start, size))
+                {
+                    printf("%-16s FAILED at offset %u size %u\n", "verify scan", diff, size);
+                    return false;
+                }
+            }
+            copy[diff] = data[diff];
+        }
+    }
+
+    if (VerifyDiff::scan(&data[0], &copy[0], 0, data.size()) != data.size())
+    {
+        printf("%-16s FAILED on %zu bytes\n", "verify scan", data.size());
+        return false;
+    }
+
+    return true;
+}
+
+static void
+timeScan(const char* name, uint32_t (*kernel)(const uint8_t*, const uint8_t*, uint32_t, uint32_t),
+         const std::vector<uint8_t>& data)
+{
+    std::vector<uint8_t> copy(data);
+    uint32_t rounds = 0;
+    double start = now();
+    double elapsed;
+    volatile uint32_t offset;
+
+    do
+    {
+        offset = kernel(&data[0], &copy[0], 0, data.size());
+        rounds++;
+        elapsed = now() - start;
+    }
+    while (elapsed < 0.5);
+
+    (void) offset;
+    printf("%-16s %9.1f MB/s\n", name, (double) data.size() * rounds / elapsed / 1e6);
+}
+
+int
+main(int argc, char* argv[])
+{
+    uint32_t size = argc > 1 ? strtoul(argv[1], NULL, 0) : 1024 * 1024;
+    const uint8_t vector[] = "123456789";
+    std::vector<uint8_t> data(size < 512 ? 512 : size);
+    bool ok = true;
+
+    srand(1);
+    for (uint32_t i = 0; i < data.size(); i++)
+        data[i] = rand();
+
+    // The check values of the two CRCs
+    if (Checksum::crc16(vector, 9) != 0x31c3 || ~Checksum::crc32(vector, 9) != 0xcbf43926)
+    {
+        printf("Check values FAILED\n");
+        ok = false;
+    }
+
+    ok &= check<uint16_t>("crc16 slice-8", Checksum::crc16Slice8, Checksum::crc16Bytewise, data, 0x1d0f);
+    ok &= check<uint16_t>("crc16 slice-16", Checksum::crc16Slice16, Checksum::crc16Bytewise, data, 0x1d0f);
+    ok &= check<uint32_t>("crc32 slice-8", Checksum::crc32Slice8, Checksum::crc32Bytewise, data, 0xffffffff);
+    ok &= check<uint32_t>("crc32 pclmul", Checksum::crc32Clmul, Checksum::crc32Bytewise, data, 0xffffffff);
+    ok &= checkScan(data);
+    if (!ok)
+        return 1;
+
+    printf("%u byte buffer, crc16 uses %s, crc32 uses %s\n\n", (uint32_t) data.size(),
+           Checksum::crc16Kernel(), Checksum::crc32Kernel());
+
+    time<uint16_t>("crc16 bytewise", Checksum::crc16Bytewise, data, 0);
+    time<uint16_t>("crc16 slice-8", Checksum::crc16Slice8, data, 0);
+    time<uint16_t>("crc16 slice-16", Checksum::crc16Slice16, data, 0);
+    time<uint32_t>("crc32 bytewise", Checksum::crc32Bytewise, data, 0xffffffff);
+    time<uint32_t>("crc32 slice-8", Checksum::crc32Slice8, data, 0xffffffff);
+    if (Checksum::hasClmul())
+        time<uint32_t>("crc32 pclmul", Checksum::crc32Clmul, data, 0xffffffff);
+    timeScan("scan bytewise", VerifyDiff::scanBytewise, data);
+    timeScan("scan simd", VerifyDiff::scan, data);
+
+    return 0;
+}
@@ -34,81 +34,47 @@
 #include <stdarg.h>
 #include <sys/time.h>
 #include <unistd.h>
+#include <memory>
+#include <vector>
+#include <map>
+#include <thread>
+#include <mutex>
+#include <algorithm>
 
 #include "CmdOpts.h"
 #include "Samba.h"
 #include "PortFactory.h"
-#include "Device.h"
 #include "Flasher.h"
+#include "ImageSource.h"
+#include "Manifest.h"
+#include "PatchFile.h"
+#include "Session.h"
+#include "Remote.h"
+
+#if defined(__WIN32__)
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <limits.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
+
+#if defined(__linux__)
+#include "EventLoop.h"
+#include "Fiber.h"
+#include "PortWatcher.h"
+
+#include <signal.h>
+#include <time.h>
+#include <sys/signalfd.h>
+#endif
 
 using namespace std;
 
-class BossaConfig
-{
-public:
-    BossaConfig();
-    virtual ~BossaConfig() {}
-
-    bool erase;
-    bool write;
-    bool read;
-    bool verify;
-    bool offset;
-    bool reset;
-    bool port;
-    bool boot;
-    bool bor;
-    bool bod;
-    bool lock;
-    bool unlock;
-    bool security;
-    bool info;
-    bool debug;
-    bool usbPort;
-    bool arduinoErase;
-    bool help;
-    bool version;
-
-    int readArg;
-    int offsetArg;
-    string portArg;
-    int bootArg;
-    int bodArg;
-    int borArg;
-    string lockArg;
-    string unlockArg;
-    bool usbPortArg;
-};
-
-BossaConfig::BossaConfig()
-{
-    erase = false;
-    write = false;
-    read = false;
-    verify = false;
-    port = false;
-    boot = false;
-    bod = false;
-    bor = false;
-    lock = false;
-    security = false;
-    info = false;
-    usbPort = false;
-    arduinoErase = false;
-    help = false;
-    version = false;
-
-    readArg = 0;
-    offsetArg = 0;
-    bootArg = 1;
-    bodArg = 1;
-    borArg = 1;
-    usbPortArg=1;
-
-    reset = false;
-}
 
-class BossaObserver : public FlasherObserver
+class BossaObserver : public SessionObserver
 {
 public:
     BossaObserver() : _lastTicks(-1) {}
@@ -116,6 +82,8 @@ public:
     
     virtual void onStatus(const char *message, ...);
     virtual void onProgress(int num, int div);
+    virtual void onBytes(uint32_t bytes);
+    virtual void onError(const char *message, ...);
 private:
     int _lastTicks;
 };
@@ -157,117 +125,55 @@ BossaObserver::onProgress(int num, int div)
     _lastTicks = 0;
 }
 
-static BossaConfig config;
-static Option opts[] =
+void
+BossaObserver::onBytes(uint32_t bytes)
 {
-    {
-      'e', "erase", &config.erase,
-      { ArgNone },
-      "erase the entire flash starting at the offset"
-    },
-    {
-      'w', "write", &config.write,
-      { ArgNone },
-      "write FILE to the flash; accelerated when\n"
-      "combined with erase option"
-    },
-    {
-      'r', "read", &config.read,
-      { ArgOptional, ArgInt, "SIZE", { &config.readArg } },
-      "read SIZE from flash and store in FILE;\n"
-      "read entire flash if SIZE not specified"
-    },
-    {
-      'v', "verify", &config.verify,
-      { ArgNone },
-      "verify FILE matches flash contents"
-    },
-    {
-      'o', "offset", &config.offset,
-      { ArgRequired, ArgInt, "OFFSET", { &config.offsetArg } },
-      "start erase/write/read/verify operation at flash OFFSET;\n"
-      "OFFSET must be aligned to a flash page boundary"
-    },
-    {
-      'p', "port", &config.port,
-      { ArgRequired, ArgString, "PORT", { &config.portArg } },
-      "use serial PORT to communicate to device;\n"
-      "default behavior is to use first serial port"
-    },
-    {
-      'b', "boot", &config.boot,
-      { ArgOptional, ArgInt, "BOOL", { &config.bootArg } },
-      "boot from ROM if BOOL is 0;\n"
-      "boot from FLASH if BOOL is 1 [default];\n"
-      "option is ignored on unsupported devices"
-    },
-    {
-      'c', "bod", &config.bod,
-      { ArgOptional, ArgInt, "BOOL", { &config.bodArg } },
-      "no brownout detection if BOOL is 0;\n"
-      "brownout detection is on if BOOL is 1 [default]"
-    },
-    {
-      't', "bor", &config.bor,
-      { ArgOptional, ArgInt, "BOOL", { &config.borArg } },
-      "no brownout reset if BOOL is 0;\n"
-      "brownout reset is on if BOOL is 1 [default]"
-    },
-    {
-      'l', "lock", &config.lock,
-      { ArgOptional, ArgString, "REGION", { &config.lockArg } },
-      "lock the flash REGION as a comma-separated list;\n"
-      "lock all if not given [default]"
-    },
-    {
-      'u', "unlock", &config.unlock,
-      { ArgOptional, ArgString, "REGION", { &config.unlockArg } },
-      "unlock the flash REGION as a comma-separated list;\n"
-      "unlock all if not given [default]"
-    },
-    {
-      's', "security", &config.security,
-      { ArgNone },
-      "set the flash security flag"
-    },
-    {
-      'i', "info", &config.info,
-      { ArgNone },
-      "display device information"
-    },
-    {
-      'd', "debug", &config.debug,
-      { ArgNone },
-      "print debug messages"
-    },
-    {
-      'U', "usb-port", &config.usbPort,
-      { ArgOptional, ArgInt, "BOOL", { &config.usbPortArg } },
-      "force serial port detection to USB if BOOL is 1 [default]\n"
-      "or to RS-232 if BOOL is 0"
-    },
-    {
-      'R', "reset", &config.reset,
-      { ArgNone },
-      "reset CPU (if supported)"
-    },
-    {
-      'a', "arduino-erase", &config.arduinoErase,
-      { ArgNone },
-      "erase and reset via Arduino 1200 baud hack"
-    },
-    {
-      'h', "help", &config.help,
-      { ArgNone },
-      "display this help text"
-    },
-    {
-      'V', "version", &config.version,
-      { ArgNone },
-      "display version info"
-    },
+    printf("\r%u bytes", bytes);
+    fflush(stdout);
+}
+
+void
+BossaObserver::onError(const char *message, ...)
+{
+    va_list ap;
+
+    va_start(ap, message);
+    vfprintf(stderr, message, ap);
+    va_end(ap);
+}
+
+// Keeps the latest state of one device in a gang for the table
+class GangObserver : public SessionObserver
+{
+public:
+    GangObserver(const string& port);
+    virtual ~GangObserver() {}
+
+    virtual void onStatus(const char *message, ...);
+    virtual void onProgress(int num, int div);
+    virtual void onError(const char *message, ...);
+
+    void finish(int result);
+    bool done();
+    int result();
+    void print(bool live);
+
+private:
+    std::mutex _mutex;
+    string _port;
+    string _status;
+    string _error;
+    int _percent;
+    int _result;
+    bool _done;
+    struct timeval _start;
+    float _seconds;
+
+    static string format(const char* message, va_list ap);
 };
 
+static BossaConfig config;
+static vector<Option> opts;
 int
 help(const char* program)
 {
@@ -275,28 +181,475 @@ help(const char* program)
     return 1;
 }
 
-static struct timeval start_time;
+GangObserver::GangObserver(const string& port) :
+    _port(port), _percent(0), _result(0), _done(false), _seconds(0)
+{
+    timer_start(_start);
+}
+
+string
+GangObserver::format(const char* message, va_list ap)
+{
+    char buffer[256];
+    string text;
+
+    vsnprintf(buffer, sizeof(buffer), message, ap);
+
+    // Messages are written for a terminal of their own so fold them onto one line
+    for (char* pos = buffer; *pos; pos++)
+    {
+        char c = (*pos == '\n' || *pos == '\r') ? ' ' : *pos;
+
+        if (c != ' ' || (!text.empty() && text[text.size() - 1] != ' '))
+            text += c;
+    }
+    while (!text.empty() && text[text.size() - 1] == ' ')
+        text.erase(text.size() - 1);
+
+    return text;
+}
 
 void
-timer_start()
+GangObserver::onStatus(const char *message, ...)
+{
+    va_list ap;
+    string text;
+
+    va_start(ap, message);
+    text = format(message, ap);
+    va_end(ap);
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (!text.empty())
+        _status = text;
+}
+
+void
+GangObserver::onProgress(int num, int div)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _percent = div ? num * 100 / div : 100;
+}
+
+void
+GangObserver::onError(const char *message, ...)
+{
+    va_list ap;
+    string text;
+
+    va_start(ap, message);
+    text = format(message, ap);
+    va_end(ap);
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _error = text;
+}
+
+void
+GangObserver::finish(int result)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _result = result;
+    _seconds = timer_stop(_start);
+    _done = true;
+}
+
+bool
+GangObserver::done()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _done;
+}
+
+int
+GangObserver::result()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _result;
+}
+
+void
+GangObserver::print(bool live)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    string text;
+
+    if (!_done)
+        text = _status;
+    else if (_result == 0)
+        text = "OK";
+    else
+        text = _error.empty() ? _status : _error;
+
+    // A row that wraps would throw out the redraw
+    if (live && text.size() > 48)
+        text = text.substr(0, 45) + "...";
+
+    printf("%-20s %3d%% %7.1fs  %s%s\n", _port.c_str(), _percent,
+           _done ? _seconds : timer_stop(_start), text.c_str(), live ? "\033[K" : "");
+}
+
+static void
+printGang(vector<unique_ptr<GangObserver>>& observers, bool live)
+{
+    printf("%-20s %4s %8s  %s%s\n", "Port", "Done", "Time", "Status", live ? "\033[K" : "");
+    for (uint32_t device = 0; device < observers.size(); device++)
+        observers[device]->print(live);
+    fflush(stdout);
+}
+
+// Program every port at once with the image and its checksums shared
+// between them.  On Linux one thread runs all of the sessions, each on a
+// fiber that waits on an event loop whenever its port is busy.  Elsewhere
+// each session has a thread of its own.
+static int
+gang(const vector<string>& ports, ImageFuture image, const char* filename, PatchFile* patches)
 {
-    gettimeofday(&start_time, NULL);
+    vector<unique_ptr<GangObserver>> observers;
+    uint32_t passed = 0;
+    int result = 0;
+#if defined(__WIN32__)
+    bool live = false;
+#else
+    bool live = isatty(fileno(stdout));
+#endif
+
+    for (uint32_t device = 0; device < ports.size(); device++)
+        observers.push_back(unique_ptr<GangObserver>(new GangObserver(ports[device])));
+
+#if defined(__linux__)
+    EventLoop loop;
+    vector<unique_ptr<Fiber>> fibers;
+    uint32_t running = ports.size();
+    std::function<void()> redraw;
+
+    for (uint32_t device = 0; device < ports.size(); device++)
+    {
+        fibers.push_back(unique_ptr<Fiber>(new Fiber(loop, [&, device]()
+        {
+            observers[device]->finish(runSession(config, ports[device], image, filename, *observers[device], true,
+                                                    patches));
+            if (--running == 0)
+                loop.stop();
+        })));
+    }
+
+    // Each session runs up to its first wait on the loop
+    for (uint32_t device = 0; device < fibers.size(); device++)
+        fibers[device]->resume();
+
+    // Redraw the table in place until every device has finished
+    redraw = [&]()
+    {
+        printGang(observers, live);
+        printf("\033[%zuA", observers.size() + 1);
+        loop.timer(200, redraw);
+    };
+    if (live)
+        redraw();
+
+    if (running > 0)
+        loop.run();
+#else
+    vector<thread> threads;
+
+    for (uint32_t device = 0; device < ports.size(); device++)
+    {
+        threads.push_back(thread([&, device]()
+        {
+            observers[device]->finish(runSession(config, ports[device], image, filename, *observers[device], true,
+                                                    patches));
+        }));
+    }
+
+    // Redraw the table in place until every device has finished
+    while (live)
+    {
+        bool finished = true;
+
+        for (uint32_t device = 0; device < observers.size(); device++)
+            finished = finished && observers[device]->done();
+        if (finished)
+            break;
+
+        printGang(observers, live);
+        printf("\033[%zuA", observers.size() + 1);
+        usleep(200000);
+    }
+
+    for (uint32_t device = 0; device < threads.size(); device++)
+        threads[device].join();
+#endif
+
+    printGang(observers, live);
+
+    // The exit status is the worst of the devices
+    for (uint32_t device = 0; device < observers.size(); device++)
+    {
+        if (observers[device]->result() == 0)
+            passed++;
+        result = max(result, observers[device]->result());
+    }
+    printf("\n%u of %zu devices succeeded\n", passed, observers.size());
+
+    return result;
 }
 
-float
-timer_stop()
+#if defined(__linux__)
+// Time for udev to finish setting up a new port before it is opened
+#define STATION_SETTLE  100
+
+// One board being programmed by the station
+class StationUnit
 {
-    struct timeval end;
-    gettimeofday(&end, NULL);
-    return (end.tv_sec - start_time.tv_sec) + (end.tv_usec - start_time.tv_usec) / 1000000.0;
+public:
+    StationUnit(const string& port) : observer(port), removed(false) {}
+
+    GangObserver observer;
+    unique_ptr<Fiber> fiber;
+    bool removed;
+};
+
+static void
+stationLog(const char* message, ...)
+{
+    va_list ap;
+    time_t now = time(NULL);
+    char stamp[16];
+
+    strftime(stamp, sizeof(stamp), "%H:%M:%S", localtime(&now));
+    printf("[%s] ", stamp);
+    va_start(ap, message);
+    vprintf(message, ap);
+    va_end(ap);
+    fflush(stdout);
+}
+
+// Wait for boards to be plugged in and run the job on each one as it
+// appears, all of them on one event loop
+static int
+station(const vector<string>& patterns, ImageFuture image, const char* filename, PatchFile* patches)
+{
+    EventLoop loop;
+    PortFactory portFactory;
+    map<string, unique_ptr<StationUnit>> units;
+    uint32_t running = 0;
+    uint32_t passed = 0;
+    uint32_t failed = 0;
+    bool stopping = false;
+    sigset_t signals;
+    int sigfd;
+
+    // Start a unit once its port has settled
+    std::function<void(const string&)> start = [&](const string& port)
+    {
+        StationUnit* unit = units[port].get();
+
+        if (!unit || unit->removed || stopping)
+        {
+            units.erase(port);
+            return;
+        }
+
+        running++;
+        stationLog("%s: started\n", port.c_str());
+        unit->fiber.reset(new Fiber(loop, [&, unit, port]()
+        {
+            int result = runSession(config, port, image, filename, unit->observer, true, patches);
+
+            unit->observer.finish(result);
+            if (result == 0)
+                passed++;
+            else
+                failed++;
+            stationLog("");
+            unit->observer.print(false);
+
+            // The fiber can only be freed once it has returned to the loop
+            loop.timer(0, [&, port]()
+            {
+                if (units[port]->removed)
+                    units.erase(port);
+                else
+                    units[port]->fiber.reset();
+                if (--running == 0 && stopping)
+                    loop.stop();
+            });
+        }));
+        unit->fiber->resume();
+    };
+
+    PortWatcher watcher(loop, [&](const string& port, bool added)
+    {
+        LinuxPortInfo info;
+
+        if (!added)
+        {
+            // A unit is kept until its port goes so it is only done once
+            if (units.count(port) && units[port]->fiber)
+                units[port]->removed = true;
+            else
+                units.erase(port);
+            return;
+        }
+
+        if (stopping || units.count(port))
+            return;
+
+        // A board that has been programmed and reset shows up again
+        // running its sketch, which is left alone
+        if (portFactory.info(port, info) && info.isUsb && info.rank < 3)
+        {
+            stationLog("%s: skipped, %04x:%04x is not a bootloader\n", port.c_str(), info.vid, info.pid);
+            return;
+        }
+
+        units[port] = unique_ptr<StationUnit>(new StationUnit(port));
+        loop.timer(STATION_SETTLE, [&, port]() { start(port); });
+    });
+
+    for (uint32_t pattern = 0; pattern < patterns.size(); pattern++)
+        watcher.watch(patterns[pattern]);
+
+    // Stop taking new boards on an interrupt and exit once the rest finish
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigprocmask(SIG_BLOCK, &signals, NULL);
+    sigfd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+    loop.watch(sigfd, EventLoop::Readable, [&]()
+    {
+        struct signalfd_siginfo info;
+
+        while (::read(sigfd, &info, sizeof(info)) == sizeof(info))
+        {
+            if (stopping || running == 0)
+            {
+                loop.stop();
+                continue;
+            }
+            stopping = true;
+            stationLog("Stopping once the %u running now are done\n", running);
+        }
+    });
+
+    stationLog("Waiting for devices on");
+    for (uint32_t pattern = 0; pattern < patterns.size(); pattern++)
+        printf(" %s", patterns[pattern].c_str());
+    printf("\n");
+    fflush(stdout);
+
+    loop.run();
+
+    loop.unwatch(sigfd);
+    ::close(sigfd);
+
+    printf("\n%u of %u devices succeeded\n", passed, passed + failed);
+
+    return failed ? 1 : 0;
+}
+#endif
+
+#if !defined(__WIN32__)
+// Hand the job to bossad and show what comes back as if it ran here
+static int
+remote(const char* program, char* argv[], int args, bool hasFile)
+{
+    string path = config.remoteArg.empty() ? Remote::defaultSocket() : config.remoteArg;
+    struct sockaddr_un addr;
+    BossaObserver observer;
+    Remote::Frame type;
+    string request;
+    string buffer;
+    string payload;
+    char chunk[1024];
+    ssize_t size;
+    int fd;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr*) &addr, sizeof(addr)) != 0)
+    {
+        fprintf(stderr, "%s: cannot reach bossad on %s: %s\n", program, path.c_str(), strerror(errno));
+        if (fd >= 0)
+            close(fd);
+        return 1;
+    }
+
+    // Everything but the remote option goes to the daemon, with the file
+    // made absolute since the daemon runs elsewhere
+    for (int arg = 1; arg < args; arg++)
+    {
+        if (strncmp(argv[arg], "--rem", 5) == 0)
+            continue;
+        request += argv[arg];
+        request += '\n';
+    }
+    if (hasFile)
+    {
+        if (argv[args][0] != '/')
+        {
+            char cwd[PATH_MAX];
+            if (getcwd(cwd, sizeof(cwd)))
+                request += string(cwd) + "/";
+        }
+        request += argv[args];
+        request += '\n';
+    }
+    request += '\n';
+
+    for (size_t sent = 0; sent < request.size(); sent += size)
+    {
+        size = send(fd, request.data() + sent, request.size() - sent, MSG_NOSIGNAL);
+        if (size < 0)
+            break;
+    }
+
+    while ((size = read(fd, chunk, sizeof(chunk))) > 0)
+    {
+        buffer.append(chunk, size);
+        while (Remote::parse(buffer, type, payload))
+        {
+            int num;
+            int div;
+
+            switch (type)
+            {
+            case Remote::Output:
+                fwrite(payload.data(), payload.size(), 1, stdout);
+                fflush(stdout);
+                break;
+            case Remote::Error:
+                fwrite(payload.data(), payload.size(), 1, stderr);
+                break;
+            case Remote::Progress:
+                if (sscanf(payload.c_str(), "%d %d", &num, &div) == 2 && div > 0)
+                    observer.onProgress(num, div);
+                break;
+            case Remote::Exit:
+                close(fd);
+                return atoi(payload.c_str());
+            }
+        }
+    }
+
+    close(fd);
+    fprintf(stderr, "\n%s: lost the connection to bossad\n", program);
+    return 1;
 }
+#endif
 
 int
 main(int argc, char* argv[])
 {
     int args;
     char* pos;
-    CmdOpts cmd(argc, argv, sizeof(opts) / sizeof(opts[0]), opts);
+    vector<string> ports;
+    config.options(opts);
+    CmdOpts cmd(argc, argv, opts.size(), &opts[0]);
 
     if ((pos = strrchr(argv[0], '/')) || (pos = strrchr(argv[0], '\\')))
         argv[0] = pos + 1;
@@ -317,7 +670,31 @@ main(int argc, char* argv[])
         return help(argv[0]);
     }
 
-    if (config.read || config.write || config.verify)
+    if (config.resume && !config.write)
+    {
+        fprintf(stderr, "%s: resume option requires write\n", argv[0]);
+        return help(argv[0]);
+    }
+
+    if (config.diff && !config.write)
+    {
+        fprintf(stderr, "%s: diff option requires write\n", argv[0]);
+        return help(argv[0]);
+    }
+
+    if (config.diff && (config.erase || config.resume))
+    {
+        fprintf(stderr, "%s: diff option is exclusive of erase or resume\n", argv[0]);
+        return help(argv[0]);
+    }
+
+    if (config.manifest && (config.read || config.diff || config.resume))
+    {
+        fprintf(stderr, "%s: manifest option is exclusive of read, diff or resume\n", argv[0]);
+        return help(argv[0]);
+    }
+
+    if (config.read || config.write || config.verify || config.manifest)
     {
         if (args == argc)
         {
@@ -332,6 +709,100 @@ main(int argc, char* argv[])
         return help(argv[0]);
     }
 
+    if (!expandPorts(argv[0], config.portArg, ports, !config.station))
+        return help(argv[0]);
+
+    if ((ports.size() > 1 || config.station) && (config.read || config.info || config.resume))
+    {
+        fprintf(stderr, "%s: read, info and resume options take a single port\n", argv[0]);
+        return help(argv[0]);
+    }
+
+    // A stream can only be read once, by a single session
+    if ((config.read || config.write || config.verify) && strcmp(argv[args], "-") == 0 &&
+        (!config.write || config.diff || config.resume || config.manifest || config.remote ||
+         config.station || ports.size() > 1))
+    {
+        fprintf(stderr, "%s: stdin can only be written to a single port without diff, resume, "
+                "manifest or remote\n", argv[0]);
+        return help(argv[0]);
+    }
+
+#if !defined(__linux__)
+    if (config.station)
+    {
+        fprintf(stderr, "%s: station option is only supported on Linux\n", argv[0]);
+        return help(argv[0]);
+    }
+#endif
+
+#if defined(__WIN32__)
+    if (config.remote)
+    {
+        fprintf(stderr, "%s: remote option is not supported on Windows\n", argv[0]);
+        return help(argv[0]);
+    }
+#endif
+
+    if (config.remote && (ports.size() > 1 || config.station || config.info || config.resume))
+    {
+        fprintf(stderr, "%s: remote option takes a single port and no info, resume or station\n", argv[0]);
+        return help(argv[0]);
+    }
+
+    if (config.verifyLog && (ports.size() > 1 || config.station || config.remote))
+    {
+        fprintf(stderr, "%s: verify log option takes a single local port\n", argv[0]);
+        return help(argv[0]);
+    }
+
+    if (config.cache && config.remote)
+    {
+        fprintf(stderr, "%s: cache option takes a local port\n", argv[0]);
+        return help(argv[0]);
+    }
+
+    if (config.plan && (!(config.erase || config.write || config.verify) || config.read || config.diff ||
+                        config.resume || config.arduinoErase || config.station || config.remote ||
+                        ports.size() > 1 || (config.write && strcmp(argv[args], "-") == 0)))
+    {
+        fprintf(stderr, "%s: plan option requires erase, write or verify of a file on a single local port, "
+                "without read, diff, resume or arduino erase\n", argv[0]);
+        return help(argv[0]);
+    }
+
+    if (config.patch && (!config.write || config.diff || config.resume || config.remote ||
+                         strcmp(argv[args], "-") == 0))
+    {
+        fprintf(stderr, "%s: patch option requires write of a file and is exclusive of diff, resume or remote\n",
+                argv[0]);
+        return help(argv[0]);
+    }
+
+    if ((config.family || config.link) && !config.plan)
+    {
+        fprintf(stderr, "%s: family and link options require plan\n", argv[0]);
+        return help(argv[0]);
+    }
+
+    Samba planSamba;
+    Device planDevice(planSamba);
+    PlanTarget target;
+    PlanLink link;
+
+    if (config.family && !PlanTarget::find(config.familyArg, planSamba, planDevice, target))
+    {
+        fprintf(stderr, "%s: unknown family %s, use one of %s\n", argv[0], config.familyArg.c_str(),
+                PlanTarget::families().c_str());
+        return help(argv[0]);
+    }
+
+    if (config.link && !PlanLink::find(config.linkArg, link))
+    {
+        fprintf(stderr, "%s: unknown link %s, use usb or a baud rate\n", argv[0], config.linkArg.c_str());
+        return help(argv[0]);
+    }
+
     if (config.help || config.version)
     {
         if (config.help)
@@ -347,6 +818,8 @@ main(int argc, char* argv[])
                    "  bossac -e -w -v -b image.bin   # Erase flash, write flash with image.bin,\n"
                    "                                 # verify the write, and set boot from flash\n"
                    "  bossac -r0x10000 image.bin     # Read 64KB from flash and store in image.bin\n"
+                   "  bossac -p '/dev/ttyACM*' -e -w -v image.bin\n"
+                   "                                 # Program every device on a ttyACM port\n"
                   );
             printf("\nOptions:\n");
             cmd.usage(stdout);
@@ -355,155 +828,102 @@ main(int argc, char* argv[])
         return 0;
     }
 
-    try
+#if !defined(__WIN32__)
+    if (config.remote)
+        return remote(argv[0], argv, args, config.read || config.write || config.verify || config.manifest);
+#endif
+
+    if (ports.empty())
     {
-        Samba samba;
         PortFactory portFactory;
+#if defined(__linux__)
+        // Forcing RS-232 asks for the ports that are not on USB
+        portFactory.setLegacy(config.usbPort && config.usbPortArg == 0);
+#endif
+        ports.push_back(portFactory.def());
+    }
 
-        if (config.debug)
-            samba.setDebug(true);
-
-        if (!config.port)
-            config.portArg = portFactory.def();
+    // Load the image once for every port.  A single port starts talking to
+    // the device while the image is still loading.
+    ImageFuture image = readyImage(NULL);
+    unique_ptr<PatchFile> patches;
+    try
+    {
+        if (config.patch)
+            patches.reset(new PatchFile(config.patchArg.c_str()));
 
-        if (config.arduinoErase)
+        if (config.manifest)
         {
-            SerialPort::Ptr port;
-            port = portFactory.create(config.portArg, config.usbPortArg != 0);
-
-            printf("Arduino 1200 baud reset\n");
-            if(!port->open(1200))
-            {
-                fprintf(stderr, "Failed to open port at 1200bps\n");
-                return 1;
-            }
-
-            port->setRTS(true);
-            port->setDTR(false);
-            port->close();
+            Manifest manifest(argv[args]);
 
-            // wait for chip to reboot and USB port to re-appear
-            sleep(1);
-
-            if (config.debug)
-                printf("Arduino reset done\n");
+            manifest.apply(config);
+            image = readyImage(manifest.image());
         }
-
-        if (config.portArg.empty())
+        else if (config.write && strcmp(argv[args], "-") == 0)
         {
-            fprintf(stderr, "No serial ports available\n");
-            return 1;
+#if defined(__WIN32__)
+            setmode(STDIN_FILENO, O_BINARY);
+#endif
         }
-
-        bool res;
-        if (config.usbPort)
-            res = samba.connect(portFactory.create(config.portArg, config.usbPortArg != 0));
-        else
-            res = samba.connect(portFactory.create(config.portArg));
-        if (!res)
+        else if ((config.write || config.verify) && ports.size() == 1 && !config.station)
         {
-            fprintf(stderr, "No device found on %s\n", config.portArg.c_str());
-            return 1;
+            image = loadImage(argv[args]);
         }
-
-        Device device(samba);
-        device.create();
-
-        Device::FlashPtr& flash = device.getFlash();
-
-        BossaObserver observer;
-        Flasher flasher(samba, device, observer);
-
-        if (config.info)
-        {
-            FlasherInfo info;
-            flasher.info(info);
-            info.print();
-        }
-
-        if (config.unlock)
-            flasher.lock(config.unlockArg, false);
-
-        if (config.erase)
+        else if (config.write || config.verify)
         {
-            timer_start();
-            flasher.erase(config.offsetArg);
-            printf("\nDone in %5.3f seconds\n", timer_stop());
+            image = readyImage(std::make_shared<ImageSource>(argv[args]));
         }
+    }
+    catch (exception& e)
+    {
+        fprintf(stderr, "\n%s\n", e.what());
+        return 1;
+    }
 
-        if (config.write)
-        {
-            timer_start();
-            flasher.write(argv[args], config.offsetArg);
-            printf("\nDone in %5.3f seconds\n", timer_stop());
-        }
-
-        if (config.verify)
-        {
-            uint32_t pageErrors;
-            uint32_t totalErrors;
-
-            timer_start();
-            if (!flasher.verify(argv[args], pageErrors, totalErrors, config.offsetArg))
-            {
-                printf("\nVerify failed\nPage errors: %d\nByte errors: %d\n",
-                    pageErrors, totalErrors);
-                return 2;
-            }
-
-            printf("\nVerify successful\nDone in %5.3f seconds\n", timer_stop());
-        }
+    // A plan for a family needs no device at all
+    if (config.plan && config.family)
+    {
+        BossaObserver observer;
+        std::shared_ptr<ImageSource> source;
 
-        if (config.read)
+        // The image may still be loading and fail only now
+        try
         {
-            timer_start();
-            flasher.read(argv[args], config.readArg, config.offsetArg);
-            printf("\nDone in %5.3f seconds\n", timer_stop());
+            source = image.get();
         }
-
-        if (config.boot)
+        catch (exception& e)
         {
-            printf("Set boot flash %s\n", config.bootArg ? "true" : "false");
-            flash->setBootFlash(config.bootArg);
+            fprintf(stderr, "\n%s\n", e.what());
+            return 1;
         }
+        return runPlan(config, planSamba, planDevice, target, link, source.get(), observer, patches.get());
+    }
 
-        if (config.bod)
+#if defined(__linux__)
+    if (config.station)
+    {
+        if (!config.port)
         {
-            printf("Set brownout detect %s\n", config.bodArg ? "true" : "false");
-            flash->setBod(config.bodArg);
+            ports.clear();
+            ports.push_back("/dev/ttyACM*");
+            ports.push_back("/dev/ttyUSB*");
         }
 
-        if (config.bor)
+        try
         {
-            printf("Set brownout reset %s\n", config.borArg ? "true" : "false");
-            flash->setBor(config.borArg);
+            return station(ports, image, argv[args], patches.get());
         }
-
-        if (config.security)
+        catch (exception& e)
         {
-            printf("Set security\n");
-            flash->setSecurity();
+            fprintf(stderr, "\n%s\n", e.what());
+            return 1;
         }
-
-        if (config.lock)
-            flasher.lock(config.lockArg, true);
-
-        flash->writeOptions();
-
-        if (config.reset)
-            device.reset();
-    }
-    catch (exception& e)
-    {
-        fprintf(stderr, "\n%s\n", e.what());
-        return 1;
-    }
-    catch(...)
-    {
-        fprintf(stderr, "\nUnhandled exception\n");
-        return 1;
     }
+#endif
 
-    return 0;
-}
+    if (ports.size() > 1)
+        return gang(ports, image, argv[args], patches.get());
 
+    BossaObserver observer;
+    return runSession(config, ports[0], image, argv[args], observer, false, patches.get());
+}
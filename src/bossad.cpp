@@ -0,0 +1,785 @@
+///////////////////////////////////////////////////////////////////////////////
+// BOSSA
+//
+// Copyright (c) 2011-2018, ShumaTech
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the <organization> nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+#include <string>
+#include <exception>
+#include <system_error>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/signalfd.h>
+#include <future>
+#include <memory>
+#include <vector>
+#include <deque>
+#include <map>
+
+#include "CmdOpts.h"
+#include "PortFactory.h"
+#include "ImageSource.h"
+#include "Manifest.h"
+#include "Session.h"
+#include "Remote.h"
+#include "EventLoop.h"
+#include "Fiber.h"
+
+using namespace std;
+
+// Longest job request taken from a client
+#define MAX_REQUEST     65536
+
+// What the last job on a port found out about its link
+class LinkProfile
+{
+public:
+    LinkProfile() : isUsb(false) {}
+
+    bool isUsb;
+};
+
+// Sends what a session reports back to its client as frames
+class RemoteObserver : public SessionObserver
+{
+public:
+    typedef std::function<void(Remote::Frame, const string&)> Sender;
+
+    RemoteObserver(Sender sender) : connected(false), isUsb(false), _sender(sender), _lastNum(-1) {}
+    virtual ~RemoteObserver() {}
+
+    virtual void onStatus(const char *message, ...);
+    virtual void onProgress(int num, int div);
+    virtual void onError(const char *message, ...);
+    virtual void onConnect(Samba& samba);
+
+    bool connected;
+    bool isUsb;
+
+private:
+    Sender _sender;
+    int _lastNum;
+
+    static string format(const char* message, va_list ap);
+};
+
+string
+RemoteObserver::format(const char* message, va_list ap)
+{
+    char buffer[256];
+    va_list copy;
+    int size;
+
+    va_copy(copy, ap);
+    size = vsnprintf(buffer, sizeof(buffer), message, copy);
+    va_end(copy);
+
+    if (size < (int) sizeof(buffer))
+        return string(buffer, size < 0 ? 0 : size);
+
+    string text(size + 1, '\0');
+    vsnprintf(&text[0], text.size(), message, ap);
+    text.resize(size);
+    return text;
+}
+
+void
+RemoteObserver::onStatus(const char *message, ...)
+{
+    va_list ap;
+
+    va_start(ap, message);
+    _sender(Remote::Output, format(message, ap));
+    va_end(ap);
+}
+
+void
+RemoteObserver::onProgress(int num, int div)
+{
+    char buffer[32];
+
+    if (num == _lastNum)
+        return;
+    _lastNum = num;
+
+    snprintf(buffer, sizeof(buffer), "%d %d", num, div);
+    _sender(Remote::Progress, buffer);
+}
+
+void
+RemoteObserver::onError(const char *message, ...)
+{
+    va_list ap;
+
+    va_start(ap, message);
+    _sender(Remote::Error, format(message, ap));
+    va_end(ap);
+}
+
+void
+RemoteObserver::onConnect(Samba& samba)
+{
+    connected = true;
+    isUsb = samba.isUsb();
+}
+
+// One client of the daemon, which submits a single job
+class Connection
+{
+public:
+    Connection(int fd) : fd(fd), submitted(false), writing(false), done(false) {}
+
+    int fd;
+    string input;
+    string output;
+    bool submitted;
+    bool writing;
+    bool done;
+};
+
+typedef shared_ptr<Connection> ConnectionPtr;
+
+class Job
+{
+public:
+    Job(uint32_t id, ConnectionPtr conn, RemoteObserver::Sender sender) :
+        id(id), conn(conn), cached(false), observer(sender) {}
+
+    uint32_t id;
+    ConnectionPtr conn;
+    BossaConfig config;
+    string port;
+    string filename;
+    shared_ptr<ImageSource> image;
+
+    // The image while it loads, and how that went
+    ImageFuture loading;
+    bool cached;
+    string error;
+
+    RemoteObserver observer;
+    unique_ptr<Fiber> fiber;
+    struct timeval start;
+};
+
+typedef shared_ptr<Job> JobPtr;
+
+class Daemon
+{
+public:
+    Daemon(const string& path);
+    virtual ~Daemon();
+
+    void run();
+
+private:
+    EventLoop _loop;
+    string _path;
+    int _listenFd;
+    int _signalFd;
+    bool _stopping;
+    uint32_t _nextJob;
+    uint32_t _running;
+    ImageCache _images;
+    map<string, LinkProfile> _profiles;
+    map<string, deque<JobPtr>> _queues;
+
+    void accept();
+    void receive(ConnectionPtr conn);
+    void send(ConnectionPtr conn, Remote::Frame type, const string& payload);
+    void flush(ConnectionPtr conn);
+    void close(ConnectionPtr conn);
+    void reject(ConnectionPtr conn, const string& message);
+    void submit(ConnectionPtr conn, vector<string>& args);
+    void load(JobPtr job);
+    void loaded(weak_ptr<Job> weak);
+    void start(const string& port);
+    void finish(JobPtr job, int result);
+    void signal();
+
+    static void log(const char* message, ...);
+
+    Daemon(const Daemon&);
+    Daemon& operator=(const Daemon&);
+};
+
+Daemon::Daemon(const string& path) :
+    _path(path), _listenFd(-1), _signalFd(-1), _stopping(false), _nextJob(0), _running(0)
+{
+    struct sockaddr_un addr;
+    sigset_t signals;
+    int probe;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path))
+        throw std::system_error(ENAMETOOLONG, std::generic_category(), path);
+    strcpy(addr.sun_path, path.c_str());
+
+    // A socket left behind by a daemon that died is taken over but one
+    // that is still being served is not
+    probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (probe >= 0)
+    {
+        int rc = connect(probe, (struct sockaddr*) &addr, sizeof(addr));
+        ::close(probe);
+        if (rc == 0)
+            throw std::system_error(EADDRINUSE, std::generic_category(), path);
+    }
+    unlink(path.c_str());
+
+    _listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (_listenFd < 0)
+        throw std::system_error(errno, std::system_category(), "socket");
+
+    if (bind(_listenFd, (struct sockaddr*) &addr, sizeof(addr)) != 0 ||
+        chmod(path.c_str(), 0600) != 0 ||
+        listen(_listenFd, 16) != 0)
+    {
+        int errnum = errno;
+        ::close(_listenFd);
+        throw std::system_error(errnum, std::system_category(), path);
+    }
+
+    _loop.watch(_listenFd, EventLoop::Readable, [this]() { accept(); });
+
+    // Stop taking jobs on an interrupt and exit once the running ones finish
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigprocmask(SIG_BLOCK, &signals, NULL);
+    _signalFd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (_signalFd >= 0)
+        _loop.watch(_signalFd, EventLoop::Readable, [this]() { signal(); });
+}
+
+Daemon::~Daemon()
+{
+    if (_listenFd >= 0)
+    {
+        ::close(_listenFd);
+        unlink(_path.c_str());
+    }
+    if (_signalFd >= 0)
+        ::close(_signalFd);
+}
+
+void
+Daemon::log(const char* message, ...)
+{
+    va_list ap;
+    time_t now = time(NULL);
+    char stamp[16];
+
+    strftime(stamp, sizeof(stamp), "%H:%M:%S", localtime(&now));
+    printf("[%s] ", stamp);
+    va_start(ap, message);
+    vprintf(message, ap);
+    va_end(ap);
+    fflush(stdout);
+}
+
+void
+Daemon::run()
+{
+    log("Listening on %s\n", _path.c_str());
+    _loop.run();
+}
+
+void
+Daemon::signal()
+{
+    struct signalfd_siginfo info;
+
+    while (::read(_signalFd, &info, sizeof(info)) == sizeof(info))
+    {
+        if (_stopping || _running == 0)
+        {
+            _loop.stop();
+            continue;
+        }
+
+        _stopping = true;
+        _loop.unwatch(_listenFd);
+        log("Stopping once the %u running now are done\n", _running);
+
+        // Jobs still waiting for their port are turned away
+        for (map<string, deque<JobPtr>>::iterator it = _queues.begin(); it != _queues.end(); it++)
+        {
+            while (it->second.size() > 1)
+            {
+                reject(it->second.back()->conn, "bossad is stopping");
+                it->second.pop_back();
+            }
+        }
+    }
+}
+
+void
+Daemon::accept()
+{
+    int fd;
+
+    while ((fd = accept4(_listenFd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0)
+    {
+        ConnectionPtr conn(new Connection(fd));
+        _loop.watch(fd, EventLoop::Readable, [this, conn]() { receive(conn); });
+    }
+}
+
+void
+Daemon::receive(ConnectionPtr conn)
+{
+    char buffer[1024];
+    ssize_t got;
+
+    while ((got = ::read(conn->fd, buffer, sizeof(buffer))) > 0)
+    {
+        // Nothing more is expected once the job is in
+        if (conn->submitted)
+            continue;
+
+        conn->input.append(buffer, got);
+        if (conn->input.size() > MAX_REQUEST)
+        {
+            close(conn);
+            return;
+        }
+
+        // The arguments come one per line and end with an empty line
+        vector<string> args;
+        size_t start = 0;
+        size_t end;
+        while ((end = conn->input.find('\n', start)) != string::npos)
+        {
+            if (end == start)
+            {
+                conn->submitted = true;
+                submit(conn, args);
+                break;
+            }
+            args.push_back(conn->input.substr(start, end - start));
+            start = end + 1;
+        }
+        if (conn->fd < 0)
+            return;
+    }
+
+    // The client has gone, so anything more for it is dropped
+    if (got == 0 || (errno != EAGAIN && errno != EWOULDBLOCK))
+        close(conn);
+}
+
+void
+Daemon::send(ConnectionPtr conn, Remote::Frame type, const string& payload)
+{
+    if (conn->fd < 0)
+        return;
+
+    conn->output += Remote::frame(type, payload);
+    if (!conn->writing)
+        flush(conn);
+}
+
+void
+Daemon::flush(ConnectionPtr conn)
+{
+    ssize_t sent;
+
+    while (!conn->output.empty())
+    {
+        sent = ::send(conn->fd, conn->output.data(), conn->output.size(), MSG_NOSIGNAL);
+        if (sent < 0)
+        {
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+            {
+                close(conn);
+                return;
+            }
+
+            // A slow client is caught up from the loop
+            if (!conn->writing)
+            {
+                conn->writing = true;
+                _loop.watch(conn->fd, EventLoop::Writable, [this, conn]() { flush(conn); });
+            }
+            return;
+        }
+        conn->output.erase(0, sent);
+    }
+
+    if (conn->writing)
+    {
+        conn->writing = false;
+        _loop.unwatch(conn->fd, EventLoop::Writable);
+    }
+
+    if (conn->done)
+        close(conn);
+}
+
+void
+Daemon::close(ConnectionPtr conn)
+{
+    if (conn->fd < 0)
+        return;
+
+    _loop.unwatch(conn->fd);
+    ::close(conn->fd);
+    conn->fd = -1;
+    conn->output.clear();
+}
+
+void
+Daemon::reject(ConnectionPtr conn, const string& message)
+{
+    send(conn, Remote::Error, message + "\n");
+    conn->done = true;
+    send(conn, Remote::Exit, "1");
+}
+
+void
+Daemon::submit(ConnectionPtr conn, vector<string>& args)
+{
+    JobPtr job(new Job(++_nextJob, conn, [this, conn](Remote::Frame type, const string& payload)
+    {
+        send(conn, type, payload);
+    }));
+    BossaConfig& config = job->config;
+    vector<Option> opts;
+    vector<char*> argv;
+    vector<string> ports;
+    int argc;
+    int index;
+
+    // The job is parsed just as bossac would parse it
+    argv.push_back((char*) "bossac");
+    for (uint32_t arg = 0; arg < args.size(); arg++)
+        argv.push_back(&args[arg][0]);
+    argc = argv.size();
+    argv.push_back(NULL);
+
+    config.options(opts);
+    CmdOpts cmd(argc, &argv[0], opts.size(), &opts[0]);
+    index = cmd.parse();
+    if (index < 0)
+        return reject(conn, "Invalid job options");
+
+    if (config.info || config.resume || config.station || config.remote || config.verifyLog || config.cache ||
+        config.plan || config.patch || config.help || config.version)
+        return reject(conn, "Info, resume, station, verify log, cache, plan and patch options cannot be run by bossad");
+
+    if (config.manifest && (config.read || config.diff))
+        return reject(conn, "Manifest option is exclusive of read or diff");
+
+    if (config.read || config.write || config.verify || config.manifest)
+    {
+        if (index + 1 != argc || argv[index][0] != '/')
+            return reject(conn, "The job needs the absolute path of one file");
+        job->filename = argv[index];
+    }
+    else if (index != argc)
+    {
+        return reject(conn, "Extra arguments found");
+    }
+
+    if (!expandPorts("bossad", config.portArg, ports) || ports.size() > 1)
+        return reject(conn, "A job takes a single port");
+
+    if (ports.empty())
+    {
+        PortFactory portFactory;
+        portFactory.setLegacy(config.usbPort && config.usbPortArg == 0);
+        ports.push_back(portFactory.def());
+    }
+    job->port = ports[0];
+
+    if (_stopping)
+        return reject(conn, "bossad is stopping");
+
+    deque<JobPtr>& queue = _queues[job->port];
+    queue.push_back(job);
+    log("Job %u: %s%s%s\n", job->id, job->port.c_str(), job->filename.empty() ? "" : " ", job->filename.c_str());
+
+    if (config.manifest || config.write || config.verify)
+        load(job);
+
+    if (queue.size() > 1)
+    {
+        char buffer[80];
+        snprintf(buffer, sizeof(buffer), "Waiting for %u job%s ahead on %s\n",
+                 (unsigned) queue.size() - 1, queue.size() > 2 ? "s" : "", job->port.c_str());
+        send(conn, Remote::Output, buffer);
+        return;
+    }
+
+    start(job->port);
+}
+
+// Images load on a thread of their own so that a cold one does not hold up
+// the sessions running on other ports.  The thread only touches the job,
+// which stays queued until its image is ready, and the thread safe cache.
+void
+Daemon::load(JobPtr job)
+{
+    Job* raw = job.get();
+    weak_ptr<Job> weak = job;
+
+    job->loading = std::async(std::launch::async, [this, raw, weak]()
+    {
+        shared_ptr<ImageSource> image;
+
+        try
+        {
+            if (raw->config.manifest)
+            {
+                // The manifest is read again for each job but its images
+                // are cached
+                Manifest manifest(raw->filename.c_str(), &_images);
+
+                manifest.apply(raw->config);
+                image = manifest.image();
+                raw->cached = true;
+            }
+            else
+            {
+                image = _images.get(raw->filename, raw->cached);
+            }
+        }
+        catch (exception& e)
+        {
+            raw->error = e.what();
+        }
+
+        _loop.post([this, weak]() { loaded(weak); });
+        return image;
+    }).share();
+}
+
+void
+Daemon::loaded(weak_ptr<Job> weak)
+{
+    JobPtr job = weak.lock();
+
+    if (!job)
+        return;
+
+    job->image = job->loading.get();
+    job->loading = ImageFuture();
+
+    deque<JobPtr>& queue = _queues[job->port];
+    bool first = !queue.empty() && queue.front() == job;
+
+    if (!job->error.empty())
+    {
+        log("Job %u: %s\n", job->id, job->error.c_str());
+        reject(job->conn, job->error);
+        for (deque<JobPtr>::iterator it = queue.begin(); it != queue.end(); it++)
+        {
+            if (*it == job)
+            {
+                queue.erase(it);
+                break;
+            }
+        }
+    }
+    else if (!job->cached)
+    {
+        log("Loaded %s (%u bytes)\n", job->filename.c_str(), job->image->size());
+    }
+
+    if (first)
+        start(job->port);
+}
+
+void
+Daemon::start(const string& port)
+{
+    deque<JobPtr>& queue = _queues[port];
+
+    // Jobs whose client went away while they waited are dropped, once any
+    // image they were loading is done with
+    while (!queue.empty() && queue.front()->conn->fd < 0 && !queue.front()->loading.valid())
+    {
+        log("Job %u: dropped\n", queue.front()->id);
+        queue.pop_front();
+    }
+
+    if (queue.empty())
+    {
+        _queues.erase(port);
+        return;
+    }
+
+    JobPtr job = queue.front();
+
+    // The job starts once its image is ready
+    if (job->loading.valid())
+        return;
+
+    // Skip detecting the link when an earlier job already did
+    if (!job->config.usbPort && _profiles.count(job->port))
+    {
+        job->config.usbPort = true;
+        job->config.usbPortArg = _profiles[job->port].isUsb;
+    }
+
+    _running++;
+    timer_start(job->start);
+    job->fiber.reset(new Fiber(_loop, [this, job]()
+    {
+        int result = runSession(job->config, job->port, readyImage(job->image), job->filename.c_str(),
+                                job->observer, true);
+
+        // The fiber can only be freed once it has returned to the loop
+        _loop.timer(0, [this, job, result]() { finish(job, result); });
+    }));
+    job->fiber->resume();
+}
+
+void
+Daemon::finish(JobPtr job, int result)
+{
+    char code[16];
+
+    _running--;
+    job->fiber.reset();
+
+    // Only a link that worked is remembered for the port
+    if (job->observer.connected)
+        _profiles[job->port].isUsb = job->observer.isUsb;
+    else
+        _profiles.erase(job->port);
+
+    log("Job %u: %s in %.3f seconds\n", job->id, result ? "failed" : "done", timer_stop(job->start));
+
+    snprintf(code, sizeof(code), "%d", result);
+    job->conn->done = true;
+    send(job->conn, Remote::Exit, code);
+
+    _queues[job->port].pop_front();
+    start(job->port);
+
+    if (_stopping && _running == 0)
+        _loop.stop();
+}
+
+static struct
+{
+    bool socket;
+    bool help;
+    bool version;
+    string socketArg;
+} config;
+
+static Option opts[] =
+{
+    {
+      's', "socket", &config.socket,
+      { ArgRequired, ArgString, "SOCKET", { &config.socketArg } },
+      "listen for jobs on the Unix socket SOCKET"
+    },
+    {
+      'h', "help", &config.help,
+      { ArgNone },
+      "display this help text"
+    },
+    {
+      'V', "version", &config.version,
+      { ArgNone },
+      "display version info"
+    },
+};
+
+int
+help(const char* program)
+{
+    fprintf(stderr, "Try '%s -h' or '%s --help' for more information\n", program, program);
+    return 1;
+}
+
+int
+main(int argc, char* argv[])
+{
+    int args;
+    char* pos;
+    CmdOpts cmd(argc, argv, sizeof(opts) / sizeof(opts[0]), opts);
+
+    if ((pos = strrchr(argv[0], '/')))
+        argv[0] = pos + 1;
+
+    args = cmd.parse();
+    if (args < 0)
+        return help(argv[0]);
+
+    if (args != argc)
+    {
+        fprintf(stderr, "%s: extra arguments found\n", argv[0]);
+        return help(argv[0]);
+    }
+
+    if (config.help || config.version)
+    {
+        if (config.help)
+            printf("Usage: %s [OPTION...]\n", argv[0]);
+        printf("Basic Open Source SAM-BA Application (BOSSA) Version " VERSION "\n"
+               "Programming daemon for Atmel SAM devices.\n"
+               "Copyright (c) 2011-2018 ShumaTech (http://www.shumatech.com)\n"
+              );
+        if (config.help)
+        {
+            printf("\n"
+                   "Runs jobs sent by 'bossac --remote', one at a time on each port,\n"
+                   "keeping images loaded between jobs.  The default socket is\n"
+                   "%s\n", Remote::defaultSocket().c_str());
+            printf("\nOptions:\n");
+            cmd.usage(stdout);
+            printf("\nReport bugs to <bugs@shumatech.com>\n");
+        }
+        return 0;
+    }
+
+    try
+    {
+        Daemon daemon(config.socket ? config.socketArg : Remote::defaultSocket());
+        daemon.run();
+    }
+    catch (exception& e)
+    {
+        fprintf(stderr, "%s: %s\n", argv[0], e.what());
+        return 1;
+    }
+
+    return 0;
+}